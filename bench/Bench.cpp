@@ -0,0 +1,90 @@
+#include "Bench.h"
+
+#include <platform/Cpu.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <thread>
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+static double since(Clock::time_point start) {
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void Suite::run(std::string const& name, size_t ops, std::function<void()> f,
+                Counters counters) {
+  if (name.find(m_options.filter) == std::string::npos) return;
+
+  // Warm up caches, branch predictors and lazily built tables, and find the
+  // number of calls that takes batchTime.
+  size_t calls = 0;
+  Clock::time_point start = Clock::now();
+  while (since(start) < m_options.warmup || calls == 0) {
+    f();
+    ++calls;
+  }
+  double perCall = since(start) / static_cast<double>(calls);
+  size_t batch = std::max<size_t>(
+      1, static_cast<size_t>(m_options.batchTime / perCall));
+
+  std::vector<double> times;
+  for (size_t r = 0; r < m_options.repetitions; ++r) {
+    start = Clock::now();
+    for (size_t i = 0; i < batch; ++i) f();
+    times.push_back(since(start) * 1e9 / static_cast<double>(batch * ops));
+  }
+  std::sort(times.begin(), times.end());
+
+  double n = static_cast<double>(times.size());
+  double mean = 0.0;
+  for (double t : times) mean += t;
+  mean /= n;
+  double variance = 0.0;
+  for (double t : times) variance += (t - mean) * (t - mean);
+  double stddev = times.size() > 1 ? std::sqrt(variance / (n - 1.0)) : 0.0;
+  size_t middle = times.size() / 2;
+  double median = times.size() % 2 == 1
+                      ? times[middle]
+                      : 0.5 * (times[middle - 1] + times[middle]);
+
+  m_results.push_back({name, batch * ops, mean, median, stddev, times.front(),
+                       times.back(), std::move(counters)});
+}
+
+void Suite::fail(std::string const& name, std::string const& reason) {
+  if (name.find(m_options.filter) == std::string::npos) return;
+  m_failures.push_back(name + ": " + reason);
+}
+
+void Suite::writeJSON(std::ostream& out) const {
+  out << "{\n  \"compiler\": \"" << __VERSION__
+      << "\",\n  \"hardware_threads\": "
+      << std::thread::hardware_concurrency()
+      << ",\n  \"isa\": \"" << platform::isaLevelName(platform::isaLevel())
+      << "\",\n  \"unit\": \"ns/op\",\n  \"repetitions\": "
+      << m_options.repetitions << ",\n  \"benchmarks\": [";
+  for (size_t i = 0; i < m_results.size(); ++i) {
+    Result const& r = m_results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << r.name
+        << "\", \"ops_per_batch\": " << r.opsPerBatch
+        << ", \"mean\": " << r.mean << ", \"median\": " << r.median
+        << ", \"stddev\": " << r.stddev << ", \"min\": " << r.min
+        << ", \"max\": " << r.max;
+    if (!r.counters.empty()) {
+      out << ", \"counters\": {";
+      for (size_t k = 0; k < r.counters.size(); ++k)
+        out << (k == 0 ? "\"" : ", \"") << r.counters[k].first
+            << "\": " << r.counters[k].second;
+      out << "}";
+    }
+    out << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+}  // namespace bench
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <modelling/Mesh.h>
+
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Microbenchmark harness of raytracing_bench. A benchmark is a function that
+// performs a fixed number of operations per call; the suite warms it up,
+// sizes batches of calls to a minimal duration and reports statistics of
+// the time per operation over repeated batches.
+
+namespace bench {
+
+// Keeps the compiler from discarding the computation of value.
+template <typename T>
+inline void doNotOptimize(T const& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct Options {
+  // Substring a benchmark name has to contain; empty runs all.
+  std::string filter;
+  // Batches measured after the warm-up.
+  size_t repetitions = 15;
+  // Seconds of warm-up and of each batch.
+  double warmup = 0.05;
+  double batchTime = 0.01;
+};
+
+// Named values reported next to the timings, such as bytes per element.
+using Counters = std::vector<std::pair<std::string, double>>;
+
+struct Result {
+  std::string name;
+  size_t opsPerBatch;
+  // Nanoseconds per operation over the batches.
+  double mean;
+  double median;
+  double stddev;
+  double min;
+  double max;
+  Counters counters;
+};
+
+class Suite {
+ public:
+  explicit Suite(Options options) : m_options(std::move(options)) {}
+
+  // f performs ops operations per call.
+  void run(std::string const& name, size_t ops, std::function<void()> f,
+           Counters counters = {});
+
+  // Records that the benchmark name, if it is selected, is outside a bound
+  // on its counters; raytracing_bench then exits with an error.
+  void fail(std::string const& name, std::string const& reason);
+
+  std::vector<Result> const& results() const { return m_results; }
+  std::vector<std::string> const& failures() const { return m_failures; }
+  void writeJSON(std::ostream& out) const;
+
+ private:
+  Options m_options;
+  std::vector<Result> m_results;
+  std::vector<std::string> m_failures;
+};
+
+void geometryBenchmarks(Suite& suite);
+void shadingBenchmarks(Suite& suite);
+void colorBenchmarks(Suite& suite);
+void meshBenchmarks(Suite& suite);
+// Hit accuracy of closed-form intersections, as counters of timed rays.
+void accuracyBenchmarks(Suite& suite);
+
+// UV sphere around the origin of rings rings of 2 * rings quads each, split
+// into counter-clockwise triangles.
+modelling::MeshData sphereMesh(float radius, size_t rings);
+
+}  // namespace bench
@@ -0,0 +1,90 @@
+#include <geometry/Torus.h>
+#include <modelling/Random.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "Bench.h"
+
+namespace g = geometry;
+namespace m = modelling;
+
+namespace bench {
+
+static const size_t Rays = 20000;
+
+// Bound on the distance of a hit from the surface relative to r. The worst
+// of the rays below is about 2e-7, for a thin torus seen from far away.
+static const double MaxRelativeError = 1e-6;
+
+// Distance of x from the surface of the torus R, r around the z axis.
+static double torusDistance(double R, double r, g::Point3D const& x) {
+  double rho = std::sqrt(x.x * x.x + x.y * x.y) - R;
+  return std::abs(std::sqrt(rho * rho + x.z * x.z) - r);
+}
+
+// Rays from a sphere of radius distance around an object space torus, aimed
+// at points on its surface, so that every ray hits. The counters are the
+// distance of the hit points from the surface relative to r, and the rays
+// that missed; the timing is of the same rays. Every ray has to hit within
+// MaxRelativeError.
+static void torusAccuracy(Suite& suite, double R, double r, double distance) {
+  m::RandomStream random(6);
+  std::vector<g::Ray> rays;
+  for (size_t i = 0; i < Rays; ++i) {
+    double theta = 2.0 * M_PI * random.uniform();
+    double phi = 2.0 * M_PI * random.uniform();
+    double rho = R + r * std::cos(phi);
+    g::Point3D target{rho * std::cos(theta), rho * std::sin(theta),
+                      r * std::sin(phi)};
+    double z = 2.0 * random.uniform() - 1.0;
+    double a = 2.0 * M_PI * random.uniform(), s = std::sqrt(1.0 - z * z);
+    g::Point3D start =
+        g::Point3D{s * std::cos(a), s * std::sin(a), z} * distance;
+    rays.push_back({start, target - start});
+  }
+
+  g::Torus torus(R, r);
+  double maxError = 0.0, sumError = 0.0;
+  size_t hits = 0;
+  for (g::Ray const& ray : rays) {
+    g::Coord t = torus.intersect(ray);
+    if (t <= 0.0) continue;
+    double error = torusDistance(R, r, ray.start + t * ray.direction) / r;
+    maxError = std::max(maxError, error);
+    sumError += error;
+    ++hits;
+  }
+
+  char name[64];
+  std::snprintf(name, sizeof(name), "accuracy/torus/R%g-r%g/d%g", R, r,
+                distance);
+  suite.run(name, Rays, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Ray const& ray : rays) sum += torus.intersect(ray);
+    doNotOptimize(sum);
+  }, {{"max_rel_err", maxError},
+      {"mean_rel_err", hits ? sumError / double(hits) : 0.0},
+      {"misses", double(Rays - hits)}});
+
+  char reason[96];
+  if (maxError > MaxRelativeError) {
+    std::snprintf(reason, sizeof(reason), "max_rel_err %g above %g", maxError,
+                  MaxRelativeError);
+    suite.fail(name, reason);
+  }
+  if (hits < Rays) {
+    std::snprintf(reason, sizeof(reason), "%zu of %zu rays missed",
+                  Rays - hits, Rays);
+    suite.fail(name, reason);
+  }
+}
+
+void accuracyBenchmarks(Suite& suite) {
+  for (double distance : {4.5, 1e3, 1e5})
+    torusAccuracy(suite, 1.0, 0.5, distance);
+  for (double distance : {9.3, 1e5}) torusAccuracy(suite, 3.0, 0.1, distance);
+}
+
+}  // namespace bench
@@ -0,0 +1,67 @@
+#include <color/PostProcess.h>
+#include <color/RGB.h>
+#include <color/Spectrum.h>
+#include <modelling/Random.h>
+
+#include "Bench.h"
+
+namespace c = color;
+
+namespace bench {
+
+static const size_t Batch = 1024;
+
+void colorBenchmarks(Suite& suite) {
+  modelling::RandomStream random(6);
+  std::vector<c::SColor> colors;
+  for (size_t i = 0; i < Batch; ++i)
+    colors.push_back(c::SColor(
+        {random.uniform(), random.uniform(), random.uniform()}));
+
+  suite.run("Spectrum/add", Batch, [&]() {
+    c::SColor sum(0.0);
+    for (c::SColor const& s : colors) sum += s;
+    doNotOptimize(sum.intensities()[0]);
+  });
+  suite.run("Spectrum/multiply", Batch, [&]() {
+    c::SColor product(1.0);
+    for (c::SColor const& s : colors) product *= s;
+    doNotOptimize(product.intensities()[0]);
+  });
+  suite.run("Spectrum/weight", Batch, [&]() {
+    // The throughput update of the path tracer, w * (color * cos * prob).
+    c::SColor w(1.0);
+    for (c::SColor const& s : colors) w = w * (s * 0.7 * 1.2);
+    doNotOptimize(w.intensities()[0]);
+  });
+  suite.run("Spectrum/luminance", Batch, [&]() {
+    c::Intensity sum = 0.0;
+    for (c::SColor const& s : colors) sum += s.luminance();
+    doNotOptimize(sum);
+  });
+  suite.run("RGB/linear", Batch, [&]() {
+    c::Intensity sum = 0.0;
+    for (c::SColor const& s : colors) sum += c::RGB::linear(s).g;
+    doNotOptimize(sum);
+  });
+
+  // Multiversioned row kernel; ns per pixel on one thread.
+  c::ImageSize size{256, 64};
+  c::Framebuffer framebuffer(size);
+  for (size_t y = 0; y < size.height; ++y)
+    for (size_t x = 0; x < size.width; ++x)
+      framebuffer.set(x, y, c::RGB::linear(colors[(x + y) % Batch] * 2.0));
+  c::PostProcessSettings settings;
+  settings.threads = 1;
+  suite.run("PostProcess/clamp", size.width * size.height, [&]() {
+    doNotOptimize(c::postProcess(framebuffer, settings).data());
+  });
+  settings.toneMap = c::PostProcessSettings::ACES;
+  settings.gamma = 2.2f;
+  settings.dither = true;
+  suite.run("PostProcess/aces+gamma+dither", size.width * size.height, [&]() {
+    doNotOptimize(c::postProcess(framebuffer, settings).data());
+  });
+}
+
+}  // namespace bench
@@ -0,0 +1,196 @@
+#include <geometry/Matrix.h>
+#include <modelling/Emitter.h>
+#include <modelling/Material.h>
+#include <modelling/Primitive.h>
+
+#include <cmath>
+
+#include "Scenes.h"
+
+namespace c = color;
+namespace g = geometry;
+namespace m = modelling;
+
+namespace bench {
+
+using MaterialPtr = std::shared_ptr<m::Material>;
+
+static MaterialPtr diffuse(double r, double g, double b) {
+  return std::make_shared<m::GeneralMaterial>(
+      c::SColor({r, g, b}), c::SColor({0.0, 0.0, 0.0}), 0.0,
+      c::SColor({0.0, 0.0, 0.0}), c::SColor({0.0, 0.0, 0.0}), 0.0);
+}
+
+static MaterialPtr glossy(double d, double s, double shine) {
+  return std::make_shared<m::GeneralMaterial>(
+      c::SColor({d, d, d}), c::SColor({s, s, s}), shine,
+      c::SColor({0.0, 0.0, 0.0}), c::SColor({0.0, 0.0, 0.0}), 0.0);
+}
+
+static MaterialPtr mirror() {
+  return std::make_shared<m::GeneralMaterial>(
+      c::SColor({0.0, 0.0, 0.0}), c::SColor({0.2, 0.2, 0.2}), 64.0,
+      c::SColor({1.0, 1.0, 1.0}), c::SColor({0.0, 0.0, 0.0}), 0.0);
+}
+
+static MaterialPtr glass(double ior) {
+  return std::make_shared<m::GeneralMaterial>(
+      c::SColor({0.0, 0.0, 0.0}), c::SColor({0.11, 0.1, 0.1}), 64.0,
+      c::SColor({0.0, 0.0, 0.0}), c::SColor({1.0, 1.0, 1.0}), ior);
+}
+
+// Triangle facing the side of `outward`.
+static void triangle(rendering::RenderScene& scene, g::Point3D p1,
+                     g::Point3D p2, g::Point3D p3, g::Vector3D outward,
+                     MaterialPtr material) {
+  if (((p3 - p1) % (p2 - p1)) * outward < 0) std::swap(p2, p3);
+  scene.primitives.emplace_back(
+      std::make_shared<m::Triangle>(p1, p2, p3, material));
+}
+
+static void quad(rendering::RenderScene& scene, g::Point3D a, g::Point3D b,
+                 g::Point3D c, g::Point3D d, g::Vector3D outward,
+                 MaterialPtr material) {
+  triangle(scene, a, b, c, outward, material);
+  triangle(scene, a, c, d, outward, material);
+}
+
+static m::Camera exampleCamera() {
+  double angle = -45.0 * M_PI / 180.0;
+  return m::Camera({0.0, 5.0, 0.0}, {4.0 / 3.0, 0.0, 0.0},
+                   {0.0, std::cos(angle), std::sin(angle)},
+                   {0.0, 5.0 - 3.5 * std::sin(angle),
+                    3.5 * std::cos(angle)});
+}
+
+// Back wall and floor of example.cpp.
+static void exampleRoom(rendering::RenderScene& scene, MaterialPtr wall,
+                        MaterialPtr floor) {
+  quad(scene, {-10, -4, -12}, {-10, 16, -12}, {10, 16, -12}, {10, -4, -12},
+       {0, 0, 1}, wall);
+  quad(scene, {-10, -4, 8}, {-10, -4, -12}, {10, -4, -12}, {10, -4, 8},
+       {0, 1, 0}, floor);
+}
+
+static ConvergenceScene exampleScene() {
+  auto scene = std::make_unique<rendering::RenderScene>(exampleCamera());
+  MaterialPtr stone = glossy(0.8, 0.1, 8.0);
+  MaterialPtr shiny = glossy(1.0, 0.3, 16.0);
+
+  scene->primitives.emplace_back(std::make_shared<m::Torus>(
+      1.0, 0.5,
+      g::Translate3D(5.0, -2.8, -8.0) * g::RotateY3D(-1.57) *
+          g::RotateX3D(-0.8),
+      mirror()));
+  scene->primitives.emplace_back(std::make_shared<m::Torus>(
+      1.0, 0.5, g::Translate3D(-4.0, -3.5, -5.3) * g::RotateX3D(-1.57),
+      stone));
+  scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+      g::Point3D{-3.0, -2.5, -8.0}, 1.5, g::Identity3D(),
+      glossy(1.0, 0.2, 64.0)));
+  scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+      g::Point3D{-0.8, -2.5, -6.5}, 1.5, g::Identity3D(), glass(1.1)));
+  scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+      g::Point3D{0.0, -2.5, -10.0}, 1.5, g::Identity3D(), mirror()));
+  scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+      g::Point3D{2.3, -2.8, -6.0}, 1.2, g::Identity3D(), shiny));
+  scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+      g::Point3D{2.6, -2.8, -9.0}, 1.2, g::Identity3D(),
+      diffuse(0.9, 0.45, 0.2)));
+  exampleRoom(*scene, glossy(1.0, 0.2, 32.0), glossy(1.0, 0.2, 64.0));
+
+  for (double x : {4.0, -4.0})
+    scene->emitters.emplace_back(std::make_shared<m::SphereLight>(
+        g::Point3D{x, 3.0, 0.0}, 0.4, c::SColor({6.3, 2.3, 1.4}) * 100.0));
+  return {"example", std::move(scene), 32, 32};
+}
+
+// A sphere of 16 x 12 facets; every ray is tested against each of them.
+static ConvergenceScene trianglesScene() {
+  auto scene = std::make_unique<rendering::RenderScene>(exampleCamera());
+  MaterialPtr material = glossy(0.8, 0.2, 32.0);
+
+  g::Point3D center{0.0, -2.0, -8.0};
+  double radius = 2.0;
+  size_t slices = 16, stacks = 12;
+  auto vertex = [&](size_t i, size_t j) {
+    double theta = M_PI * double(i) / double(stacks);
+    double phi = 2.0 * M_PI * double(j) / double(slices);
+    return center + g::Vector3D{std::sin(theta) * std::cos(phi),
+                                std::cos(theta),
+                                std::sin(theta) * std::sin(phi)} *
+                        radius;
+  };
+  for (size_t i = 0; i < stacks; ++i) {
+    for (size_t j = 0; j < slices; ++j) {
+      g::Point3D a = vertex(i, j), b = vertex(i + 1, j),
+                 c = vertex(i + 1, j + 1), d = vertex(i, j + 1);
+      g::Vector3D outward = (a - center) + (c - center);
+      if (i > 0) triangle(*scene, a, c, d, outward, material);
+      if (i + 1 < stacks) triangle(*scene, a, b, c, outward, material);
+    }
+  }
+  exampleRoom(*scene, diffuse(0.7, 0.7, 0.7), diffuse(0.5, 0.6, 0.7));
+
+  scene->emitters.emplace_back(std::make_shared<m::SphereLight>(
+      g::Point3D{4.0, 5.0, -2.0}, 0.5, c::SColor({6.0, 5.0, 4.0}) * 30.0));
+  return {"triangles", std::move(scene), 32, 32};
+}
+
+// 24 small coloured lights in a ring; every one is sampled at every vertex.
+static ConvergenceScene lightsScene() {
+  auto scene = std::make_unique<rendering::RenderScene>(exampleCamera());
+  scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+      g::Point3D{-2.0, -2.0, -8.0}, 2.0, g::Identity3D(),
+      glossy(0.8, 0.3, 32.0)));
+  scene->primitives.emplace_back(std::make_shared<m::Torus>(
+      1.2, 0.5, g::Translate3D(3.0, -3.5, -7.0) * g::RotateX3D(-1.57),
+      diffuse(0.8, 0.8, 0.8)));
+  exampleRoom(*scene, diffuse(0.7, 0.7, 0.7), glossy(0.6, 0.3, 64.0));
+
+  size_t n = 24;
+  for (size_t k = 0; k < n; ++k) {
+    double phi = 2.0 * M_PI * double(k) / double(n);
+    c::SColor color({1.0 + std::cos(phi), 1.0 + std::cos(phi + 2.1),
+                     1.0 + std::cos(phi + 4.2)});
+    scene->emitters.emplace_back(std::make_shared<m::SphereLight>(
+        g::Point3D{7.0 * std::cos(phi), 2.0 + std::sin(3.0 * phi),
+                   -6.0 + 5.0 * std::sin(phi)},
+        0.2, color * 10.0));
+  }
+  return {"lights", std::move(scene), 32, 32};
+}
+
+// Four glass spheres behind each other over a checkered floor, so that
+// paths refract many times.
+static ConvergenceScene glassScene() {
+  auto scene = std::make_unique<rendering::RenderScene>(exampleCamera());
+  for (size_t k = 0; k < 4; ++k)
+    scene->primitives.emplace_back(std::make_shared<m::Sphere>(
+        g::Point3D{-1.5 + double(k), -2.5, -4.5 - 2.0 * double(k)}, 1.4,
+        g::Identity3D(), glass(1.5)));
+
+  MaterialPtr dark = diffuse(0.1, 0.1, 0.1), light = diffuse(0.8, 0.8, 0.8);
+  for (int i = -5; i < 5; ++i)
+    for (int j = -6; j < 4; ++j)
+      quad(*scene, {2.0 * i, -4, 2.0 * j}, {2.0 * i + 2, -4, 2.0 * j},
+           {2.0 * i + 2, -4, 2.0 * j + 2}, {2.0 * i, -4, 2.0 * j + 2},
+           {0, 1, 0}, (i + j) % 2 ? dark : light);
+  quad(*scene, {-10, -4, -12}, {-10, 16, -12}, {10, 16, -12}, {10, -4, -12},
+       {0, 0, 1}, diffuse(0.6, 0.3, 0.3));
+
+  scene->emitters.emplace_back(std::make_shared<m::SphereLight>(
+      g::Point3D{0.0, 6.0, -4.0}, 0.5, c::SColor({6.0, 6.0, 6.0}) * 100.0));
+  return {"glass", std::move(scene), 32, 32};
+}
+
+std::vector<ConvergenceScene> convergenceScenes() {
+  std::vector<ConvergenceScene> scenes;
+  scenes.push_back(exampleScene());
+  scenes.push_back(trianglesScene());
+  scenes.push_back(lightsScene());
+  scenes.push_back(glassScene());
+  return scenes;
+}
+
+}  // namespace bench
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <rendering/RenderScene.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Scenes of raytracing_convergence. They use no image files, so that the
+// reference images only depend on the code.
+
+namespace bench {
+
+struct ConvergenceScene {
+  std::string name;
+  std::unique_ptr<rendering::RenderScene> scene;
+  size_t maxDepth;
+  // Grid size of the reference image; gridSize^2 samples per pixel.
+  size_t referenceGridSize;
+};
+
+// The scene of example.cpp without its textures and normal maps, a mesh of
+// many triangles, many lights, and a stack of glass spheres.
+std::vector<ConvergenceScene> convergenceScenes();
+
+}  // namespace bench
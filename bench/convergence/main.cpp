@@ -0,0 +1,220 @@
+#include <color/Framebuffer.h>
+#include <rendering/render.h>
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+#include "Scenes.h"
+
+// Error against a reference image over render time. Each scene is rendered
+// with increasing sample counts, timing the whole render including photon
+// mapping and guide training, and compared to the reference stored in
+// bench/convergence/references; time to a target error is read from the
+// curve. --write-references renders the references with plain path tracing.
+//
+// Usage: raytracing_convergence [--scene NAME] [--integrator NAME]
+//            [--max-grid N] [--target RELMSE] [--csv FILE] [--json FILE]
+//            [--references DIR] [--write-references]
+//
+// Integrators: path, guided, cache (irradiance cache), caustics (photon map).
+
+namespace {
+
+const color::ImageSize ImageSize{128, 96};
+
+// Keeps relMSE finite where the reference is black.
+const double RelMSEEpsilon = 1e-2;
+
+struct Point {
+  std::string scene;
+  size_t samples;
+  double seconds;
+  double rmse;
+  double relMSE;
+};
+
+struct Options {
+  std::string scene;
+  std::string integrator = "path";
+  size_t maxGridSize = 12;
+  double target = 1e-2;
+  std::string csv;
+  std::string json;
+  std::string references = CONVERGENCE_REFERENCES;
+  bool writeReferences = false;
+};
+
+rendering::RenderSettings settingsFor(std::string const& integrator,
+                                      size_t gridSize, size_t maxDepth) {
+  rendering::RenderSettings settings;
+  settings.gridSize = gridSize;
+  settings.maxDepth = maxDepth;
+  if (integrator == "guided")
+    settings.guiding.enabled = true;
+  else if (integrator == "cache")
+    settings.irradianceCache.enabled = true;
+  else if (integrator == "caustics")
+    settings.caustics.enabled = true;
+  else if (integrator != "path")
+    throw "Unknown integrator";
+  return settings;
+}
+
+void compare(color::Framebuffer const& image,
+             color::Framebuffer const& reference, Point& point) {
+  double se = 0.0, relSE = 0.0;
+  for (size_t y = 0; y < ImageSize.height; ++y) {
+    for (size_t x = 0; x < ImageSize.width; ++x) {
+      color::RGB a = image.get(x, y), b = reference.get(x, y);
+      for (auto [u, v] : {std::pair(a.r, b.r), std::pair(a.g, b.g),
+                          std::pair(a.b, b.b)}) {
+        double d = double(u) - double(v);
+        se += d * d;
+        relSE += d * d / (double(v) * double(v) + RelMSEEpsilon);
+      }
+    }
+  }
+  double n = 3.0 * double(ImageSize.width * ImageSize.height);
+  point.rmse = std::sqrt(se / n);
+  point.relMSE = relSE / n;
+}
+
+// Interpolated linearly in log-log space; NAN if the target is not reached.
+double timeToTarget(std::vector<Point> const& curve, double target) {
+  for (size_t i = 0; i < curve.size(); ++i) {
+    if (curve[i].relMSE > target) continue;
+    if (i == 0) return curve[0].seconds;
+    Point const &a = curve[i - 1], &b = curve[i];
+    double t = std::log(target / a.relMSE) / std::log(b.relMSE / a.relMSE);
+    return a.seconds * std::pow(b.seconds / a.seconds, t);
+  }
+  return NAN;
+}
+
+void writeCSV(std::ostream& out, std::string const& integrator,
+              std::vector<Point> const& points) {
+  out << "scene,integrator,samples,seconds,rmse,relmse\n";
+  for (Point const& p : points)
+    out << p.scene << "," << integrator << "," << p.samples << ","
+        << p.seconds << "," << p.rmse << "," << p.relMSE << "\n";
+}
+
+void writeJSON(std::ostream& out, Options const& options,
+               std::vector<Point> const& points) {
+  out << "{\n  \"compiler\": \"" << __VERSION__
+      << "\",\n  \"hardware_threads\": "
+      << std::thread::hardware_concurrency() << ",\n  \"integrator\": \""
+      << options.integrator << "\",\n  \"width\": " << ImageSize.width
+      << ",\n  \"height\": " << ImageSize.height << ",\n  \"points\": [";
+  for (size_t i = 0; i < points.size(); ++i) {
+    Point const& p = points[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\"scene\": \"" << p.scene
+        << "\", \"samples\": " << p.samples << ", \"seconds\": " << p.seconds
+        << ", \"rmse\": " << p.rmse << ", \"relmse\": " << p.relMSE << "}";
+  }
+  out << "\n  ]\n}\n";
+}
+
+template <typename F>
+bool write(std::string const& filename, F const& writer) {
+  std::ofstream out(filename);
+  writer(out);
+  if (!out) std::cerr << "Cannot write " << filename << std::endl;
+  return bool(out);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    bool value = i + 1 < argc;
+    if (std::strcmp(argv[i], "--write-references") == 0)
+      options.writeReferences = true;
+    else if (value && std::strcmp(argv[i], "--scene") == 0)
+      options.scene = argv[++i];
+    else if (value && std::strcmp(argv[i], "--integrator") == 0)
+      options.integrator = argv[++i];
+    else if (value && std::strcmp(argv[i], "--max-grid") == 0)
+      options.maxGridSize = std::strtoul(argv[++i], nullptr, 10);
+    else if (value && std::strcmp(argv[i], "--target") == 0)
+      options.target = std::strtod(argv[++i], nullptr);
+    else if (value && std::strcmp(argv[i], "--csv") == 0)
+      options.csv = argv[++i];
+    else if (value && std::strcmp(argv[i], "--json") == 0)
+      options.json = argv[++i];
+    else if (value && std::strcmp(argv[i], "--references") == 0)
+      options.references = argv[++i];
+  }
+
+  std::vector<Point> points;
+  try {
+    for (auto const& scene : bench::convergenceScenes()) {
+      if (!options.scene.empty() && scene.name != options.scene) continue;
+      std::string reference = options.references + "/" + scene.name + ".pfm";
+
+      if (options.writeReferences) {
+        auto settings =
+            settingsFor("path", scene.referenceGridSize, scene.maxDepth);
+        rendering::RenderStats stats;
+        color::savePFM(reference,
+                       rendering::renderFramebuffer(*scene.scene, ImageSize,
+                                                    settings, &stats));
+        std::cout << reference << ": " << stats.totalTime << " s"
+                  << std::endl;
+        continue;
+      }
+
+      color::Framebuffer expected = color::loadPFM(reference);
+      if (expected.size().width != ImageSize.width ||
+          expected.size().height != ImageSize.height)
+        throw "Reference image of a different size";
+
+      std::cout << scene.name << " (" << options.integrator << ")\n"
+                << std::setw(8) << "samples" << std::setw(12) << "seconds"
+                << std::setw(12) << "rmse" << std::setw(12) << "relmse"
+                << std::endl;
+      std::vector<Point> curve;
+      for (size_t gridSize = 1; gridSize <= options.maxGridSize;
+           gridSize = gridSize < 4 ? gridSize + 1 : gridSize * 3 / 2) {
+        auto settings =
+            settingsFor(options.integrator, gridSize, scene.maxDepth);
+        rendering::RenderStats stats;
+        color::Framebuffer image = rendering::renderFramebuffer(
+            *scene.scene, ImageSize, settings, &stats);
+
+        Point point{scene.name, gridSize * gridSize, stats.totalTime, 0.0,
+                    0.0};
+        compare(image, expected, point);
+        curve.push_back(point);
+        std::cout << std::setw(8) << point.samples << std::setw(12)
+                  << std::setprecision(4) << point.seconds << std::setw(12)
+                  << point.rmse << std::setw(12) << point.relMSE
+                  << std::endl;
+      }
+      std::cout << "time to relMSE " << options.target << ": "
+                << timeToTarget(curve, options.target) << " s\n"
+                << std::endl;
+      points.insert(points.end(), curve.begin(), curve.end());
+    }
+  } catch (char const* error) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  if (!options.csv.empty() &&
+      !write(options.csv, [&](std::ostream& out) {
+        writeCSV(out, options.integrator, points);
+      }))
+    return 1;
+  if (!options.json.empty() &&
+      !write(options.json,
+             [&](std::ostream& out) { writeJSON(out, options, points); }))
+    return 1;
+  return 0;
+}
@@ -0,0 +1,297 @@
+#include <geometry/Affine3D.h>
+#include <geometry/Batch.h>
+#include <geometry/FastMath.h>
+#include <geometry/Matrix.h>
+#include <modelling/Mesh.h>
+#include <modelling/Primitive.h>
+#include <modelling/Random.h>
+
+#include "Bench.h"
+
+namespace g = geometry;
+namespace m = modelling;
+
+namespace bench {
+
+static const size_t Batch = 1024;
+
+static g::Vector3D randomDirection(m::RandomStream& random) {
+  double z = 2.0 * random.uniform() - 1.0;
+  double phi = 2.0 * M_PI * random.uniform();
+  double s = std::sqrt(1.0 - z * z);
+  return {s * std::cos(phi), s * std::sin(phi), z};
+}
+
+// Rays from a sphere of radius 10 around center. Hits aim at points on the
+// surface, misses at points beside the bounding sphere of radius extent;
+// `hits` is the fraction of hits, in random order.
+template <typename SurfacePoint>
+static std::vector<g::Ray> rays(g::Point3D center, g::Coord extent,
+                                double hits, SurfacePoint surfacePoint) {
+  m::RandomStream random(1);
+  std::vector<g::Ray> result;
+  for (size_t i = 0; i < Batch; ++i) {
+    g::Point3D start = center + randomDirection(random) * 10.0;
+    g::Point3D target;
+    if (random.uniform() < hits) {
+      target = surfacePoint(random);
+    } else {
+      g::Normal3D view = center - start;
+      g::Normal3D side = view % g::Normal3D(randomDirection(random));
+      target = center + side * (extent * (1.2 + random.uniform()));
+    }
+    result.push_back({start, target - start});
+  }
+  return result;
+}
+
+static void intersectBenchmarks(Suite& suite, std::string const& name,
+                                m::Primitive const& primitive,
+                                std::vector<g::Ray> const (&sets)[3]) {
+  char const* mixes[3] = {"hit", "miss", "mixed"};
+  for (size_t k = 0; k < 3; ++k) {
+    std::vector<g::Ray> const& rays = sets[k];
+    suite.run("intersect/" + name + "/" + mixes[k], Batch, [&]() {
+      g::Coord sum = 0.0;
+      for (g::Ray const& ray : rays) sum += primitive.intersect(ray);
+      doNotOptimize(sum);
+    });
+  }
+}
+
+template <size_t N>
+static void batchBenchmarks(Suite& suite,
+                            std::vector<g::Vector3D> const& vectors) {
+  std::vector<g::Point3DxN<N>> batches;
+  for (size_t i = 0; i + N <= vectors.size(); i += N)
+    batches.push_back(g::Point3DxN<N>::load(&vectors[i]));
+
+  // Results are stored, or the lanes that are not read would be optimized
+  // away.
+  std::vector<g::Point3DxN<N>> out(batches.size());
+  std::string name = "Point3Dx" + std::to_string(N);
+  suite.run(name + "/normalize", Batch, [&]() {
+    for (size_t i = 0; i < batches.size(); ++i)
+      out[i] = g::Normal3DxN<N>(batches[i]);
+    doNotOptimize(out.data());
+  });
+  suite.run(name + "/normalize-fast", Batch, [&]() {
+    for (size_t i = 0; i < batches.size(); ++i)
+      out[i] = g::Normal3DxN<N>::fast(batches[i]);
+    doNotOptimize(out.data());
+  });
+  suite.run(name + "/cross-dot", Batch, [&]() {
+    for (size_t i = 0; i < batches.size(); ++i)
+      out[i] = batches[i] * ((batches[i] % out[i]) * batches[i]);
+    doNotOptimize(out.data());
+  });
+}
+
+// <cmath> against FastMath.h. Results are stored, so that the loops over
+// the approximations vectorize as they would in a kernel.
+static void mathBenchmarks(Suite& suite) {
+  m::RandomStream random(5);
+  std::vector<g::Coord> x(Batch), y(Batch), u(Batch), out(Batch);
+  for (size_t i = 0; i < Batch; ++i) {
+    x[i] = 2.0 * random.uniform() - 1.0;
+    y[i] = 2.0 * random.uniform() - 1.0;
+    u[i] = 1.0 - random.uniform();
+  }
+  auto run = [&](std::string const& name, auto f) {
+    suite.run("math/" + name, Batch, [&, f]() {
+      for (size_t i = 0; i < Batch; ++i) out[i] = f(i);
+      doNotOptimize(out.data());
+    });
+  };
+
+  run("atan2/std", [&](size_t i) { return std::atan2(y[i], x[i]); });
+  run("atan2/fast", [&](size_t i) { return g::fastAtan2(y[i], x[i]); });
+  run("asin/std", [&](size_t i) { return std::asin(x[i]); });
+  run("asin/fast", [&](size_t i) { return g::fastAsin(x[i]); });
+  run("sincos/std", [&](size_t i) {
+    return std::sin(2.0 * M_PI * u[i]) + std::cos(2.0 * M_PI * u[i]);
+  });
+  run("sincos/fast", [&](size_t i) {
+    g::Coord sin, cos;
+    g::fastSinCos(2.0 * M_PI * u[i], sin, cos);
+    return sin + cos;
+  });
+  // The Phong lobe and its sampling.
+  run("pow/std", [&](size_t i) { return std::pow(u[i], 32.0); });
+  run("pow/fast", [&](size_t i) { return g::fastPow(u[i], 32.0); });
+  run("cbrt/std", [&](size_t i) { return std::cbrt(x[i]); });
+  run("cbrt/fast", [&](size_t i) { return g::fastCbrt(x[i]); });
+
+  std::vector<g::Coordx4> x4(Batch / 4), y4(Batch / 4), out4(Batch / 4);
+  for (size_t i = 0; i < Batch; ++i) {
+    x4[i / 4][i % 4] = x[i];
+    y4[i / 4][i % 4] = y[i];
+  }
+  suite.run("math/atan2/fast-x4", Batch, [&]() {
+    for (size_t i = 0; i < x4.size(); ++i) out4[i] = g::fastAtan2(y4[i], x4[i]);
+    doNotOptimize(out4.data());
+  });
+}
+
+void geometryBenchmarks(Suite& suite) {
+  auto material = std::make_shared<m::DiffuseMaterial>(color::SColor(0.5));
+
+  g::Point3D center{1.0, -2.0, -6.0};
+  m::Sphere sphere(center, 1.5, g::RotateY3D(0.3), material);
+  auto spherePoint = [&](m::RandomStream& random) {
+    return center + randomDirection(random) * 1.5;
+  };
+  std::vector<g::Ray> sphereRays[3] = {rays(center, 1.5, 1.0, spherePoint),
+                                       rays(center, 1.5, 0.0, spherePoint),
+                                       rays(center, 1.5, 0.5, spherePoint)};
+  intersectBenchmarks(suite, "sphere", sphere, sphereRays);
+
+  g::Point3D p1{0.0, -2.0, -6.0}, p2{2.0, -2.0, -6.0}, p3{1.0, 0.0, -7.0};
+  m::Triangle triangle(p1, p2, p3, material);
+  auto trianglePoint = [&](m::RandomStream& random) {
+    double u = random.uniform(), v = random.uniform();
+    if (u + v > 1.0) u = 1.0 - u, v = 1.0 - v;
+    return p1 + (p2 - p1) * u + (p3 - p1) * v;
+  };
+  g::Point3D centroid = (p1 + p2 + p3) / 3.0;
+  std::vector<g::Ray> triangleRays[3] = {
+      rays(centroid, 1.5, 1.0, trianglePoint),
+      rays(centroid, 1.5, 0.0, trianglePoint),
+      rays(centroid, 1.5, 0.5, trianglePoint)};
+  intersectBenchmarks(suite, "triangle", triangle, triangleRays);
+
+  g::Matrix<4, 4> view = g::Translate3D(center.x, center.y, center.z) *
+                         g::RotateY3D(-1.57) * g::RotateX3D(-0.8);
+  m::Torus torus(1.0, 0.5, view, material);
+  auto torusPoint = [&](m::RandomStream& random) {
+    double theta = 2.0 * M_PI * random.uniform();
+    double phi = 2.0 * M_PI * random.uniform();
+    double rho = 1.0 + 0.5 * std::cos(phi);
+    return view * g::Point3D{rho * std::cos(theta), rho * std::sin(theta),
+                             0.5 * std::sin(phi)};
+  };
+  std::vector<g::Ray> torusRays[3] = {rays(center, 1.5, 1.0, torusPoint),
+                                      rays(center, 1.5, 0.0, torusPoint),
+                                      rays(center, 1.5, 0.5, torusPoint)};
+  intersectBenchmarks(suite, "torus", torus, torusRays);
+
+  // A thin ring; most of the misses pass through its hole.
+  m::Torus ring(3.0, 0.1, view, material);
+  auto ringPoint = [&](m::RandomStream& random) {
+    double theta = 2.0 * M_PI * random.uniform();
+    double phi = 2.0 * M_PI * random.uniform();
+    double rho = 3.0 + 0.1 * std::cos(phi);
+    return view * g::Point3D{rho * std::cos(theta), rho * std::sin(theta),
+                             0.1 * std::sin(phi)};
+  };
+  std::vector<g::Ray> ringRays[3] = {rays(center, 0.5, 1.0, ringPoint),
+                                     rays(center, 0.5, 0.0, ringPoint),
+                                     rays(center, 0.5, 0.5, ringPoint)};
+  intersectBenchmarks(suite, "torus-thin", ring, ringRays);
+
+  // The sphere of the first benchmark as 65k triangles.
+  m::Mesh mesh(sphereMesh(1.5f, 128), material,
+               g::Translate3D(center.x, center.y, center.z));
+  std::vector<g::Ray> meshRays[3] = {rays(center, 1.5, 1.0, spherePoint),
+                                     rays(center, 1.5, 0.0, spherePoint),
+                                     rays(center, 1.5, 0.5, spherePoint)};
+  intersectBenchmarks(suite, "mesh", mesh, meshRays);
+
+  // Shading queries at hit points.
+  std::vector<g::Point3D> sphereHits, torusHits;
+  {
+    m::RandomStream random(4);
+    for (size_t i = 0; i < Batch; ++i) {
+      sphereHits.push_back(spherePoint(random));
+      torusHits.push_back(torusPoint(random));
+    }
+  }
+  suite.run("shading-point/sphere/uv", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Point3D const& x : sphereHits) sum += sphere.getUV(x).x;
+    doNotOptimize(sum);
+  });
+  suite.run("shading-point/torus/uv+normal", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Point3D const& x : torusHits)
+      sum += torus.getUV(x).x + torus.normal(x).x;
+    doNotOptimize(sum);
+  });
+
+  m::RandomStream random(2);
+  std::vector<g::Vector3D> vectors;
+  std::vector<g::Point3D> points;
+  for (size_t i = 0; i < Batch; ++i) {
+    vectors.push_back(randomDirection(random) * (0.5 + random.uniform()));
+    points.push_back(randomDirection(random) * 5.0);
+  }
+
+  suite.run("Normal3D/construct", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Vector3D const& v : vectors) sum += g::Normal3D(v).x;
+    doNotOptimize(sum);
+  });
+  suite.run("Normal3D/fast", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Vector3D const& v : vectors) sum += g::Normal3D::fast(v).x;
+    doNotOptimize(sum);
+  });
+  batchBenchmarks<4>(suite, vectors);
+  batchBenchmarks<8>(suite, vectors);
+  mathBenchmarks(suite);
+
+  g::Matrix<4, 4> transform = g::Translate3D(1.0, 2.0, 3.0) *
+                              g::RotateY3D(0.4) * g::RotateX3D(-0.3) *
+                              g::Scale3D(1.5);
+  suite.run("Matrix44/point", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Point3D const& p : points) sum += (transform * p).x;
+    doNotOptimize(sum);
+  });
+  suite.run("Matrix44/normal", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Vector3D const& v : vectors)
+      sum += (transform * g::Normal3D(v)).x;
+    doNotOptimize(sum);
+  });
+  suite.run("Matrix44/ray", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Ray const& ray : sphereRays[2]) sum += (transform * ray).start.x;
+    doNotOptimize(sum);
+  });
+  suite.run("Matrix44/multiply", 1, [&]() {
+    g::Matrix<4, 4> product = transform * transform;
+    doNotOptimize(product);
+  });
+  suite.run("Matrix44/inverse", 1, [&]() {
+    g::Matrix<4, 4> inverse = transform.inv();
+    doNotOptimize(inverse);
+  });
+
+  g::Affine3D affine(transform);
+  suite.run("Affine3D/point", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Point3D const& p : points) sum += (affine * p).x;
+    doNotOptimize(sum);
+  });
+  suite.run("Affine3D/normal", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Vector3D const& v : vectors) sum += (affine * g::Normal3D(v)).x;
+    doNotOptimize(sum);
+  });
+  suite.run("Affine3D/ray", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (g::Ray const& ray : sphereRays[2]) sum += (affine * ray).start.x;
+    doNotOptimize(sum);
+  });
+  suite.run("Affine3D/multiply", 1, [&]() {
+    g::Affine3D product = affine * affine;
+    doNotOptimize(product);
+  });
+  suite.run("Affine3D/inverse", 1, [&]() {
+    g::Affine3D inverse = affine.inverse();
+    doNotOptimize(inverse);
+  });
+}
+
+}  // namespace bench
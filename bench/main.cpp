@@ -0,0 +1,76 @@
+#include <platform/Cpu.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+#include "Bench.h"
+
+// Usage: raytracing_bench [--filter SUBSTRING] [--repetitions N]
+//                         [--json FILE] [--isa LEVEL]
+//
+// --isa runs the multiversioned kernels at the given instruction set level:
+// baseline, sse4, avx2 or avx512.
+//
+// Exits with an error if a benchmark is outside a bound on its counters,
+// such as the hit accuracy of the torus.
+int main(int argc, char** argv) {
+  bench::Options options;
+  std::string json;
+  std::string isa;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (std::strcmp(argv[i], "--filter") == 0)
+      options.filter = argv[i + 1];
+    else if (std::strcmp(argv[i], "--repetitions") == 0)
+      options.repetitions = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--json") == 0)
+      json = argv[i + 1];
+    else if (std::strcmp(argv[i], "--isa") == 0)
+      isa = argv[i + 1];
+  }
+
+  bench::Suite suite(options);
+  try {
+    if (!isa.empty())
+      platform::forceIsaLevel(platform::parseIsaLevel(isa));
+    std::cout << "instruction set level: "
+              << platform::isaLevelName(platform::isaLevel()) << std::endl;
+    bench::geometryBenchmarks(suite);
+    bench::shadingBenchmarks(suite);
+    bench::colorBenchmarks(suite);
+    bench::meshBenchmarks(suite);
+    bench::accuracyBenchmarks(suite);
+  } catch (char const* error) {
+    std::cerr << error << std::endl;
+    return 1;
+  }
+
+  std::cout << std::left << std::setw(40) << "benchmark" << std::right
+            << std::setw(12) << "median" << std::setw(12) << "mean"
+            << std::setw(12) << "stddev" << "  ns/op" << std::endl;
+  for (auto const& r : suite.results()) {
+    std::cout << std::left << std::setw(40) << r.name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(12)
+              << r.median << std::setw(12) << r.mean << std::setw(12)
+              << r.stddev;
+    for (auto const& [key, value] : r.counters)
+      std::cout << "  " << key << "=" << std::defaultfloat
+                << std::setprecision(3) << value;
+    std::cout << std::endl;
+  }
+
+  if (!json.empty()) {
+    std::ofstream out(json);
+    suite.writeJSON(out);
+    if (!out) {
+      std::cerr << "Cannot write " << json << std::endl;
+      return 1;
+    }
+  }
+
+  for (auto const& failure : suite.failures())
+    std::cerr << "FAILED " << failure << std::endl;
+  return suite.failures().empty() ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include <modelling/MeshLoader.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include "Bench.h"
+
+namespace m = modelling;
+
+namespace bench {
+
+m::MeshData sphereMesh(float radius, size_t rings) {
+  size_t segments = 2 * rings;
+  m::MeshData data;
+  for (size_t j = 0; j <= rings; ++j) {
+    double phi = M_PI * double(j) / double(rings);
+    for (size_t i = 0; i <= segments; ++i) {
+      double theta = 2.0 * M_PI * double(i) / double(segments);
+      data.positions.push_back(
+          float(radius * std::sin(phi) * std::cos(theta)));
+      data.positions.push_back(
+          float(radius * std::sin(phi) * std::sin(theta)));
+      data.positions.push_back(float(radius * std::cos(phi)));
+    }
+  }
+  for (size_t j = 0; j < rings; ++j)
+    for (size_t i = 0; i < segments; ++i) {
+      uint32_t a = uint32_t(j * (segments + 1) + i);
+      uint32_t b = a + uint32_t(segments + 1);
+      uint32_t quad[6] = {a, b, b + 1, a, b + 1, a + 1};
+      data.indices.insert(data.indices.end(), quad, quad + 6);
+    }
+  return data;
+}
+
+static void writeObj(std::string const& filename, m::MeshData const& data) {
+  std::ofstream out(filename);
+  char line[96];
+  for (size_t i = 0; i < data.positions.size(); i += 3) {
+    std::snprintf(line, sizeof(line), "v %.7g %.7g %.7g\n",
+                  double(data.positions[i]), double(data.positions[i + 1]),
+                  double(data.positions[i + 2]));
+    out << line;
+  }
+  for (size_t i = 0; i < data.indices.size(); i += 3)
+    out << "f " << data.indices[i] + 1 << ' ' << data.indices[i + 1] + 1
+        << ' ' << data.indices[i + 2] + 1 << '\n';
+  if (!out) throw "Cannot write the OBJ file of the mesh benchmark";
+}
+
+// Binary little endian PLY, written as the bytes of this machine.
+static void writePly(std::string const& filename, m::MeshData const& data) {
+  std::ofstream out(filename, std::ios::binary);
+  out << "ply\nformat binary_little_endian 1.0\n"
+      << "element vertex " << data.vertexCount() << '\n'
+      << "property float x\nproperty float y\nproperty float z\n"
+      << "element face " << data.triangleCount() << '\n'
+      << "property list uchar int vertex_indices\nend_header\n";
+  out.write(reinterpret_cast<char const*>(data.positions.data()),
+            std::streamsize(data.positions.size() * sizeof(float)));
+  for (size_t i = 0; i < data.indices.size(); i += 3) {
+    char face[13];
+    face[0] = 3;
+    std::memcpy(face + 1, &data.indices[i], 3 * sizeof(uint32_t));
+    out.write(face, sizeof(face));
+  }
+  if (!out) throw "Cannot write the PLY file of the mesh benchmark";
+}
+
+// Imports of a sphere of 262k triangles. An operation is a byte of the
+// file, so that 1000 / (ns/op) is the throughput in MB/s.
+void meshBenchmarks(Suite& suite) {
+  m::MeshData data = sphereMesh(1.0f, 256);
+  std::filesystem::path directory = std::filesystem::temp_directory_path();
+  std::string formats[2] = {"obj", "ply"};
+  for (std::string const& format : formats) {
+    std::string filename =
+        (directory / ("raytracing_bench_mesh." + format)).string();
+    if (format == "obj")
+      writeObj(filename, data);
+    else
+      writePly(filename, data);
+    size_t bytes = std::filesystem::file_size(filename);
+    suite.run("mesh/load/" + format, bytes, [&]() {
+      m::MeshData loaded = m::loadMesh(filename);
+      doNotOptimize(loaded.indices.data());
+    });
+    std::filesystem::remove(filename);
+  }
+}
+
+}  // namespace bench
@@ -0,0 +1,181 @@
+#include <color/Image.h>
+#include <modelling/Emitter.h>
+#include <modelling/Material.h>
+#include <modelling/NormalMap.h>
+#include <modelling/Random.h>
+#include <modelling/Texture.h>
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+
+#include "Bench.h"
+
+namespace c = color;
+namespace g = geometry;
+namespace m = modelling;
+
+namespace bench {
+
+static const size_t Batch = 1024;
+
+struct ShadingInput {
+  g::Normal3D N, V, L;
+  g::TexCoord uv;
+};
+
+// A 512 x 512 pattern written to a temporary PNG, since textures are only
+// loaded from files.
+static std::string patternFile(std::string const& name) {
+  c::ImageSize size{512, 512};
+  c::ImageData data(size.width * size.height, c::RGB(0.0, 0.0, 0.0));
+  for (size_t y = 0; y < size.height; ++y)
+    for (size_t x = 0; x < size.width; ++x)
+      data[y * size.width + x] =
+          c::RGB(0.5 + 0.4 * std::sin(0.05 * double(x)),
+                 0.5 + 0.4 * std::cos(0.07 * double(y)),
+                 0.5 + 0.1 * std::sin(0.03 * double(x + y)));
+  std::string path =
+      (std::filesystem::temp_directory_path() / ("raytracing_bench_" + name))
+          .string();
+  c::saveImage(path, {size, data});
+  return path;
+}
+
+static double uniform(m::RandomStream& random, double a, double b) {
+  return a + (b - a) * random.uniform();
+}
+
+static std::vector<ShadingInput> shadingInputs() {
+  m::RandomStream random(3);
+  auto hemisphere = [&](g::Normal3D const& N) {
+    double z = random.uniform(), phi = 2.0 * M_PI * random.uniform();
+    double s = std::sqrt(1.0 - z * z);
+    g::Normal3D d{s * std::cos(phi), s * std::sin(phi), z};
+    return d * N < 0 ? -d : d;
+  };
+
+  std::vector<ShadingInput> inputs;
+  for (size_t i = 0; i < Batch; ++i) {
+    g::Normal3D N(uniform(random, -0.3, 0.3), uniform(random, -0.3, 0.3),
+                  1.0);
+    g::TexCoord uv({random.uniform(), random.uniform()},
+                   {uniform(random, 0.0, 0.01), 0.0},
+                   {0.0, uniform(random, 0.0, 0.01)});
+    inputs.push_back({N, hemisphere(N), hemisphere(N), uv});
+  }
+  return inputs;
+}
+
+static void materialBenchmarks(Suite& suite, std::string const& name,
+                               m::Material const& material,
+                               std::vector<ShadingInput> const& inputs) {
+  suite.run("Material/" + name + "/reflection", Batch, [&]() {
+    c::Intensity sum = 0.0;
+    for (ShadingInput const& in : inputs)
+      sum += material.reflection(in.N, in.V, in.uv).prob;
+    doNotOptimize(sum);
+  });
+  suite.run("Material/" + name + "/BRDF", Batch, [&]() {
+    c::Intensity sum = 0.0;
+    for (ShadingInput const& in : inputs)
+      sum += material.BRDF(in.L, in.N, in.V, in.uv).intensities()[0];
+    doNotOptimize(sum);
+  });
+}
+
+void shadingBenchmarks(Suite& suite) {
+  std::vector<ShadingInput> inputs = shadingInputs();
+  m::threadRandom().seed(4);
+
+  std::string texturePath = patternFile("texture.png");
+  auto texture = std::make_shared<m::Texture>(texturePath);
+  m::Texture nearest(texturePath, m::Texture::Nearest);
+  std::string normalPath = patternFile("normal.png");
+  m::NormalMap normalMap(normalPath);
+
+  suite.run("Texture/get/bilinear", Batch, [&]() {
+    c::Intensity sum = 0.0;
+    for (ShadingInput const& in : inputs)
+      sum += texture->get(in.uv).intensities()[0];
+    doNotOptimize(sum);
+  });
+  suite.run("Texture/get/nearest", Batch, [&]() {
+    c::Intensity sum = 0.0;
+    for (ShadingInput const& in : inputs)
+      sum += nearest.get(in.uv).intensities()[0];
+    doNotOptimize(sum);
+  });
+  // Storage formats, with the bytes over all mip levels per texel of the
+  // 512 x 512 base level.
+  for (auto [name, format] : {std::pair{"UNorm8", m::Texture::UNorm8},
+                              std::pair{"SRGB8", m::Texture::SRGB8},
+                              std::pair{"Half", m::Texture::Half},
+                              std::pair{"Float", m::Texture::Float}}) {
+    m::Texture formatted(texturePath, m::Texture::Bilinear, format);
+    double bytesPerTexel =
+        static_cast<double>(formatted.memoryUsage()) / (512.0 * 512.0);
+    suite.run(std::string("Texture/get/bilinear/") + name, Batch, [&]() {
+      c::Intensity sum = 0.0;
+      for (ShadingInput const& in : inputs)
+        sum += formatted.get(in.uv).intensities()[0];
+      doNotOptimize(sum);
+    }, {{"bytes/texel", bytesPerTexel}});
+  }
+  suite.run("NormalMap/get", Batch, [&]() {
+    g::Coord sum = 0.0;
+    for (ShadingInput const& in : inputs) sum += normalMap.get(in.uv).x;
+    doNotOptimize(sum);
+  });
+
+  c::SColor white({0.8, 0.8, 0.8}), black({0.0, 0.0, 0.0});
+  materialBenchmarks(suite, "Diffuse", m::DiffuseMaterial(white), inputs);
+  materialBenchmarks(suite, "DiffuseTextured",
+                     m::DiffuseMaterial(white, texture), inputs);
+  materialBenchmarks(suite, "Specular", m::SpecularMaterial(white, 32.0),
+                     inputs);
+  materialBenchmarks(suite, "IdealReflector", m::IdealReflector(white), inputs);
+  materialBenchmarks(suite, "IdealRefractor", m::IdealRefractor(white, 1.5),
+                     inputs);
+  materialBenchmarks(
+      suite, "General/plastic",
+      m::GeneralMaterial(white, c::SColor(0.2), 32.0, black, black, 0.0),
+      inputs);
+  materialBenchmarks(suite, "General/textured",
+                     m::GeneralMaterial(white, c::SColor(0.2), 32.0, black,
+                                        black, 0.0, texture),
+                     inputs);
+  materialBenchmarks(
+      suite, "General/glass",
+      m::GeneralMaterial(black, c::SColor(0.1), 64.0, black, white, 1.1),
+      inputs);
+  materialBenchmarks(
+      suite, "General/mirror",
+      m::GeneralMaterial(black, c::SColor(0.2), 64.0, white, black, 0.0),
+      inputs);
+
+  m::RandomStream random(5);
+  std::vector<g::Point3D> points;
+  for (size_t i = 0; i < Batch; ++i)
+    points.push_back({uniform(random, -5.0, 5.0), uniform(random, -4.0, 0.0),
+                      uniform(random, -10.0, -2.0)});
+
+  m::PositionalLight positional({0.0, 3.5, -2.0}, c::SColor(100.0));
+  m::SphereLight sphere({0.0, 3.5, -2.0}, 0.3, c::SColor(100.0));
+  for (auto [name, emitter] : {std::pair<char const*, m::Emitter*>{
+                                   "Positional", &positional},
+                               {"Sphere", &sphere}}) {
+    suite.run(std::string("Emitter/") + name + "/emission", Batch, [&]() {
+      c::Intensity sum = 0.0;
+      for (g::Point3D const& x : points)
+        sum += emitter->emission(x, g::Normal3D{0.0, 1.0, 0.0})
+                   .Le.intensities()[0];
+      doNotOptimize(sum);
+    });
+  }
+
+  std::remove(texturePath.c_str());
+  std::remove(normalPath.c_str());
+}
+
+}  // namespace bench
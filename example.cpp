@@ -1,6 +1,8 @@
 #include <color/Image.h>
+#include <color/PostProcess.h>
 #include <color/Spectrum.h>
 #include <geometry/Matrix.h>
+#include <modelling/AssetRegistry.h>
 #include <modelling/Camera.h>
 #include <modelling/Emitter.h>
 #include <modelling/Primitive.h>
@@ -22,34 +24,34 @@ int example() {
       {0.0, std::cos(angle), std::sin(angle)},
       {0.0, 5.0 - 3.5 * std::sin(angle), 3.5 * std::cos(angle)});
 
+  // Images are decoded in the background while the scene is built.
+  m::AssetRegistry assets;
+
   // Normal maps
-  std::shared_ptr<m::NormalMap> ballNormal = std::make_shared<m::NormalMap>(
-      "resources/basketballNormal.png", m::NormalMap::Bilinear);
-  std::shared_ptr<m::NormalMap> dropsNormal = std::make_shared<m::NormalMap>(
-      "resources/dropsNormal.png", m::NormalMap::Bilinear);
-  std::shared_ptr<m::NormalMap> brick1Normal = std::make_shared<m::NormalMap>(
-      "resources/brick1Normal.png", m::NormalMap::Bilinear);
-  std::shared_ptr<m::NormalMap> earthNormal = std::make_shared<m::NormalMap>(
-      "resources/earthNormal.png", m::NormalMap::Bilinear);
-  std::shared_ptr<m::NormalMap> stoneNormal = std::make_shared<m::NormalMap>(
-      "resources/stoneNormal.png", m::NormalMap::Bilinear);
+  std::shared_ptr<m::NormalMap> ballNormal =
+      assets.normalMap("resources/basketballNormal.png");
+  std::shared_ptr<m::NormalMap> dropsNormal =
+      assets.normalMap("resources/dropsNormal.png");
+  std::shared_ptr<m::NormalMap> brick1Normal =
+      assets.normalMap("resources/brick1Normal.png");
+  std::shared_ptr<m::NormalMap> earthNormal =
+      assets.normalMap("resources/earthNormal.png");
+  std::shared_ptr<m::NormalMap> stoneNormal =
+      assets.normalMap("resources/stoneNormal.png");
   std::shared_ptr<m::NormalMap> concrete1Normal =
-      std::make_shared<m::NormalMap>("resources/concrete1Normal.png",
-                                     m::NormalMap::Bilinear);
+      assets.normalMap("resources/concrete1Normal.png");
 
   // Textures
-  std::shared_ptr<m::Texture> ballText = std::make_shared<m::Texture>(
-      "resources/basketball.png", m::Texture::Bilinear);
-  std::shared_ptr<m::Texture> earthText =
-      std::make_shared<m::Texture>("resources/earth.png", m::Texture::Bilinear);
-  std::shared_ptr<m::Texture> billiardText = std::make_shared<m::Texture>(
-      "resources/billiard.png", m::Texture::Bilinear);
-  std::shared_ptr<m::Texture> stoneText =
-      std::make_shared<m::Texture>("resources/stone.png", m::Texture::Bilinear);
-  std::shared_ptr<m::Texture> brick1Text = std::make_shared<m::Texture>(
-      "resources/brick1.png", m::Texture::Bilinear);
-  std::shared_ptr<m::Texture> concrete1Text = std::make_shared<m::Texture>(
-      "resources/concrete1.png", m::Texture::Bilinear);
+  std::shared_ptr<m::Texture> ballText =
+      assets.texture("resources/basketball.png");
+  std::shared_ptr<m::Texture> earthText = assets.texture("resources/earth.png");
+  std::shared_ptr<m::Texture> billiardText =
+      assets.texture("resources/billiard.png");
+  std::shared_ptr<m::Texture> stoneText = assets.texture("resources/stone.png");
+  std::shared_ptr<m::Texture> brick1Text =
+      assets.texture("resources/brick1.png");
+  std::shared_ptr<m::Texture> concrete1Text =
+      assets.texture("resources/concrete1.png");
 
   // Materials
   std::shared_ptr<m::Material> stoneMat = std::make_shared<m::GeneralMaterial>(
@@ -148,9 +150,15 @@ int example() {
   scene.emitters.emplace_back(std::make_shared<m::SphereLight>(
       g::Point3D{-4.0, 3.0, -0.0}, 0.4, c::SColor({6.3, 2.3, 1.4}) * 100.0));
 
+  // Decoding errors surface here rather than inside the render threads.
+  assets.wait();
+
   color::ImageSize imageSize{2 * 320, 2 * 240};  //{640, 480};
   auto start = std::chrono::steady_clock::now();
-  color::ImageData imageData = render(scene, imageSize, 8);
+  rendering::RenderSettings settings;
+  settings.gridSize = 8;
+  color::Framebuffer framebuffer =
+      renderFramebuffer(scene, imageSize, settings);
   auto end = std::chrono::steady_clock::now();
 
   std::cout << "Elapsed time: "
@@ -158,7 +166,9 @@ int example() {
                                                                      start)
                    .count()
             << " ms" << std::endl;
-  color::saveImage("example.png", {imageSize, imageData});
+  color::saveEXR("example.exr", framebuffer);
+  color::saveImage("example.png", imageSize,
+                   color::postProcess(framebuffer, {}));
   return 0;
 }
 
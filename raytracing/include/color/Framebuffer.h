@@ -0,0 +1,57 @@
+#pragma once
+
+#include <color/Image.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace color {
+
+/**
+ * @brief Linear, unclamped RGB image in 32-bit float or 16-bit half
+ * precision, row 0 at the top.
+ */
+class Framebuffer {
+ public:
+  enum Storage { Float = 1, Half = 2 };
+
+ public:
+  Framebuffer(ImageSize size, Storage storage = Float);
+
+  ImageSize size() const { return m_size; }
+  Storage storage() const { return m_storage; }
+
+  RGB get(size_t x, size_t y) const;
+  void set(size_t x, size_t y, RGB const& rgb);
+  // Adds rgb to the pixel without clamping.
+  void add(size_t x, size_t y, RGB const& rgb);
+  // Row y as 3 * width interleaved floats.
+  void row(size_t y, float* out) const;
+
+  // Bytes of pixel storage.
+  size_t memoryUsage() const;
+
+  // Display image, scaled by exposure and clamped to [0, 1].
+  Image toImage(Intensity exposure = 1.0) const;
+
+ private:
+  ImageSize m_size;
+  Storage m_storage;
+  std::vector<float> m_float;
+  std::vector<uint16_t> m_half;
+};
+
+// Portable float map, little-endian.
+void savePFM(std::string filename, Framebuffer const& framebuffer);
+Framebuffer loadPFM(std::string filename);
+
+// Compression of scanline OpenEXR files, numbered as in the format.
+enum class ExrCompression { None = 0, ZipScanline = 2, Zip = 3 };
+
+// Single-part scanline OpenEXR with R, G and B channels in the precision of
+// the framebuffer.
+void saveEXR(std::string filename, Framebuffer const& framebuffer,
+             ExrCompression compression = ExrCompression::Zip);
+
+}  // namespace color
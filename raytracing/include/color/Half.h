@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// IEEE 754 half precision conversions, rounding to nearest.
+
+namespace color {
+
+inline uint16_t floatToHalf(float f) {
+  uint32_t x;
+  std::memcpy(&x, &f, sizeof(x));
+  uint32_t sign = (x >> 16) & 0x8000u;
+  int32_t exponent = static_cast<int32_t>((x >> 23) & 0xffu) - 127 + 15;
+  uint32_t mantissa = x & 0x7fffffu;
+
+  if (exponent >= 31) {
+    // Overflow and infinity saturate to infinity, NaN stays NaN.
+    bool nan = ((x >> 23) & 0xffu) == 0xffu && mantissa != 0;
+    return static_cast<uint16_t>(sign | 0x7c00u | (nan ? 0x200u : 0u));
+  }
+  if (exponent <= 0) {
+    if (exponent < -10) return static_cast<uint16_t>(sign);
+    mantissa |= 0x800000u;
+    uint32_t shift = static_cast<uint32_t>(14 - exponent);
+    uint32_t half = mantissa >> shift;
+    if ((mantissa >> (shift - 1)) & 1u) ++half;
+    return static_cast<uint16_t>(sign | half);
+  }
+
+  uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) |
+                  (mantissa >> 13);
+  // Round to nearest; a carry into the exponent is still correct.
+  if (mantissa & 0x1000u) ++half;
+  return static_cast<uint16_t>(half);
+}
+
+inline float halfToFloat(uint16_t h) {
+  uint32_t sign = static_cast<uint32_t>(h & 0x8000u) << 16;
+  uint32_t exponent = (h >> 10) & 0x1fu;
+  uint32_t mantissa = h & 0x3ffu;
+
+  uint32_t x;
+  if (exponent == 0) {
+    if (mantissa == 0) {
+      x = sign;
+    } else {
+      // Subnormal: normalize the mantissa.
+      exponent = 127 - 15 + 1;
+      while ((mantissa & 0x400u) == 0) {
+        mantissa <<= 1;
+        --exponent;
+      }
+      x = sign | (exponent << 23) | ((mantissa & 0x3ffu) << 13);
+    }
+  } else if (exponent == 31) {
+    x = sign | 0x7f800000u | (mantissa << 13);
+  } else {
+    x = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+  }
+
+  float f;
+  std::memcpy(&f, &x, sizeof(f));
+  return f;
+}
+
+}  // namespace color
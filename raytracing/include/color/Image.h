@@ -2,6 +2,7 @@
 
 #include <color/RGB.h>
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -20,6 +21,9 @@ struct Image {
 };
 
 void saveImage(std::string filename, Image const& image);
+// Interleaved 8-bit RGB, e.g. from postProcess().
+void saveImage(std::string filename, ImageSize size,
+               std::vector<uint8_t> const& rgb);
 Image loadImage(std::string filename);
 
 }  // namespace color
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <color/Framebuffer.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace color {
+
+struct PostProcessSettings {
+  enum ToneMap { Clamp = 1, Reinhard = 2, ACES = 3 };
+
+  // Linear scale applied before tone mapping.
+  float exposure = 1.0f;
+  ToneMap toneMap = Clamp;
+  // Output encoding c^(1/gamma); 1 keeps the linear encoding the renderer
+  // has always written.
+  float gamma = 1.0f;
+  // Triangular noise of +-1 LSB before quantization, against banding.
+  bool dither = false;
+  // 0: one thread per hardware thread
+  size_t threads = 0;
+};
+
+// 8-bit RGB of the framebuffer, row 0 at the top. firstRow is the row of
+// the full image that the framebuffer starts at, which the dither pattern
+// depends on.
+std::vector<uint8_t> postProcess(Framebuffer const& framebuffer,
+                                 PostProcessSettings const& settings,
+                                 size_t firstRow = 0);
+
+}  // namespace color
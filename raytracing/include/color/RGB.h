@@ -2,6 +2,7 @@
 
 #include <color/Spectrum.h>
 
+#include <array>
 #include <iostream>
 
 namespace color {
@@ -12,6 +13,26 @@ namespace color {
 void ColorMatch(Lambda lambda, Intensity &r, Intensity &g,
                 Intensity &b);
 
+// Rows of the linear map from the intensities of a Spectrum<nLambdas> to r, g
+// and b: the color matching functions at its wavelengths times the width of
+// each wavelength's band. Computed once per spectrum type.
+template <size_t nLambdas>
+std::array<std::array<Intensity, nLambdas>, 3> const &spectrumToRGB() {
+  static const auto matrix = []() {
+    std::array<std::array<Intensity, nLambdas>, 3> m{};
+    Lambdas const &lambdas = Spectrum<nLambdas>().lambdas();
+    Lambda prevLambda = LAMBDALOW;
+    for (size_t i = 0; i < nLambdas; ++i) {
+      Lambda dl = (lambdas[i] - prevLambda) / (LAMBDAHIGH - LAMBDALOW);
+      ColorMatch(lambdas[i], m[0][i], m[1][i], m[2][i]);
+      for (auto &row : m) row[i] *= dl;
+      prevLambda = lambdas[i];
+    }
+    return m;
+  }();
+  return matrix;
+}
+
 struct RGB {
   RGB(Intensity r0, Intensity g0, Intensity b0) {
     r = r0;
@@ -19,29 +40,28 @@ struct RGB {
     b = b0;
   }
 
+  // Clamped to [0, 1].
   template <size_t nLambdas>
   RGB(Spectrum<nLambdas> const &spectrum) {
-    this->r = 0.0;
-    this->g = 0.0;
-    this->b = 0.0;
+    RGB rgb = linear(spectrum);
+    this->r = std::max(color::Intensity(0.0), std::min(color::Intensity(1.0), rgb.r));
+    this->g = std::max(color::Intensity(0.0), std::min(color::Intensity(1.0), rgb.g));
+    this->b = std::max(color::Intensity(0.0), std::min(color::Intensity(1.0), rgb.b));
+  }
 
-    Lambda prevLambda = LAMBDALOW;
-    Lambdas const &lambdas = spectrum.lambdas();
-    Lambdas const &intensities = spectrum.intensities();
-
-    for (size_t i = 0; i < lambdas.size(); ++i) {
-      Intensity r, g, b;
-      Lambda dl;
-      ColorMatch(lambdas[i], r, g, b);
-      dl = (lambdas[i] - prevLambda) / (LAMBDAHIGH - LAMBDALOW);
-      this->r += r * intensities[i] * dl;
-      this->g += g * intensities[i] * dl;
-      this->b += b * intensities[i] * dl;
-      prevLambda = lambdas[i];
+  // Unclamped linear RGB of a spectrum.
+  template <size_t nLambdas>
+  static RGB linear(Spectrum<nLambdas> const &spectrum) {
+    auto const &m = spectrumToRGB<nLambdas>();
+    Intensities const &intensities = spectrum.intensities();
+
+    RGB rgb(0.0, 0.0, 0.0);
+    for (size_t i = 0; i < nLambdas; ++i) {
+      rgb.r += m[0][i] * intensities[i];
+      rgb.g += m[1][i] * intensities[i];
+      rgb.b += m[2][i] * intensities[i];
     }
-    this->r = std::max(color::Intensity(0.0), std::min(color::Intensity(1.0), this->r));
-    this->g = std::max(color::Intensity(0.0), std::min(color::Intensity(1.0), this->g));
-    this->b = std::max(color::Intensity(0.0), std::min(color::Intensity(1.0), this->b));
+    return rgb;
   }
 
   operator SColor() const {
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <color/Framebuffer.h>
+#include <color/PostProcess.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace color {
+
+/**
+ * @brief Destination of an image that arrives in bands of rows, top to
+ * bottom. Only the band being written is held in memory.
+ */
+class RowWriter {
+ public:
+  virtual ~RowWriter() = default;
+
+  // The next rows.size().height rows of the image.
+  virtual void write(Framebuffer const& rows) = 0;
+  // Completes the file after the last row.
+  virtual void finish() = 0;
+};
+
+/**
+ * @brief 8-bit PNG, tone mapped with settings. Each band is filtered and
+ * deflated in parallel stripes that are appended to one zlib stream.
+ */
+class PNGRowWriter : public RowWriter {
+ public:
+  PNGRowWriter(std::string const& filename, ImageSize size,
+               PostProcessSettings settings = {});
+  ~PNGRowWriter() override;
+
+  void write(Framebuffer const& rows) override;
+  // The next `rows` rows as interleaved 8-bit RGB.
+  void writeBytes(uint8_t const* bytes, size_t rows);
+  void finish() override;
+
+ private:
+  void writeChunk(char const* type, uint8_t const* data, size_t size);
+
+ private:
+  FILE* m_file;
+  ImageSize m_size;
+  PostProcessSettings m_settings;
+  size_t m_row;
+  unsigned long m_adler;
+};
+
+/**
+ * @brief Scanline OpenEXR as written by saveEXR(). Blocks are written as
+ * soon as their lines are complete; the offset table is filled in by
+ * finish().
+ */
+class EXRRowWriter : public RowWriter {
+ public:
+  EXRRowWriter(std::string const& filename, ImageSize size,
+               Framebuffer::Storage storage,
+               ExrCompression compression = ExrCompression::Zip);
+  ~EXRRowWriter() override;
+
+  void write(Framebuffer const& rows) override;
+  void finish() override;
+
+ private:
+  // Writes `blocks` blocks of rows starting at line `first` of rows.
+  void writeBlocks(Framebuffer const& rows, size_t first, size_t blocks,
+                   size_t lines);
+
+ private:
+  FILE* m_file;
+  ImageSize m_size;
+  Framebuffer::Storage m_storage;
+  ExrCompression m_compression;
+  size_t m_linesPerBlock;
+  size_t m_row;
+  uint64_t m_tableOffset;
+  uint64_t m_offset;
+  std::vector<uint64_t> m_offsets;
+  // Lines of an incomplete block.
+  std::unique_ptr<Framebuffer> m_pending;
+  size_t m_pendingRows;
+};
+
+}  // namespace color
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <geometry/Matrix.h>
+#include <geometry/Point3D.h>
+
+namespace geometry {
+
+/**
+ * @brief Affine transform p -> A p + t. The columns of A and t are stored as
+ * aligned rows of four, so that the fixed-size loops over them compile to
+ * SIMD multiply-adds. Normals are transformed by the inverse transpose of
+ * A, which is computed once on construction.
+ */
+class Affine3D {
+ public:
+  Affine3D() : Affine3D(Identity3D()) {}
+
+  // The last row of m has to be (0, 0, 0, 1).
+  explicit Affine3D(Matrix<4, 4> const &m) {
+    if (m.values[3][0] != 0.0 || m.values[3][1] != 0.0 ||
+        m.values[3][2] != 0.0 || m.values[3][3] != 1.0)
+      throw "Affine transform from a projective matrix";
+    for (size_t j = 0; j < 4; ++j)
+      for (size_t i = 0; i < 4; ++i)
+        m_columns[j][i] = i < 3 ? m.values[i][j] : 0.0;
+    computeNormalMatrix();
+  }
+
+  Point3D operator*(Point3D const &p) const {
+    return transform(m_columns, p, true);
+  }
+
+  // Inverse transpose of A applied to n.
+  Normal3D operator*(Normal3D const &n) const {
+    return transform(m_normalColumns, n, false);
+  }
+
+  // The direction is transformed by A and normalized.
+  Ray operator*(Ray const &ray) const {
+    return {*this * ray.start, linear(ray.direction)};
+  }
+
+  // A v, without the translation.
+  Vector3D linear(Vector3D const &v) const {
+    return transform(m_columns, v, false);
+  }
+
+  Affine3D operator*(Affine3D const &other) const {
+    Affine3D r(Uninitialized{});
+    compose(m_columns, other.m_columns, r.m_columns, true);
+    // (A B)^-T = A^-T B^-T
+    compose(m_normalColumns, other.m_normalColumns, r.m_normalColumns,
+            false);
+    return r;
+  }
+
+  Affine3D inverse() const {
+    Affine3D r(Uninitialized{});
+    // A^-1 is the transpose of the normal matrix, and its inverse
+    // transpose is A^T.
+    for (size_t j = 0; j < 4; ++j) {
+      for (size_t i = 0; i < 4; ++i) {
+        bool linear = i < 3 && j < 3;
+        r.m_columns[j][i] = linear ? m_normalColumns[i][j] : 0.0;
+        r.m_normalColumns[j][i] = linear ? m_columns[i][j] : 0.0;
+      }
+    }
+    for (size_t i = 0; i < 3; ++i)
+      r.m_columns[3][i] = -(r.m_columns[0][i] * m_columns[3][0] +
+                            r.m_columns[1][i] * m_columns[3][1] +
+                            r.m_columns[2][i] * m_columns[3][2]);
+    return r;
+  }
+
+  Matrix<4, 4> matrix() const {
+    Matrix<4, 4> m = Identity3D();
+    for (size_t j = 0; j < 4; ++j)
+      for (size_t i = 0; i < 3; ++i) m.values[i][j] = m_columns[j][i];
+    return m;
+  }
+
+ private:
+  using Columns = Coord[4][4];
+
+  struct Uninitialized {};
+  explicit Affine3D(Uninitialized) {}
+
+  static Point3D transform(Columns const &columns, Point3D const &p,
+                           bool translate) {
+    alignas(32) Coord r[4];
+    for (size_t i = 0; i < 4; ++i)
+      r[i] = columns[0][i] * p.x + columns[1][i] * p.y + columns[2][i] * p.z;
+    if (translate)
+      for (size_t i = 0; i < 4; ++i) r[i] += columns[3][i];
+    return {r[0], r[1], r[2]};
+  }
+
+  // Columns of a b. With translate, the last columns are translations;
+  // otherwise they are zero.
+  static void compose(Columns const &a, Columns const &b, Columns &out,
+                      bool translate) {
+    for (size_t j = 0; j < 4; ++j)
+      for (size_t i = 0; i < 4; ++i)
+        out[j][i] = a[0][i] * b[j][0] + a[1][i] * b[j][1] +
+                    a[2][i] * b[j][2] +
+                    (translate && j == 3 ? a[3][i] : 0.0);
+  }
+
+  // Columns of the inverse transpose of A, by cofactors.
+  void computeNormalMatrix() {
+    auto a = [this](size_t i, size_t j) { return m_columns[j % 3][i % 3]; };
+    Coord cofactors[3][3];
+    for (size_t i = 0; i < 3; ++i)
+      for (size_t j = 0; j < 3; ++j)
+        cofactors[i][j] = a(i + 1, j + 1) * a(i + 2, j + 2) -
+                          a(i + 1, j + 2) * a(i + 2, j + 1);
+    Coord det = a(0, 0) * cofactors[0][0] + a(0, 1) * cofactors[0][1] +
+                a(0, 2) * cofactors[0][2];
+    if (det == 0.0) throw "Trying to invert a singular matrix";
+
+    for (size_t j = 0; j < 4; ++j)
+      for (size_t i = 0; i < 4; ++i)
+        m_normalColumns[j][i] = i < 3 && j < 3 ? cofactors[i][j] / det : 0.0;
+  }
+
+  alignas(32) Columns m_columns;
+  alignas(32) Columns m_normalColumns;
+};
+
+}  // namespace geometry
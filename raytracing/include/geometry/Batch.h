@@ -0,0 +1,165 @@
+#pragma once
+
+#include <geometry/Point3D.h>
+
+#include <cmath>
+
+// Batches of N coordinates, points and normals stored as structures of
+// arrays. The operations are fixed-size loops over aligned lanes, which the
+// compiler turns into packed instructions of the target ISA: a Point3Dx4
+// fills two SSE2 or one AVX register per coordinate, a Point3Dx8 one
+// AVX-512 register.
+
+namespace geometry {
+
+template <size_t N>
+struct CoordxN {
+  alignas(N * sizeof(Coord)) Coord v[N];
+
+  Coord operator[](size_t i) const { return v[i]; }
+  Coord &operator[](size_t i) { return v[i]; }
+};
+
+template <size_t N>
+struct Point3DxN {
+  alignas(N * sizeof(Coord)) Coord x[N];
+  alignas(N * sizeof(Coord)) Coord y[N];
+  alignas(N * sizeof(Coord)) Coord z[N];
+
+  static Point3DxN broadcast(Point3D const &p) {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i) r.x[i] = p.x, r.y[i] = p.y, r.z[i] = p.z;
+    return r;
+  }
+
+  // Lanes from N consecutive points.
+  static Point3DxN load(Point3D const *p) {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i) r.set(i, p[i]);
+    return r;
+  }
+
+  void store(Point3D *p) const {
+    for (size_t i = 0; i < N; ++i) p[i] = (*this)[i];
+  }
+
+  Point3D operator[](size_t i) const { return {x[i], y[i], z[i]}; }
+
+  void set(size_t i, Point3D const &p) {
+    x[i] = p.x;
+    y[i] = p.y;
+    z[i] = p.z;
+  }
+
+  Point3DxN operator-() const {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i)
+      r.x[i] = -x[i], r.y[i] = -y[i], r.z[i] = -z[i];
+    return r;
+  }
+
+  Point3DxN operator+(Point3DxN const &p) const {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i)
+      r.x[i] = x[i] + p.x[i], r.y[i] = y[i] + p.y[i], r.z[i] = z[i] + p.z[i];
+    return r;
+  }
+
+  Point3DxN operator-(Point3DxN const &p) const {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i)
+      r.x[i] = x[i] - p.x[i], r.y[i] = y[i] - p.y[i], r.z[i] = z[i] - p.z[i];
+    return r;
+  }
+
+  Point3DxN operator*(Coord s) const {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i)
+      r.x[i] = x[i] * s, r.y[i] = y[i] * s, r.z[i] = z[i] * s;
+    return r;
+  }
+
+  // Lane i scaled by s[i].
+  Point3DxN operator*(CoordxN<N> const &s) const {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i)
+      r.x[i] = x[i] * s.v[i], r.y[i] = y[i] * s.v[i], r.z[i] = z[i] * s.v[i];
+    return r;
+  }
+
+  // Dot products of the lanes.
+  CoordxN<N> operator*(Point3DxN const &p) const {
+    CoordxN<N> r;
+    for (size_t i = 0; i < N; ++i)
+      r.v[i] = x[i] * p.x[i] + y[i] * p.y[i] + z[i] * p.z[i];
+    return r;
+  }
+
+  // Cross products of the lanes.
+  Point3DxN operator%(Point3DxN const &p) const {
+    Point3DxN r;
+    for (size_t i = 0; i < N; ++i) {
+      r.x[i] = y[i] * p.z[i] - z[i] * p.y[i];
+      r.y[i] = z[i] * p.x[i] - x[i] * p.z[i];
+      r.z[i] = x[i] * p.y[i] - y[i] * p.x[i];
+    }
+    return r;
+  }
+
+  CoordxN<N> length() const {
+    CoordxN<N> r = *this * *this;
+    for (size_t i = 0; i < N; ++i) r.v[i] = std::sqrt(r.v[i]);
+    return r;
+  }
+};
+
+/**
+ * @brief Batch of unit vectors. Like Normal3D, construction from points
+ * normalizes; fast() trades accuracy for speed and fromUnit() skips the
+ * normalization of vectors that are unit length already.
+ */
+template <size_t N>
+struct Normal3DxN : Point3DxN<N> {
+  Normal3DxN(Point3DxN<N> const &p) : Point3DxN<N>(p) {
+    CoordxN<N> s = p * p;
+    for (size_t i = 0; i < N; ++i)
+      s.v[i] = 1.0 / (Normal3D::EPS + std::sqrt(s.v[i]));
+    scale(s);
+  }
+
+  static Normal3DxN fast(Point3DxN<N> const &p) {
+    Normal3DxN r(p, Unit{});
+    CoordxN<N> s = p * p;
+    for (size_t i = 0; i < N; ++i) s.v[i] = fastRsqrt(s.v[i]);
+    r.scale(s);
+    return r;
+  }
+
+  static Normal3DxN fromUnit(Point3DxN<N> const &p) {
+    return Normal3DxN(p, Unit{});
+  }
+
+  Normal3D operator[](size_t i) const {
+    return Normal3D::fromUnit(Point3DxN<N>::operator[](i));
+  }
+
+  Normal3DxN operator-() const { return fromUnit(Point3DxN<N>::operator-()); }
+
+ private:
+  struct Unit {};
+  Normal3DxN(Point3DxN<N> const &p, Unit) : Point3DxN<N>(p) {}
+
+  void scale(CoordxN<N> const &s) {
+    for (size_t i = 0; i < N; ++i)
+      this->x[i] *= s.v[i], this->y[i] *= s.v[i], this->z[i] *= s.v[i];
+  }
+};
+
+using Coordx4 = CoordxN<4>;
+using Coordx8 = CoordxN<8>;
+using Point3Dx4 = Point3DxN<4>;
+using Point3Dx8 = Point3DxN<8>;
+using Normal3Dx4 = Normal3DxN<4>;
+using Normal3Dx8 = Normal3DxN<8>;
+
+}  // namespace geometry
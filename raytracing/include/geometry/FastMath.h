@@ -0,0 +1,292 @@
+#pragma once
+
+#include <geometry/Batch.h>
+#include <geometry/types.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Polynomial approximations of the transcendental functions of UV mapping,
+// torus intersection and BSDF sampling. Most are truncated series after a
+// range reduction, so that their error bounds follow from the first
+// omitted term; the bounds below hold for the results in double precision.
+// The functions compute both sides of every case and select, with no
+// branches or table lookups, so that loops over them vectorize under
+// -fno-trapping-math; the CoordxN overloads are such loops.
+//
+// The functions of namespace math are the ones the renderer calls. They
+// are the approximations when the library is built with
+// RAYTRACING_FAST_MATH, and those of <cmath> otherwise.
+
+namespace geometry {
+
+inline uint64_t toBits(Coord x) {
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+inline Coord fromBits(uint64_t bits) {
+  Coord x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// Adding it to |x| < 2^51 rounds x to an integer, which the low bits of
+// the sum hold in two's complement.
+constexpr Coord IntegerShifter = 6755399441055744.0;  // 1.5 * 2^52
+
+inline Coord roundToInteger(Coord x) {
+  return (x + IntegerShifter) - IntegerShifter;
+}
+
+// The integer n, |n| < 2^51, in two's complement.
+inline uint64_t integerBits(Coord n) {
+  return toBits(n + IntegerShifter) - toBits(IntegerShifter);
+}
+
+// 2^n for an integer n in [-1022, 1023].
+inline Coord exp2Integer(Coord n) {
+  return fromBits((integerBits(n) + 1023) << 52);
+}
+
+/**
+ * @brief sin and cos of x. x is reduced to r in [-pi/4, pi/4] by a
+ * multiple of pi/2 split in two parts, which is exact for |x| < 2^20; the
+ * Taylor series to r^11 and r^12 then have an absolute error below 7e-12.
+ */
+inline void fastSinCos(Coord x, Coord& sin, Coord& cos) {
+  const Coord piOver2High = 1.57079632673412561417;
+  const Coord piOver2Low = 6.07710050650619224932e-11;
+  Coord k = roundToInteger(x * (2.0 / M_PI));
+  Coord r = (x - k * piOver2High) - k * piOver2Low;
+  Coord r2 = r * r;
+
+  Coord s = -1.0 / 39916800.0;
+  s = s * r2 + 1.0 / 362880.0;
+  s = s * r2 - 1.0 / 5040.0;
+  s = s * r2 + 1.0 / 120.0;
+  s = s * r2 - 1.0 / 6.0;
+  s = r + r * r2 * s;
+
+  Coord c = 1.0 / 479001600.0;
+  c = c * r2 - 1.0 / 3628800.0;
+  c = c * r2 + 1.0 / 40320.0;
+  c = c * r2 - 1.0 / 720.0;
+  c = c * r2 + 1.0 / 24.0;
+  c = c * r2 - 0.5;
+  c = 1.0 + r2 * c;
+
+  // Quadrant k mod 4: (sin, cos) is (s, c), (c, -s), (-s, -c) or (-c, s).
+  // Bit 0 of k swaps them, bits 1 of k and k + 1 negate them.
+  uint64_t q = integerBits(k);
+  uint64_t swap = 0 - (q & 1);
+  uint64_t sBits = toBits(s), cBits = toBits(c);
+  sin = fromBits(((cBits & swap) | (sBits & ~swap)) ^ ((q & 2) << 62));
+  cos = fromBits(((sBits & swap) | (cBits & ~swap)) ^ (((q + 1) & 2) << 62));
+}
+
+// atan(z) for |z| <= tan(pi/8) from its series up to z^21, which is
+// within 7e-11.
+inline Coord atanSeries(Coord z) {
+  Coord z2 = z * z;
+  Coord p = 1.0 / 21.0;
+  p = p * z2 - 1.0 / 19.0;
+  p = p * z2 + 1.0 / 17.0;
+  p = p * z2 - 1.0 / 15.0;
+  p = p * z2 + 1.0 / 13.0;
+  p = p * z2 - 1.0 / 11.0;
+  p = p * z2 + 1.0 / 9.0;
+  p = p * z2 - 1.0 / 7.0;
+  p = p * z2 + 1.0 / 5.0;
+  p = p * z2 - 1.0 / 3.0;
+  return z + z * z2 * p;
+}
+
+/**
+ * @brief atan2(y, x) within 1e-10. With a = min(|x|, |y|) / max(|x|, |y|),
+ * atan(a) is atanSeries(a), or pi/4 + atanSeries((a - 1) / (a + 1)) above
+ * tan(pi/8); either takes one division. The sign of a zero x is ignored.
+ */
+inline Coord fastAtan2(Coord y, Coord x) {
+  Coord ax = std::abs(x), ay = std::abs(y);
+  Coord high = std::max(ax, ay), low = std::min(ax, ay);
+  bool upper = low > 0.41421356237309504880 * high;
+  Coord numerator = upper ? low - high : low;
+  Coord denominator = upper ? low + high : high > 0.0 ? high : 1.0;
+  Coord r = atanSeries(numerator / denominator);
+  r = upper ? M_PI / 4.0 + r : r;
+  r = ay > ax ? M_PI / 2.0 - r : r;
+  r = x < 0.0 ? M_PI - r : r;
+  return std::copysign(r, y);
+}
+
+// asin(x) for x in [-1, 1] as atan2(x, sqrt(1 - x^2)); error below 1e-10.
+inline Coord fastAsin(Coord x) {
+  return fastAtan2(x, std::sqrt((1.0 - x) * (1.0 + x)));
+}
+
+// acos(x) for x in [-1, 1]; error below 1e-10.
+inline Coord fastAcos(Coord x) {
+  return fastAtan2(std::sqrt((1.0 - x) * (1.0 + x)), x);
+}
+
+/**
+ * @brief log2(x) for normal x > 0. With x = 2^e m and m in [sqrt(1/2),
+ * sqrt(2)), ln m = 2 atanh(s) for s = (m - 1) / (m + 1), |s| < 0.172; the
+ * series to s^13 is within 5e-13, the result within 1e-12.
+ */
+inline Coord fastLog2(Coord x) {
+  uint64_t bits = toBits(x);
+  // Biased exponent of x / sqrt(2), so that m lands in the range.
+  uint64_t biased = (bits - 0x3fe6a09e667f3bcdull + (1023ull << 52)) >> 52;
+  Coord m = fromBits(bits - (biased << 52) + (1023ull << 52));
+  Coord e = fromBits(biased | toBits(4503599627370496.0)) -
+            (4503599627370496.0 + 1023.0);  // 2^52 + biased - 2^52 - 1023
+
+  // The series in Estrin's scheme, for a shorter dependency chain than
+  // Horner's.
+  Coord s = (m - 1.0) / (m + 1.0);
+  Coord s2 = s * s, s4 = s2 * s2, s8 = s4 * s4;
+  Coord p = (1.0 / 3.0 + s2 * (1.0 / 5.0)) +
+            s4 * (1.0 / 7.0 + s2 * (1.0 / 9.0)) +
+            s8 * (1.0 / 11.0 + s2 * (1.0 / 13.0));
+  p = 2.0 * (s + s * s2 * p);
+  return e + p * (1.0 / M_LN2);
+}
+
+/**
+ * @brief 2^x, 0 below -1022 and infinite above 1024. With x = k + f and
+ * |f| <= 1/2, the Taylor series of e^(f ln 2) to degree 11 has a relative
+ * error below 1e-14.
+ */
+inline Coord fastExp2(Coord x) {
+  x = std::min(std::max(x, -1023.0), 1025.0);
+  Coord k = roundToInteger(x);
+  Coord f = (x - k) * M_LN2;
+  // Estrin's scheme, as in fastLog2.
+  Coord f2 = f * f, f4 = f2 * f2, f8 = f4 * f4;
+  Coord p = ((1.0 + f) + f2 * (1.0 / 2.0 + f * (1.0 / 6.0))) +
+            f4 * ((1.0 / 24.0 + f * (1.0 / 120.0)) +
+                  f2 * (1.0 / 720.0 + f * (1.0 / 5040.0))) +
+            f8 * ((1.0 / 40320.0 + f * (1.0 / 362880.0)) +
+                  f2 * (1.0 / 3628800.0 + f * (1.0 / 39916800.0)));
+
+  // 2^k in two factors, to reach the ends of the range.
+  Coord half = roundToInteger(0.5 * k);
+  Coord r = p * exp2Integer(half) * exp2Integer(k - half);
+  return x < -1022.0 ? 0.0 : r;
+}
+
+/**
+ * @brief x^y for x >= 0 as 2^(y log2 x). The relative error is below
+ * 1e-12 (1 + |y log2 x|); subnormal x count as 0.
+ */
+inline Coord fastPow(Coord x, Coord y) {
+  Coord r = fastExp2(y * fastLog2(std::max(x, 2.2250738585072014e-308)));
+  Coord zero = y > 0.0 ? 0.0 : y < 0.0 ? INFINITY : 1.0;
+  return x < 2.2250738585072014e-308 ? zero : r;
+}
+
+/**
+ * @brief Cube root of a normal x from an estimate off by less than 3%,
+ * refined by two Halley steps, each of which cubes the relative error; the
+ * result is within 1e-14.
+ */
+inline Coord fastCbrt(Coord x) {
+  Coord a = std::abs(x);
+  // The high word of a divided by 3, as in fdlibm's cbrt.
+  uint32_t high = static_cast<uint32_t>(toBits(a) >> 32) / 3 + 0x2a9f7893u;
+  Coord y = fromBits(static_cast<uint64_t>(high) << 32);
+  // t = (y / cbrt(a))^3, formed so that it neither overflows nor
+  // underflows.
+  Coord inverse = 1.0 / a;
+  for (int i = 0; i < 2; ++i) {
+    Coord t = y * y * (y * inverse);
+    y = y * (t + 2.0) / (2.0 * t + 1.0);
+  }
+  return a > 0.0 ? std::copysign(y, x) : x;
+}
+
+template <size_t N>
+inline void fastSinCos(CoordxN<N> const& x, CoordxN<N>& sin,
+                       CoordxN<N>& cos) {
+  for (size_t i = 0; i < N; ++i) fastSinCos(x.v[i], sin.v[i], cos.v[i]);
+}
+
+template <size_t N>
+inline CoordxN<N> fastAtan2(CoordxN<N> const& y, CoordxN<N> const& x) {
+  CoordxN<N> r;
+  for (size_t i = 0; i < N; ++i) r.v[i] = fastAtan2(y.v[i], x.v[i]);
+  return r;
+}
+
+template <size_t N>
+inline CoordxN<N> fastAsin(CoordxN<N> const& x) {
+  CoordxN<N> r;
+  for (size_t i = 0; i < N; ++i) r.v[i] = fastAsin(x.v[i]);
+  return r;
+}
+
+template <size_t N>
+inline CoordxN<N> fastAcos(CoordxN<N> const& x) {
+  CoordxN<N> r;
+  for (size_t i = 0; i < N; ++i) r.v[i] = fastAcos(x.v[i]);
+  return r;
+}
+
+template <size_t N>
+inline CoordxN<N> fastPow(CoordxN<N> const& x, CoordxN<N> const& y) {
+  CoordxN<N> r;
+  for (size_t i = 0; i < N; ++i) r.v[i] = fastPow(x.v[i], y.v[i]);
+  return r;
+}
+
+template <size_t N>
+inline CoordxN<N> fastCbrt(CoordxN<N> const& x) {
+  CoordxN<N> r;
+  for (size_t i = 0; i < N; ++i) r.v[i] = fastCbrt(x.v[i]);
+  return r;
+}
+
+namespace math {
+
+#ifdef RAYTRACING_FAST_MATH
+inline constexpr bool Fast = true;
+#else
+inline constexpr bool Fast = false;
+#endif
+
+inline void sinCos(Coord x, Coord& sin, Coord& cos) {
+  if (Fast) {
+    fastSinCos(x, sin, cos);
+  } else {
+    sin = std::sin(x);
+    cos = std::cos(x);
+  }
+}
+
+inline Coord atan2(Coord y, Coord x) {
+  return Fast ? fastAtan2(y, x) : std::atan2(y, x);
+}
+
+inline Coord asin(Coord x) { return Fast ? fastAsin(x) : std::asin(x); }
+
+inline Coord acos(Coord x) { return Fast ? fastAcos(x) : std::acos(x); }
+
+inline Coord cos(Coord x) {
+  Coord s, c;
+  sinCos(x, s, c);
+  return c;
+}
+
+inline Coord pow(Coord x, Coord y) {
+  return Fast ? fastPow(x, y) : std::pow(x, y);
+}
+
+inline Coord cbrt(Coord x) { return Fast ? fastCbrt(x) : std::cbrt(x); }
+
+}  // namespace math
+
+}  // namespace geometry
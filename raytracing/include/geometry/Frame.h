@@ -0,0 +1,19 @@
+#pragma once
+
+#include <geometry/Point3D.h>
+
+namespace geometry {
+
+/**
+ * @brief Orthonormal tangent frame: tangent, bitangent and normal.
+ */
+struct Frame {
+  Vector3D t, b, n;
+
+  // Tangent space to world space.
+  Vector3D toWorld(Vector3D const& d) const {
+    return t * d.x + b * d.y + n * d.z;
+  }
+};
+
+}  // namespace geometry
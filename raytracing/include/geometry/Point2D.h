@@ -11,4 +11,17 @@ struct Point2D {
   Coord x, y;
 };
 
+/**
+ * @brief Texture coordinates together with their derivatives along the image
+ * plane, which select the mip level of texture lookups. Zero derivatives
+ * sample the finest level.
+ */
+struct TexCoord : Point2D {
+  TexCoord(Point2D uv = {0.0, 0.0}, Point2D dx = {0.0, 0.0},
+           Point2D dy = {0.0, 0.0})
+      : Point2D(uv), dx(dx), dy(dy) {}
+
+  Point2D dx, dy;
+};
+
 }  // namespace geometry
\ No newline at end of file
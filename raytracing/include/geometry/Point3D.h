@@ -5,6 +5,8 @@
 #include <geometry/types.h>
 
 #include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
 
 namespace geometry {
@@ -13,7 +15,7 @@ struct Point3D {
   Coord x, y, z;
   Coord length() const { return std::sqrt(x * x + y * y + z * z); }
 
-  inline Point3D operator-() const { return Point3D{x, y, z}; }
+  inline Point3D operator-() const { return Point3D{-x, -y, -z}; }
 
   inline Point3D operator+(Point3D const &p2) const {
     return Point3D{x + p2.x, y + p2.y, z + p2.z};
@@ -50,9 +52,35 @@ inline std::ostream &operator<<(std::ostream &os, Point3D const &p) {
 
 inline Point3D operator*(Coord s, Point3D const &p) { return p * s; }
 
+/**
+ * @brief 1 / sqrt(x) for x > 0 from an integer estimate refined by two
+ * Newton steps, with a relative error below 5e-6. It is plain arithmetic,
+ * so loops over it vectorize into fewer cycles than a square root and a
+ * division.
+ */
+inline Coord fastRsqrt(Coord x) {
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  bits = 0x5fe6eb50c7b537a9ull - (bits >> 1);
+  Coord y;
+  std::memcpy(&y, &bits, sizeof(y));
+  Coord half = 0.5 * x;
+  y = y * (1.5 - half * y * y);
+  y = y * (1.5 - half * y * y);
+  return y;
+}
+
 struct Normal3D : Vector3D {
   static constexpr Coord EPS = 1e-12;
 
+  // v has to be unit length already.
+  static Normal3D fromUnit(Vector3D const &v) { return {v, Unit{}}; }
+
+  // Normalized with fastRsqrt().
+  static Normal3D fast(Vector3D const &v) {
+    return {v * fastRsqrt(v * v), Unit{}};
+  }
+
   Normal3D(Vector3D const &v) : Normal3D(v.x, v.y, v.z) {}
 
   Normal3D(Coord x0, Coord y0, Coord z0) {
@@ -62,12 +90,18 @@ struct Normal3D : Vector3D {
     z = z0 / length;
   }
 
-  inline Normal3D operator-() const { return Normal3D{-x, -y, -z}; }
+  inline Normal3D operator-() const {
+    return fromUnit(Vector3D{-x, -y, -z});
+  }
 
   inline Normal3D operator%(Normal3D const &p2) const {
     return Normal3D{y * p2.z - z * p2.y, z * p2.x - x * p2.z,
                     x * p2.y - y * p2.x};
   }
+
+ private:
+  struct Unit {};
+  Normal3D(Vector3D const &v, Unit) : Vector3D(v) {}
 };
 
 struct Ray {
@@ -75,6 +109,15 @@ struct Ray {
   Normal3D direction;
 };
 
+/**
+ * @brief Derivatives of a ray's origin and direction with respect to the
+ * image plane coordinates, after Igehy, "Tracing Ray Differentials" (1999).
+ */
+struct RayDifferential {
+  Vector3D dPdx, dPdy;
+  Vector3D dDdx, dDdy;
+};
+
 inline Point2D operator*(Matrix<2, 3> const &M, Point3D const &p) {
   Matrix<2, 1> R = M * Matrix<3, 1>{{{p.x}, {p.y}, {p.z}}};
   return {R.values[0][0], R.values[1][0]};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <modelling/NormalMap.h>
+#include <modelling/Texture.h>
+#include <platform/parallel.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace modelling {
+
+/**
+ * @brief Loads textures and normal maps for a scene. Requesting an image
+ * whose path or content was requested before with the same settings returns
+ * the same handle. Images are decoded concurrently on a thread pool; the
+ * handles can be used, and rendering started, before decoding finishes.
+ */
+class AssetRegistry {
+ public:
+  explicit AssetRegistry(size_t threads = 0,
+                         std::shared_ptr<TextureCache const> cache = nullptr);
+
+  std::shared_ptr<Texture> texture(
+      std::string const& filename,
+      Texture::Interpolation interpolation = Texture::Bilinear,
+      Texture::Format format = Texture::UNorm8);
+
+  std::shared_ptr<NormalMap> normalMap(
+      std::string const& filename,
+      NormalMap::Interpolation interpolation = NormalMap::Bilinear);
+
+  // Waits until every requested image is decoded; rethrows the first
+  // decoding error.
+  void wait() const;
+
+  // Number of distinct images being decoded or decoded.
+  size_t size() const;
+
+ private:
+  // Kind of asset and its settings, then the path with the size and the
+  // modification time of the file, or the content hash.
+  using PathKey = std::tuple<int, int, int, std::string, uint64_t, int64_t>;
+  using ContentKey = std::tuple<int, int, int, uint64_t>;
+
+  template <typename T, typename Make>
+  std::shared_ptr<T> find(int kind, int interpolation, int format,
+                          std::string const& filename, Make make);
+
+  static uint64_t contentHash(std::string const& filename);
+
+ private:
+  std::shared_ptr<TextureCache const> m_cache;
+  mutable std::mutex m_mutex;
+  std::map<PathKey, std::shared_ptr<void>> m_byPath;
+  std::map<ContentKey, std::shared_ptr<void>> m_byContent;
+  std::vector<std::shared_ptr<Texture>> m_textures;
+  std::vector<std::shared_ptr<NormalMap>> m_normalMaps;
+  // Last member, so that queued decodes finish before the rest is destroyed.
+  platform::ThreadPool m_pool;
+};
+
+}  // namespace modelling
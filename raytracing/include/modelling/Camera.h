@@ -11,6 +11,12 @@ class Camera {
 
   geometry::Ray getRay(geometry::Coord x, geometry::Coord y) const;
 
+  // Differentials of getRay(x, y) for the image plane steps dx and dy.
+  geometry::RayDifferential getRayDifferential(geometry::Coord x,
+                                               geometry::Coord y,
+                                               geometry::Coord dx,
+                                               geometry::Coord dy) const;
+
  private:
   geometry::Point3D m_vrp;
   geometry::Vector3D m_u, m_v;
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <platform/Trace.h>
+
+#include <atomic>
+#include <future>
+
+namespace modelling {
+
+/**
+ * @brief Value that is either available on construction or produced later by
+ * a future. get() waits for the value the first time only; afterwards it
+ * costs an atomic load.
+ */
+template <typename T>
+class Deferred {
+ public:
+  explicit Deferred(T value) : m_value(nullptr) {
+    std::promise<T> promise;
+    promise.set_value(std::move(value));
+    m_future = promise.get_future().share();
+    m_value = &m_future.get();
+  }
+
+  explicit Deferred(std::shared_future<T> future)
+      : m_future(std::move(future)), m_value(nullptr) {}
+
+  Deferred(Deferred const&) = delete;
+  Deferred& operator=(Deferred const&) = delete;
+
+  // Rethrows the exception of a failed future.
+  T const& get() const {
+    T const* value = m_value.load(std::memory_order_acquire);
+    if (!value) {
+      platform::trace::Span span("wait for asset");
+      value = &m_future.get();
+      m_value.store(value, std::memory_order_release);
+    }
+    return *value;
+  }
+
+  bool ready() const {
+    return m_value.load(std::memory_order_acquire) ||
+           m_future.wait_for(std::chrono::seconds(0)) ==
+               std::future_status::ready;
+  }
+
+ private:
+  std::shared_future<T> m_future;
+  mutable std::atomic<T const*> m_value;
+};
+
+}  // namespace modelling
@@ -3,7 +3,7 @@
 #include <color/Spectrum.h>
 #include <geometry/Point3D.h>
 
-#include <random>
+#include <vector>
 
 namespace modelling {
 
@@ -13,12 +13,24 @@ struct Emission {
   geometry::Ray rayToLight;
 };
 
+struct PhotonEmission {
+  geometry::Ray ray;
+  color::SColor power;
+};
+
 class Emitter {
  public:
   virtual ~Emitter() = default;
 
   virtual Emission emission(geometry::Point3D const& x,
                             geometry::Normal3D const& n) = 0;
+
+  // Total emitted power.
+  virtual color::SColor power() const = 0;
+
+  // Starts a photon carrying the total power of the emitter from the given
+  // uniform random numbers.
+  virtual PhotonEmission emitPhoton(double u1, double u2, double u3) const = 0;
 };
 
 class PositionalLight : public Emitter {
@@ -27,6 +39,9 @@ class PositionalLight : public Emitter {
 
   Emission emission(geometry::Point3D const& x, geometry::Normal3D const& n);
 
+  color::SColor power() const override;
+  PhotonEmission emitPhoton(double u1, double u2, double u3) const override;
+
  private:
   geometry::Point3D m_pos;
   color::SColor m_color;
@@ -42,13 +57,15 @@ class SphereLight : public Emitter {
 
   Emission emission(geometry::Point3D const& x, geometry::Normal3D const& n);
 
+  color::SColor power() const override;
+  PhotonEmission emitPhoton(double u1, double u2, double u3) const override;
+
  private:
   geometry::Point3D const& randomPoint();
   Positions generatePositions(geometry::Point3D pos, geometry::Coord radius);
 
  private:
   Positions m_positions;
-  Positions::iterator m_pos_it;
   color::SColor m_color;
 };
 
@@ -12,6 +12,23 @@ struct Reflection {
   color::Intensity prob;
   geometry::Normal3D dir;
   color::SColor color;
+  // Solid angle density of `dir` if it was drawn from a non-delta lobe that
+  // can be guided, zero otherwise.
+  color::Intensity pdf = 0.0;
+  // True if `dir` is the single direction of an ideal reflector or refractor.
+  bool delta = false;
+};
+
+/**
+ * @brief A learned distribution of incident directions used to guide the
+ * sampling of diffuse lobes.
+ */
+class DirectionalDistribution {
+ public:
+  virtual ~DirectionalDistribution();
+
+  virtual geometry::Normal3D sample(double u, double v) const = 0;
+  virtual double pdf(geometry::Normal3D const& dir) const = 0;
 };
 
 class Material {
@@ -21,14 +38,27 @@ class Material {
   virtual color::SColor BRDF(geometry::Normal3D const& L,
                              geometry::Normal3D const& N,
                              geometry::Normal3D const& V,
-                             geometry::Point2D const& uv) const = 0;
+                             geometry::TexCoord const& uv) const = 0;
+
+  virtual Reflection reflection(geometry::Normal3D const& N,
+                                geometry::Normal3D const& V, geometry::TexCoord const& uv) const = 0;
 
+  // Samples like reflection(), but diffuse lobes draw their direction from a
+  // mixture of the cosine lobe (with probability bsdfFraction) and `guide`.
   virtual Reflection reflection(geometry::Normal3D const& N,
-                                geometry::Normal3D const& V, geometry::Point2D const& uv) const = 0;
+                                geometry::Normal3D const& V,
+                                geometry::TexCoord const& uv,
+                                DirectionalDistribution const& guide,
+                                color::Intensity bsdfFraction) const;
 
   virtual color::SColor transparency() const;
 
   virtual bool requiresUV() const;
+
+  // Selection probability of the diffuse lobe and its albedo at uv, for
+  // estimating the diffuse interreflection separately (irradiance caching).
+  virtual color::Intensity diffuseWeight() const;
+  virtual color::SColor diffuseColor(geometry::TexCoord const& uv) const;
 };
 
 class DiffuseMaterial : virtual public Material {
@@ -37,15 +67,24 @@ class DiffuseMaterial : virtual public Material {
                   std::shared_ptr<modelling::Texture> texture = nullptr);
 
   color::SColor BRDF(geometry::Normal3D const&, geometry::Normal3D const&,
-                     geometry::Normal3D const&, geometry::Point2D const& uv) const override;
+                     geometry::Normal3D const&, geometry::TexCoord const& uv) const override;
 
   color::Intensity averageAlbedo() const;
 
   Reflection reflection(geometry::Normal3D const& N,
-                        geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                        geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
+
+  Reflection reflection(geometry::Normal3D const& N,
+                        geometry::Normal3D const& V,
+                        geometry::TexCoord const& uv,
+                        DirectionalDistribution const& guide,
+                        color::Intensity bsdfFraction) const override;
 
   bool requiresUV() const override;
 
+  color::Intensity diffuseWeight() const override;
+  color::SColor diffuseColor(geometry::TexCoord const& uv) const override;
+
  protected:
   color::SColor m_spectrum;
   std::shared_ptr<modelling::Texture> m_texture;
@@ -56,12 +95,12 @@ class SpecularMaterial : virtual public Material {
   SpecularMaterial(color::SColor spectrum, color::Intensity shine);
 
   color::SColor BRDF(geometry::Normal3D const& L, geometry::Normal3D const& N,
-                     geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                     geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
 
   color::Intensity averageAlbedo() const;
 
   Reflection reflection(geometry::Normal3D const& N,
-                        geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                        geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
 
  protected:
   color::SColor m_spectrum;
@@ -76,10 +115,10 @@ class IdealReflector : virtual public Material {
   color::SColor const& kr() const;
 
   color::SColor BRDF(geometry::Normal3D const&, geometry::Normal3D const&,
-                     geometry::Normal3D const&, geometry::Point2D const& uv) const override;
+                     geometry::Normal3D const&, geometry::TexCoord const& uv) const override;
 
   Reflection reflection(geometry::Normal3D const& N,
-                        geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                        geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
 
  private:
   color::SColor m_Kr;
@@ -93,10 +132,10 @@ class IdealRefractor : virtual public Material {
   color::SColor const& kt() const;
 
   color::SColor BRDF(geometry::Normal3D const&, geometry::Normal3D const&,
-                     geometry::Normal3D const&, geometry::Point2D const& uv) const override;
+                     geometry::Normal3D const&, geometry::TexCoord const& uv) const override;
 
   Reflection reflection(geometry::Normal3D const& N,
-                        geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                        geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
 
   color::SColor transparency() const override;
 
@@ -105,23 +144,67 @@ class IdealRefractor : virtual public Material {
   color::Intensity m_N;
 };
 
-class GeneralMaterial : public DiffuseMaterial,
-                        public SpecularMaterial,
-                        public IdealReflector,
-                        public IdealRefractor {
+/**
+ * @brief A single scattering lobe of a compiled GeneralMaterial.
+ *
+ * Lobes are selected with probability proportional to their average albedo;
+ * `cdf` is the running sum of the selection weights up to this lobe. For
+ * specular lobes `spectrum` is pre-multiplied by the Phong normalization and
+ * `param` is the shininess; for refractors `param` is the refraction index.
+ */
+struct Lobe {
+  enum Type { Diffuse, Specular, Reflector, Refractor };
+
+  Type type;
+  color::SColor spectrum;
+  color::Intensity param;
+  color::Intensity weight;
+  color::Intensity cdf;
+};
+
+class GeneralMaterial : public Material {
  public:
+  static constexpr size_t MaxLobes = 4;
+
   GeneralMaterial(color::SColor diffuseColor, color::SColor specularColor,
                   color::Intensity shine, color::SColor kr, color::SColor kt,
                   color::Intensity N, std::shared_ptr<Texture> texture=nullptr);
 
   color::SColor BRDF(geometry::Normal3D const& L, geometry::Normal3D const& N,
-                     geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                     geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
+
+  Reflection reflection(geometry::Normal3D const& N,
+                        geometry::Normal3D const& V, geometry::TexCoord const& uv) const override;
 
   Reflection reflection(geometry::Normal3D const& N,
-                        geometry::Normal3D const& V, geometry::Point2D const& uv) const override;
+                        geometry::Normal3D const& V,
+                        geometry::TexCoord const& uv,
+                        DirectionalDistribution const& guide,
+                        color::Intensity bsdfFraction) const override;
 
   color::SColor transparency() const override;
   bool requiresUV() const override;
+
+  color::Intensity diffuseWeight() const override;
+  color::SColor diffuseColor(geometry::TexCoord const& uv) const override;
+
+  Lobe const* lobesBegin() const { return m_lobes; }
+  Lobe const* lobesEnd() const { return m_lobes + m_nLobes; }
+
+ private:
+  Reflection sample(geometry::Normal3D const& N, geometry::Normal3D const& V,
+                    geometry::TexCoord const& uv,
+                    DirectionalDistribution const* guide,
+                    color::Intensity bsdfFraction) const;
+
+  void addLobe(Lobe::Type type, color::SColor spectrum,
+               color::Intensity param, color::Intensity weight);
+
+ private:
+  Lobe m_lobes[MaxLobes];
+  size_t m_nLobes;
+  std::shared_ptr<Texture> m_texture;
+  color::SColor m_transparency;
 };
 
 }  // namespace modelling
\ No newline at end of file
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <geometry/Matrix.h>
+#include <modelling/Primitive.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace modelling {
+
+/**
+ * @brief Triangles as indices into an array of vertex positions. Positions
+ * are single precision, so that meshes of tens of millions of faces fit in
+ * 12 bytes per vertex and 12 bytes per triangle.
+ */
+struct MeshData {
+  // x, y, z of every vertex.
+  std::vector<float> positions;
+  // Three vertex indices per triangle, counter-clockwise seen from the front
+  // as in OBJ and PLY files.
+  std::vector<uint32_t> indices;
+
+  size_t vertexCount() const { return positions.size() / 3; }
+  size_t triangleCount() const { return indices.size() / 3; }
+};
+
+/**
+ * @brief Triangle mesh as a single primitive, intersected through a bounding
+ * volume hierarchy over its triangles. The texture coordinates of a point
+ * are its barycentric coordinates in the triangle hit, as for a Triangle
+ * with the default UVs. The part of a hit is the triangle; queries without
+ * it search the hierarchy for the triangle closest to the point.
+ */
+class Mesh : public Primitive {
+ public:
+  // view places the mesh in the scene; it is applied to the positions once.
+  Mesh(MeshData data, std::shared_ptr<Material> material,
+       geometry::Matrix<4, 4> view = geometry::Identity3D());
+
+  geometry::Coord intersect(geometry::Ray const& ray) const override;
+  Hit hit(geometry::Ray const& ray) const override;
+  geometry::Point2D getUV(geometry::Point3D const& x) const override;
+  geometry::Normal3D normal(geometry::Point3D const& x) const override;
+  geometry::Normal3D normal(geometry::Point3D const& x,
+                            geometry::TexCoord const& uv) const override;
+  geometry::Point2D getUV(geometry::Point3D const& x,
+                          uint32_t part) const override;
+  geometry::Normal3D normal(geometry::Point3D const& x,
+                            uint32_t part) const override;
+  geometry::Normal3D normal(geometry::Point3D const& x,
+                            geometry::TexCoord const& uv,
+                            uint32_t part) const override;
+
+  size_t triangleCount() const { return m_indices.size() / 3; }
+
+ private:
+  friend struct MeshTraversal;
+
+  // Leaves hold the triangles [first, first + count); an inner node has its
+  // children at the next index and at first.
+  struct Node {
+    float lower[3];
+    uint32_t first;
+    float upper[3];
+    uint32_t count;
+  };
+
+  void build();
+  geometry::Point3D vertex(size_t triangle, size_t corner) const;
+  size_t locate(geometry::Point3D const& x) const;
+
+ private:
+  std::vector<float> m_positions;
+  // In the order of the leaves.
+  std::vector<uint32_t> m_indices;
+  std::vector<Node> m_nodes;
+};
+
+}  // namespace modelling
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <modelling/Mesh.h>
+
+#include <string>
+
+namespace modelling {
+
+// Size and duration of a mesh import.
+struct MeshLoadStats {
+  size_t bytes = 0;
+  double seconds = 0.0;
+
+  double megabytesPerSecond() const {
+    return seconds > 0.0 ? double(bytes) / seconds * 1e-6 : 0.0;
+  }
+};
+
+// Importers of triangle meshes. The file is memory-mapped and parsed in
+// chunks on threads threads (0: one per hardware thread) straight into the
+// arrays of MeshData. Polygons are split into triangle fans. Errors are
+// thrown as strings.
+
+// Wavefront OBJ: the v and f lines, with absolute or relative indices;
+// texture coordinates, normals, groups and materials are skipped.
+MeshData loadObj(std::string const& filename, size_t threads = 0,
+                 MeshLoadStats* stats = nullptr);
+
+// Binary PLY, little or big endian: the x, y and z properties of the vertex
+// element and the vertex_indices list of the face element.
+MeshData loadPly(std::string const& filename, size_t threads = 0,
+                 MeshLoadStats* stats = nullptr);
+
+// By the extension of filename, .obj or .ply.
+MeshData loadMesh(std::string const& filename, size_t threads = 0,
+                  MeshLoadStats* stats = nullptr);
+
+}  // namespace modelling
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <color/Image.h>
+#include <geometry/Point2D.h>
+#include <modelling/TexelFormat.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace modelling {
+
+template <typename Value>
+struct ImageLevel {
+  color::ImageSize size;
+  std::vector<Value> values;
+};
+
+// Size of the pyramid level below one of `size`. Odd sizes round up, so
+// that the last row and column are kept.
+inline color::ImageSize coarserSize(color::ImageSize size) {
+  return {(size.width + 1) / 2, (size.height + 1) / 2};
+}
+
+// Fine texels along one axis of `fine` texels that make up coarse texel c,
+// and their weights. Texels sit on the corners of the uv square, so with an
+// odd size coarse texel c falls on fine texel 2c and is filtered by a tent
+// around it; with an even size it is the box of 2c and 2c + 1.
+struct DownsampleTaps {
+  size_t count;
+  size_t index[3];
+  double weight[3];
+};
+
+inline DownsampleTaps downsampleTaps(size_t fine, size_t c) {
+  if (fine % 2 == 0) return {2, {2 * c, 2 * c + 1, 0}, {0.5, 0.5, 0.0}};
+  return {3,
+          {c > 0 ? 2 * c - 1 : 0, 2 * c, std::min(2 * c + 1, fine - 1)},
+          {0.25, 0.5, 0.25}};
+}
+
+/**
+ * @brief Filtered level below `fine`, of coarserSize(fine.size).
+ */
+template <typename Value>
+ImageLevel<Value> downsample(ImageLevel<Value> const& fine) {
+  color::ImageSize size = fine.size;
+  color::ImageSize coarseSize = coarserSize(size);
+  std::vector<Value> coarse;
+  coarse.reserve(coarseSize.width * coarseSize.height);
+
+  std::vector<DownsampleTaps> columns;
+  for (size_t j = 0; j < coarseSize.width; ++j)
+    columns.push_back(downsampleTaps(size.width, j));
+
+  for (size_t i = 0; i < coarseSize.height; ++i) {
+    DownsampleTaps rows = downsampleTaps(size.height, i);
+    for (DownsampleTaps const& cols : columns) {
+      Value sum = fine.values[cols.index[0] + size.width * rows.index[0]] *
+                  (cols.weight[0] * rows.weight[0]);
+      for (size_t a = 0; a < rows.count; ++a) {
+        Value const* row = &fine.values[size.width * rows.index[a]];
+        for (size_t b = a == 0 ? 1 : 0; b < cols.count; ++b)
+          sum = sum + row[cols.index[b]] * (cols.weight[b] * rows.weight[a]);
+      }
+      coarse.push_back(sum);
+    }
+  }
+  return {coarseSize, std::move(coarse)};
+}
+
+/**
+ * @brief Image pyramid of `base`, from the full size down to 1x1, each
+ * level half the size of the previous one, rounded up.
+ */
+template <typename Value>
+std::vector<ImageLevel<Value>> buildPyramid(std::vector<Value> base,
+                                            color::ImageSize size) {
+  std::vector<ImageLevel<Value>> levels;
+  levels.push_back({size, std::move(base)});
+  while (levels.back().size.width > 1 || levels.back().size.height > 1)
+    levels.push_back(downsample(levels.back()));
+  return levels;
+}
+
+/**
+ * @brief Nearest, bilinear and trilinear filtering over the levels of an
+ * image pyramid. `Derived` provides levels(), size(level) and
+ * texel(level, u, v).
+ */
+template <typename Derived, typename Value>
+class MipFilter {
+ public:
+  // Trilinear filtering between the two levels closest to the footprint of
+  // uv; `bilinear` selects the filter within a level.
+  Value get(geometry::TexCoord const& uv, bool bilinear) const {
+    Derived const& self = static_cast<Derived const&>(*this);
+    size_t levels = self.levels();
+
+    color::ImageSize base = self.size(0);
+    geometry::Coord dxu = uv.dx.x * static_cast<geometry::Coord>(base.width);
+    geometry::Coord dxv = uv.dx.y * static_cast<geometry::Coord>(base.height);
+    geometry::Coord dyu = uv.dy.x * static_cast<geometry::Coord>(base.width);
+    geometry::Coord dyv = uv.dy.y * static_cast<geometry::Coord>(base.height);
+    geometry::Coord width2 =
+        std::max(dxu * dxu + dxv * dxv, dyu * dyu + dyv * dyv);
+
+    // Footprint of at most one texel.
+    if (!(width2 > 1.0)) return get(0, uv, bilinear);
+
+    geometry::Coord lod = std::min(0.5 * std::log2(width2),
+                                   static_cast<geometry::Coord>(levels - 1));
+    size_t level = static_cast<size_t>(lod);
+    if (level + 1 >= levels) return get(levels - 1, uv, bilinear);
+
+    geometry::Coord t = lod - static_cast<geometry::Coord>(level);
+    return get(level, uv, bilinear) * (1.0 - t) +
+           get(level + 1, uv, bilinear) * t;
+  }
+
+  Value get(size_t level, geometry::Point2D const& p, bool bilinear) const {
+    Derived const& self = static_cast<Derived const&>(*this);
+    color::ImageSize size = self.size(level);
+    geometry::Coord x = wrap(p.x) * static_cast<geometry::Coord>(size.width - 1);
+    geometry::Coord y = wrap(p.y) * static_cast<geometry::Coord>(size.height - 1);
+
+    size_t u1 = static_cast<size_t>(std::floor(x));
+    size_t v1 = static_cast<size_t>(std::floor(y));
+    size_t u2 = static_cast<size_t>(std::ceil(x));
+    size_t v2 = static_cast<size_t>(std::ceil(y));
+    geometry::Coord rx = x - static_cast<geometry::Coord>(u1);
+    geometry::Coord ry = y - static_cast<geometry::Coord>(v1);
+
+    if (bilinear) {
+      return self.texel(level, u1, v1) * ((1.0 - rx) * (1.0 - ry)) +
+             self.texel(level, u2, v1) * ((rx) * (1.0 - ry)) +
+             self.texel(level, u1, v2) * ((1.0 - rx) * (ry)) +
+             self.texel(level, u2, v2) * ((rx) * (ry));
+    }
+
+    return self.texel(level, rx < 0.5 ? u1 : u2, ry < 0.5 ? v1 : v2);
+  }
+
+ private:
+  static geometry::Coord wrap(geometry::Coord c) {
+    c = std::fmod(c, 1.0);
+    return c < 0.0 ? c + 1.0 : c;
+  }
+};
+
+/**
+ * @brief Image pyramid held in memory in the texel format F.
+ *
+ * Texels are laid out in 8x8 tiles so that the texels of a bilinear lookup
+ * and of nearby lookups share cache lines. They are decoded to F::Value only
+ * when sampled.
+ */
+template <typename F>
+class MipMap : public MipFilter<MipMap<F>, typename F::Value> {
+ public:
+  using Value = typename F::Value;
+  using Texel = typename F::Texel;
+
+  static constexpr size_t TileBits = 3;
+  static constexpr size_t TileSize = size_t(1) << TileBits;
+
+  MipMap(std::vector<Value> base, color::ImageSize size) {
+    for (auto const& level : buildPyramid(std::move(base), size))
+      m_levels.push_back(encode(level.values, level.size));
+  }
+
+  size_t levels() const { return m_levels.size(); }
+  color::ImageSize size(size_t level) const { return m_levels[level].size; }
+
+  Value texel(size_t level, size_t u, size_t v) const {
+    Level const& l = m_levels[level];
+    return F::decode(l.texels[index(l, u, v)]);
+  }
+
+  // Bytes of texel storage over all levels.
+  size_t memoryUsage() const {
+    size_t bytes = 0;
+    for (auto const& level : m_levels) bytes += level.texels.size() * sizeof(Texel);
+    return bytes;
+  }
+
+ private:
+  struct Level {
+    color::ImageSize size;
+    size_t tilesPerRow;
+    std::vector<Texel> texels;
+  };
+
+  static size_t index(Level const& l, size_t u, size_t v) {
+    size_t tile = (v >> TileBits) * l.tilesPerRow + (u >> TileBits);
+    return (tile << (2 * TileBits)) | ((v & (TileSize - 1)) << TileBits) |
+           (u & (TileSize - 1));
+  }
+
+  static Level encode(std::vector<Value> const& values,
+                      color::ImageSize size) {
+    size_t tilesPerRow = (size.width + TileSize - 1) / TileSize;
+    size_t tileRows = (size.height + TileSize - 1) / TileSize;
+
+    Level l{size, tilesPerRow, {}};
+    l.texels.resize(tilesPerRow * tileRows * TileSize * TileSize);
+    for (size_t v = 0; v < size.height; ++v)
+      for (size_t u = 0; u < size.width; ++u)
+        l.texels[index(l, u, v)] = F::encode(values[u + size.width * v]);
+    return l;
+  }
+
+  std::vector<Level> m_levels;
+};
+
+}  // namespace modelling
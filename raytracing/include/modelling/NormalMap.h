@@ -3,23 +3,54 @@
 #include <color/Image.h>
 #include <geometry/Point2D.h>
 #include <geometry/Point3D.h>
+#include <modelling/Deferred.h>
+#include <modelling/MipMap.h>
+#include <modelling/PagedMipMap.h>
+#include <platform/parallel.h>
 
+#include <memory>
 #include <string>
+#include <variant>
 #include <vector>
 
 namespace modelling {
 
+/**
+ * @brief Tangent space normal map. Normals are stored as octahedral-encoded
+ * unit vectors in two 16-bit channels; filtering works on the octahedral
+ * coordinates.
+ */
 class NormalMap {
  public:
   enum Interpolation { Nearest = 1, Bilinear = 2 };
 
  public:
-  NormalMap(std::string filename, Interpolation interpolation = Bilinear);
-  geometry::Vector3D const get(geometry::Point2D const& p) const;
+  // With a cache, the texels are paged in as for Texture.
+  NormalMap(std::string filename, Interpolation interpolation = Bilinear,
+            std::shared_ptr<TextureCache const> cache = nullptr);
+  // Decodes filename on pool in the background as for Texture.
+  NormalMap(platform::ThreadPool& pool, std::string filename,
+            Interpolation interpolation = Bilinear,
+            std::shared_ptr<TextureCache const> cache = nullptr);
+  // Tangent space normal at p; not normalized.
+  geometry::Vector3D const get(geometry::TexCoord const& p) const;
+
+  // Bytes of texel storage over all mip levels held by this map.
+  size_t memoryUsage() const;
+
+  // Waits until the texels are decoded; rethrows a decoding error.
+  void wait() const { m_mipMap.get(); }
+  bool ready() const { return m_mipMap.ready(); }
+
+ private:
+  using MipMaps = std::variant<MipMap<texel::SNorm16<2>>,
+                               PagedMipMap<texel::SNorm16<2>>>;
+
+  static MipMaps load(std::string const& filename,
+                      std::shared_ptr<TextureCache const> const& cache);
 
  private:
-  std::vector<geometry::Vector3D> values;
-  color::ImageSize size;
+  Deferred<MipMaps> m_mipMap;
   Interpolation m_interpolation;
 };
 
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <modelling/MipMap.h>
+#include <modelling/TextureCache.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace modelling {
+
+/**
+ * @brief Image pyramid in the texel format F stored in a tiled file, whose
+ * pages are fetched through a TextureCache when sampled.
+ */
+template <typename F>
+class PagedMipMap : public MipFilter<PagedMipMap<F>, typename F::Value> {
+ public:
+  using Value = typename F::Value;
+  using Texel = typename F::Texel;
+
+  static constexpr size_t PageBits = TiledImageFile::PageBits;
+  static constexpr size_t PageSize = TiledImageFile::PageSize;
+
+  PagedMipMap(std::shared_ptr<TextureCache const> cache,
+              std::string const& path)
+      : m_cache(std::move(cache)),
+        m_file(std::make_unique<TiledImageFile>(path, sizeof(Texel))) {}
+
+  // Builds the pyramid of base and writes it to path in the tiled format.
+  // Levels are built one at a time and written a row of pages at a time,
+  // so at most two levels are held in memory.
+  static void convert(std::string const& path, std::vector<Value> base,
+                      color::ImageSize size) {
+    std::vector<color::ImageSize> sizes{size};
+    while (sizes.back().width > 1 || sizes.back().height > 1)
+      sizes.push_back(coarserSize(sizes.back()));
+
+    TiledImageFile::Writer writer(path, sizeof(Texel), sizes);
+    ImageLevel<Value> level{size, std::move(base)};
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      if (i > 0) level = downsample(level);
+      writePages(writer, level);
+    }
+    writer.finish();
+  }
+
+  size_t levels() const { return m_file->levels().size(); }
+  color::ImageSize size(size_t level) const {
+    return m_file->levels()[level].size;
+  }
+
+  Value texel(size_t level, size_t u, size_t v) const {
+    size_t page = (v >> PageBits) * m_file->levels()[level].pagesPerRow +
+                  (u >> PageBits);
+    Texel t;
+    std::memcpy(&t, m_cache->page(*m_file, level, page) + offset(u, v),
+                sizeof(t));
+    return F::decode(t);
+  }
+
+  // Bytes of the pages of this pyramid resident in the cache.
+  size_t memoryUsage() const { return m_cache->residentBytes(*m_file); }
+
+ private:
+  static void writePages(TiledImageFile::Writer& writer,
+                         ImageLevel<Value> const& level) {
+    size_t pagesPerRow = TiledImageFile::pagesPerRow(level.size);
+    size_t pageBytes = PageSize * PageSize * sizeof(Texel);
+
+    std::vector<unsigned char> bytes(pagesPerRow * pageBytes);
+    for (size_t v0 = 0; v0 < level.size.height; v0 += PageSize) {
+      std::fill(bytes.begin(), bytes.end(), 0);
+      size_t v1 = std::min(v0 + PageSize, level.size.height);
+      for (size_t v = v0; v < v1; ++v) {
+        for (size_t u = 0; u < level.size.width; ++u) {
+          Texel t = F::encode(level.values[u + level.size.width * v]);
+          std::memcpy(&bytes[(u >> PageBits) * pageBytes + offset(u, v)], &t,
+                      sizeof(t));
+        }
+      }
+      writer.append(bytes.data(), bytes.size());
+    }
+  }
+
+  static size_t offset(size_t u, size_t v) {
+    return (((v & (PageSize - 1)) << PageBits) | (u & (PageSize - 1))) *
+           sizeof(Texel);
+  }
+
+  std::shared_ptr<TextureCache const> m_cache;
+  std::unique_ptr<TiledImageFile> m_file;
+};
+
+/**
+ * @brief Pyramid of the image `source` as a Result holding either a MipMap<F>
+ * or, with a cache, a PagedMipMap<F>. The tiled file is converted from the
+ * values returned by load() when it is missing, stale or unreadable.
+ */
+template <typename Result, typename F, typename Load>
+Result loadMipMap(std::string const& source,
+                  std::shared_ptr<TextureCache const> const& cache,
+                  std::string const& tag, Load load) {
+  if (!cache) {
+    auto [values, size] = load();
+    return Result(MipMap<F>(std::move(values), size));
+  }
+
+  std::string path = cache->tiledPath(source, tag);
+  if (TiledImageFile::upToDate(path, source)) {
+    try {
+      return Result(PagedMipMap<F>(cache, path));
+    } catch (const char*) {
+    }
+  }
+
+  auto [values, size] = load();
+  PagedMipMap<F>::convert(path, std::move(values), size);
+  return Result(PagedMipMap<F>(cache, path));
+}
+
+}  // namespace modelling
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <geometry/Affine3D.h>
+#include <geometry/Frame.h>
 #include <geometry/Matrix.h>
 #include <geometry/Point2D.h>
 #include <geometry/Point3D.h>
@@ -10,36 +12,74 @@
 #include <modelling/Material.h>
 #include <modelling/NormalMap.h>
 
+#include <cstdint>
 #include <memory>
 
 namespace modelling {
 
+// Nearest hit of a ray on a primitive. part is the piece of the primitive
+// that was hit, such as the triangle of a mesh; the shading queries at the
+// hit take it, so that they need not search for it.
+struct Hit {
+  geometry::Coord t;
+  uint32_t part;
+};
+
 class Primitive : virtual public geometry::Surface {
+ public:
+  // Kind of surface, for render statistics.
+  enum class Shape { Sphere, Triangle, Torus, Mesh, Other };
+
  public:
   Primitive(std::shared_ptr<Material> material,
-            std::shared_ptr<NormalMap> normalMap);
+            std::shared_ptr<NormalMap> normalMap, Shape shape = Shape::Other);
 
   color::SColor BRDF(geometry::Normal3D const& L, geometry::Normal3D const& N,
                      geometry::Normal3D const& V,
-                     geometry::Point2D const& uv) const;
+                     geometry::TexCoord const& uv) const;
+
+  Reflection reflection(geometry::Normal3D const& N,
+                        geometry::Normal3D const& V,
+                        geometry::TexCoord const& uv) const;
 
   Reflection reflection(geometry::Normal3D const& N,
                         geometry::Normal3D const& V,
-                        geometry::Point2D const& uv) const;
+                        geometry::TexCoord const& uv,
+                        DirectionalDistribution const& guide,
+                        color::Intensity bsdfFraction) const;
 
   color::SColor transparency() const;
 
   bool requiresUV() const;
 
+  color::Intensity diffuseWeight() const;
+  color::SColor diffuseColor(geometry::TexCoord const& uv) const;
+
+  Shape shape() const { return m_shape; }
+
+  // intersect() with the part hit; primitives of one piece report part 0.
+  virtual Hit hit(geometry::Ray const& ray) const;
+
   virtual geometry::Point2D getUV(geometry::Point3D const& x) const = 0;
 
   virtual geometry::Normal3D normal(geometry::Point3D const& x,
-                                    geometry::Point2D const& uv) const = 0;
+                                    geometry::TexCoord const& uv) const = 0;
   using Surface::normal;
 
+  // The queries above at a point of the given part of the primitive. Only
+  // primitives of several parts need to override them.
+  virtual geometry::Point2D getUV(geometry::Point3D const& x,
+                                  uint32_t part) const;
+  virtual geometry::Normal3D normal(geometry::Point3D const& x,
+                                    uint32_t part) const;
+  virtual geometry::Normal3D normal(geometry::Point3D const& x,
+                                    geometry::TexCoord const& uv,
+                                    uint32_t part) const;
+
  protected:
   std::shared_ptr<Material> m_material;
   std::shared_ptr<NormalMap> m_normalMap;
+  Shape m_shape;
 };
 
 class Sphere : public geometry::Sphere, public Primitive {
@@ -50,11 +90,10 @@ class Sphere : public geometry::Sphere, public Primitive {
 
   geometry::Point2D getUV(geometry::Point3D const& x) const override;
   geometry::Normal3D normal(geometry::Point3D const& x,
-                            geometry::Point2D const& uv) const override;
+                            geometry::TexCoord const& uv) const override;
 
  private:
-  geometry::Matrix<4, 4> m_orientation;
-  geometry::Matrix<4, 4> m_invOrientation;
+  geometry::Affine3D m_invOrientation;
 };
 
 class Triangle : public geometry::Triangle, public Primitive {
@@ -70,11 +109,12 @@ class Triangle : public geometry::Triangle, public Primitive {
 
   geometry::Point2D getUV(geometry::Point3D const& x) const override;
   geometry::Normal3D normal(geometry::Point3D const& x,
-                            geometry::Point2D const& uv) const override;
+                            geometry::TexCoord const& uv) const override;
 
  private:
   geometry::Matrix<2, 3> m_uvMap;
-  geometry::Point3D m_su, m_sv;
+  // Tangent frame of the normal map, built from su and sv.
+  geometry::Frame m_frame;
 };
 
 class Torus : public geometry::Torus, public Primitive {
@@ -85,12 +125,14 @@ class Torus : public geometry::Torus, public Primitive {
 
   geometry::Coord intersect(geometry::Ray const& ray) const override;
   geometry::Point2D getUV(geometry::Point3D const& x) const override;
+  // Geometric normal at the world space point x.
+  geometry::Normal3D normal(geometry::Point3D const& x) const override;
   geometry::Normal3D normal(geometry::Point3D const& x,
-                            geometry::Point2D const& uv) const override;
+                            geometry::TexCoord const& uv) const override;
 
  private:
-  geometry::Matrix<4, 4> m_view;
-  geometry::Matrix<4, 4> m_invView;
+  geometry::Affine3D m_view;
+  geometry::Affine3D m_invView;
 };
 
 }  // namespace modelling
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+namespace modelling {
+
+/**
+ * @brief Uniform random numbers from a 64-bit counter hashed with SplitMix64.
+ * The whole state is the counter, so a stream is restarted exactly by
+ * seeding it again.
+ */
+class RandomStream {
+ public:
+  explicit RandomStream(uint64_t seed = 0) : m_state(seed) {}
+
+  void seed(uint64_t seed) { m_state = seed; }
+  uint64_t state() const { return m_state; }
+
+  uint64_t next() {
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  // In [0, 1).
+  double uniform() {
+    return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+ private:
+  uint64_t m_state;
+};
+
+// Seed of sample `sample` of pixel `pixel`, independent of the thread that
+// renders it.
+uint64_t sampleSeed(uint64_t pixel, uint64_t sample);
+
+// Stream used by the materials and emitters on the calling thread. Unless
+// reseeded, each thread starts from a random seed.
+RandomStream& threadRandom();
+
+}  // namespace modelling
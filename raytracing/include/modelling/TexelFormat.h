@@ -0,0 +1,158 @@
+#pragma once
+
+#include <color/Half.h>
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Storage formats of texture texels. Each format stores N channels in a
+// compact Texel and converts to and from the float Value that filtering
+// works on.
+
+namespace modelling {
+
+template <size_t N>
+struct TexelValue {
+  float c[N];
+
+  TexelValue operator+(TexelValue const& other) const {
+    TexelValue result;
+    for (size_t i = 0; i < N; ++i) result.c[i] = c[i] + other.c[i];
+    return result;
+  }
+
+  TexelValue operator*(double s) const {
+    TexelValue result;
+    for (size_t i = 0; i < N; ++i)
+      result.c[i] = c[i] * static_cast<float>(s);
+    return result;
+  }
+};
+
+namespace texel {
+
+using color::floatToHalf;
+using color::halfToFloat;
+
+template <typename F>
+std::array<float, 256> makeTable(F f) {
+  std::array<float, 256> table;
+  for (size_t i = 0; i < 256; ++i) table[i] = f(static_cast<float>(i) / 255.0f);
+  return table;
+}
+
+inline const std::array<float, 256> unorm8Table =
+    makeTable([](float v) { return v; });
+
+inline const std::array<float, 256> srgb8Table = makeTable([](float v) {
+  return v <= 0.04045f ? v / 12.92f
+                       : std::pow((v + 0.055f) / 1.055f, 2.4f);
+});
+
+inline uint8_t quantize(float v) {
+  v = std::fmin(std::fmax(v, 0.0f), 1.0f);
+  return static_cast<uint8_t>(std::lround(v * 255.0f));
+}
+
+inline float linearToSRGB(float v) {
+  return v <= 0.0031308f ? v * 12.92f
+                         : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+}
+
+// 8 bits per channel, decoded as value / 255 like color::loadImage.
+template <size_t N>
+struct UNorm8 {
+  using Value = TexelValue<N>;
+  using Texel = std::array<uint8_t, N>;
+
+  static Texel encode(Value const& v) {
+    Texel t;
+    for (size_t i = 0; i < N; ++i) t[i] = quantize(v.c[i]);
+    return t;
+  }
+  static Value decode(Texel const& t) {
+    Value v;
+    for (size_t i = 0; i < N; ++i) v.c[i] = unorm8Table[t[i]];
+    return v;
+  }
+};
+
+// 8 bits per channel with the sRGB transfer function.
+template <size_t N>
+struct SRGB8 {
+  using Value = TexelValue<N>;
+  using Texel = std::array<uint8_t, N>;
+
+  static Texel encode(Value const& v) {
+    Texel t;
+    for (size_t i = 0; i < N; ++i) t[i] = quantize(linearToSRGB(v.c[i]));
+    return t;
+  }
+  static Value decode(Texel const& t) {
+    Value v;
+    for (size_t i = 0; i < N; ++i) v.c[i] = srgb8Table[t[i]];
+    return v;
+  }
+};
+
+template <size_t N>
+struct Half {
+  using Value = TexelValue<N>;
+  using Texel = std::array<uint16_t, N>;
+
+  static Texel encode(Value const& v) {
+    Texel t;
+    for (size_t i = 0; i < N; ++i) t[i] = floatToHalf(v.c[i]);
+    return t;
+  }
+  static Value decode(Texel const& t) {
+    Value v;
+    for (size_t i = 0; i < N; ++i) v.c[i] = halfToFloat(t[i]);
+    return v;
+  }
+};
+
+template <size_t N>
+struct Float {
+  using Value = TexelValue<N>;
+  using Texel = std::array<float, N>;
+
+  static Texel encode(Value const& v) {
+    Texel t;
+    for (size_t i = 0; i < N; ++i) t[i] = v.c[i];
+    return t;
+  }
+  static Value decode(Texel const& t) {
+    Value v;
+    for (size_t i = 0; i < N; ++i) v.c[i] = t[i];
+    return v;
+  }
+};
+
+// Signed 16 bits per channel in [-1, 1], e.g. octahedral unit vectors.
+template <size_t N>
+struct SNorm16 {
+  using Value = TexelValue<N>;
+  using Texel = std::array<int16_t, N>;
+
+  static Texel encode(Value const& v) {
+    Texel t;
+    for (size_t i = 0; i < N; ++i) {
+      float c = std::fmin(std::fmax(v.c[i], -1.0f), 1.0f);
+      t[i] = static_cast<int16_t>(std::lround(c * 32767.0f));
+    }
+    return t;
+  }
+  static Value decode(Texel const& t) {
+    Value v;
+    for (size_t i = 0; i < N; ++i)
+      v.c[i] = static_cast<float>(t[i]) * (1.0f / 32767.0f);
+    return v;
+  }
+};
+
+}  // namespace texel
+
+}  // namespace modelling
@@ -2,8 +2,14 @@
 
 #include <color/Image.h>
 #include <geometry/Point2D.h>
+#include <modelling/Deferred.h>
+#include <modelling/MipMap.h>
+#include <modelling/PagedMipMap.h>
+#include <platform/parallel.h>
 
+#include <memory>
 #include <string>
+#include <variant>
 #include <vector>
 
 namespace modelling {
@@ -11,15 +17,43 @@ namespace modelling {
 class Texture {
  public:
   enum Interpolation { Nearest = 1, Bilinear = 2 };
+  // Storage of the texels. UNorm8 decodes like color::loadImage, SRGB8
+  // linearizes with the sRGB transfer function.
+  enum Format { UNorm8 = 1, SRGB8 = 2, Half = 3, Float = 4 };
 
  public:
-  Texture(std::string filename, Interpolation interpolation = Bilinear);
-  color::SColor const get(geometry::Point2D const& p) const;
+  // With a cache, the texels are paged in from a tiled file converted from
+  // filename on first use instead of being held in memory.
+  Texture(std::string filename, Interpolation interpolation = Bilinear,
+          Format format = UNorm8,
+          std::shared_ptr<TextureCache const> cache = nullptr);
+  // Decodes filename on pool in the background; lookups made before that is
+  // done wait for it.
+  Texture(platform::ThreadPool& pool, std::string filename,
+          Interpolation interpolation = Bilinear, Format format = UNorm8,
+          std::shared_ptr<TextureCache const> cache = nullptr);
+  color::SColor const get(geometry::TexCoord const& p) const;
+
+  // Bytes of texel storage over all mip levels held by this texture.
+  size_t memoryUsage() const;
+
+  // Waits until the texels are decoded; rethrows a decoding error.
+  void wait() const { m_mipMap.get(); }
+  bool ready() const { return m_mipMap.ready(); }
+
+ private:
+  using MipMaps =
+      std::variant<MipMap<texel::UNorm8<3>>, MipMap<texel::SRGB8<3>>,
+                   MipMap<texel::Half<3>>, MipMap<texel::Float<3>>,
+                   PagedMipMap<texel::UNorm8<3>>, PagedMipMap<texel::SRGB8<3>>,
+                   PagedMipMap<texel::Half<3>>, PagedMipMap<texel::Float<3>>>;
+
+  static MipMaps load(std::string const& filename, Format format,
+                      std::shared_ptr<TextureCache const> const& cache);
 
  private:
-  std::vector<color::SColor> values;
-  color::ImageSize size;
+  Deferred<MipMaps> m_mipMap;
   Interpolation m_interpolation;
 };
 
-}  // namespace modelling
\ No newline at end of file
+}  // namespace modelling
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <color/Image.h>
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Out-of-core storage of texture pyramids. A texture is converted once into
+// a tiled file on disk; its pages are read on demand into a TextureCache
+// shared by all textures, which keeps the resident pages within a byte
+// budget by evicting the least recently used ones.
+
+namespace modelling {
+
+/**
+ * @brief Image pyramid on disk, each level cut into square pages of
+ * PageSize x PageSize texels of a fixed size.
+ */
+class TiledImageFile {
+ public:
+  static constexpr size_t PageBits = 6;
+  static constexpr size_t PageSize = size_t(1) << PageBits;
+
+  struct Level {
+    color::ImageSize size;
+    size_t pagesPerRow;
+    size_t pageRows;
+    uint64_t offset;
+  };
+
+  // Opens path and checks that its texels are texelSize bytes large.
+  TiledImageFile(std::string const& path, size_t texelSize);
+  ~TiledImageFile();
+  TiledImageFile(TiledImageFile const&) = delete;
+  TiledImageFile& operator=(TiledImageFile const&) = delete;
+
+  class Writer;
+
+  // True if path exists and is not older than source.
+  static bool upToDate(std::string const& path, std::string const& source);
+
+  static size_t pagesPerRow(color::ImageSize size) {
+    return (size.width + PageSize - 1) >> PageBits;
+  }
+  static size_t pageRows(color::ImageSize size) {
+    return (size.height + PageSize - 1) >> PageBits;
+  }
+
+  size_t pageBytes() const { return PageSize * PageSize * m_texelSize; }
+  void readPage(size_t level, size_t page, unsigned char* out) const;
+
+  std::vector<Level> const& levels() const { return m_levels; }
+  // Unique over the lifetime of the process.
+  uint64_t id() const { return m_id; }
+
+ private:
+  int m_fd;
+  size_t m_texelSize;
+  std::vector<Level> m_levels;
+  uint64_t m_id;
+};
+
+/**
+ * @brief Writes a tiled file in order: the pages of each level row by row,
+ * level after level, so that a pyramid need not be held in memory. The file
+ * appears at its path only once finish() succeeds.
+ */
+class TiledImageFile::Writer {
+ public:
+  Writer(std::string const& path, size_t texelSize,
+         std::vector<color::ImageSize> const& sizes);
+  // Removes the partial file unless finish() was called.
+  ~Writer();
+  Writer(Writer const&) = delete;
+  Writer& operator=(Writer const&) = delete;
+
+  // Appends the next pages, bytes a multiple of the page size.
+  void append(unsigned char const* pages, size_t bytes);
+  void finish();
+
+ private:
+  std::string m_path;
+  std::string m_temporary;
+  std::ofstream m_out;
+  uint64_t m_remaining;
+};
+
+struct TextureCacheStats {
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+  size_t residentBytes;
+};
+
+/**
+ * @brief LRU cache of texture pages, split into independently locked shards.
+ */
+class TextureCache {
+ public:
+  // Tiled files are written to directory, or next to their source image if
+  // it is empty.
+  explicit TextureCache(size_t byteBudget = size_t(256) << 20,
+                        std::string directory = "");
+  ~TextureCache();
+
+  // Texels of a page, read from disk on a miss. The pointer stays valid until
+  // the calling thread requests another page.
+  unsigned char const* page(TiledImageFile const& file, size_t level,
+                            size_t page) const;
+
+  // Path of the tiled file converted from source; tag names the texel format.
+  std::string tiledPath(std::string const& source,
+                        std::string const& tag) const;
+
+  // Repeated requests of the page a thread used last do not reach the
+  // shards and are not counted.
+  TextureCacheStats stats() const;
+  void resetStats();
+
+  // Bytes of the pages of file that are resident.
+  size_t residentBytes(TiledImageFile const& file) const;
+
+  size_t byteBudget() const { return m_byteBudget; }
+
+ private:
+  using Page = std::shared_ptr<std::vector<unsigned char> const>;
+  struct Shard;
+
+  static constexpr size_t Shards = 16;
+
+ private:
+  size_t m_byteBudget;
+  std::string m_directory;
+  std::unique_ptr<Shard[]> m_shards;
+};
+
+}  // namespace modelling
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string_view>
+
+// Instruction set levels of x86-64 and dispatch between kernels compiled for
+// each of them. The library is built for the baseline; a kernel wrapped in
+// Multiversioned is compiled once more per level and the variant of the
+// active level is called. The active level is the best one the CPU supports,
+// or the one named by the environment variable RAYTRACING_ISA (baseline,
+// sse4, avx2 or avx512) if that is lower.
+//
+// Variants are not bitwise equal: from avx2 on, the compiler contracts
+// multiplies and adds into FMA, which rounds once instead of twice. Kernels
+// whose results feed further computation, like ray intersections, return
+// values that differ in the last digits between levels.
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RAYTRACING_MULTIVERSIONING 1
+#define RAYTRACING_TARGET_SSE4 __attribute__((target("sse4.2,popcnt")))
+#define RAYTRACING_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define RAYTRACING_TARGET_AVX512 \
+  __attribute__((target("avx512f,avx512vl,avx512bw,avx512dq,avx2,fma")))
+#else
+#define RAYTRACING_MULTIVERSIONING 0
+#define RAYTRACING_TARGET_SSE4
+#define RAYTRACING_TARGET_AVX2
+#define RAYTRACING_TARGET_AVX512
+#endif
+
+// Kernels are inlined into each variant, so that the compiler vectorizes
+// them for its instruction set.
+#define RAYTRACING_KERNEL static inline __attribute__((always_inline))
+
+namespace platform {
+
+enum class IsaLevel { Baseline = 0, SSE4 = 1, AVX2 = 2, AVX512 = 3 };
+
+// Best level of the CPU.
+IsaLevel detectedIsaLevel();
+
+// Level whose kernels are called.
+IsaLevel isaLevel();
+
+// Selects the kernels of level, for benchmarking; throws if the CPU does
+// not support it.
+void forceIsaLevel(IsaLevel level);
+
+char const* isaLevelName(IsaLevel level);
+IsaLevel parseIsaLevel(std::string_view name);
+
+template <auto Kernel>
+struct Multiversioned;
+
+/**
+ * @brief Kernel compiled for every level. Multiversioned<kernel>::call(...)
+ * calls the variant of the active level, which costs a switch on top of
+ * the call, so kernels should loop over a row or a batch.
+ */
+template <typename R, typename... Args, R (*Kernel)(Args...)>
+struct Multiversioned<Kernel> {
+  static R call(Args... args) {
+#if RAYTRACING_MULTIVERSIONING
+    switch (isaLevel()) {
+      case IsaLevel::AVX512:
+        return avx512(static_cast<Args>(args)...);
+      case IsaLevel::AVX2:
+        return avx2(static_cast<Args>(args)...);
+      case IsaLevel::SSE4:
+        return sse4(static_cast<Args>(args)...);
+      default:
+        break;
+    }
+#endif
+    return Kernel(static_cast<Args>(args)...);
+  }
+
+#if RAYTRACING_MULTIVERSIONING
+  RAYTRACING_TARGET_SSE4 static R sse4(Args... args) {
+    return Kernel(static_cast<Args>(args)...);
+  }
+  RAYTRACING_TARGET_AVX2 static R avx2(Args... args) {
+    return Kernel(static_cast<Args>(args)...);
+  }
+  RAYTRACING_TARGET_AVX512 static R avx512(Args... args) {
+    return Kernel(static_cast<Args>(args)...);
+  }
+#endif
+};
+
+}  // namespace platform
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+
+// Timeline of scoped spans, written as Chrome trace-event JSON that loads in
+// chrome://tracing and ui.perfetto.dev. Each thread records into a ring
+// buffer of its own, without locks, keeping its latest spans. Recording is
+// off until start(); a span then costs two clock reads.
+
+namespace platform {
+
+namespace trace {
+
+struct Event {
+  char const* name;
+  // Nanoseconds since start().
+  uint64_t begin;
+  uint64_t duration;
+  // Row, band or pass number, or -1.
+  int64_t index;
+  // End of a file name or other text, null-terminated.
+  char detail[32];
+};
+
+inline std::atomic<bool> active{false};
+
+// Steady clock time of start() in nanoseconds.
+inline std::atomic<int64_t> epoch{0};
+
+// Number of start() calls; times of different generations are relative to
+// different epochs.
+inline std::atomic<uint64_t> generation{0};
+
+inline uint64_t now() {
+  int64_t t = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now().time_since_epoch())
+                  .count();
+  return static_cast<uint64_t>(t - epoch.load(std::memory_order_relaxed));
+}
+
+// Drops the spans recorded so far and starts recording, keeping up to
+// eventsPerThread spans per thread.
+void start(size_t eventsPerThread = 1 << 14);
+
+// Spans that are open when recording starts or stops are not recorded.
+void stop();
+
+// Writes the spans recorded since start(). Call it when the traced work has
+// finished, either before or after stop().
+void writeJSON(std::ostream& out);
+
+void record(Event const& event);
+
+/**
+ * @brief Records the time from construction to destruction under name,
+ * which must be a string literal.
+ */
+class Span {
+ public:
+  explicit Span(char const* name, int64_t index = -1,
+                std::string_view detail = {})
+      : m_name(active.load(std::memory_order_relaxed) ? name : nullptr),
+        m_index(index),
+        m_detail(detail),
+        m_generation(m_name ? generation.load(std::memory_order_acquire) : 0),
+        m_begin(m_name ? now() : 0) {}
+
+  Span(char const* name, std::string_view detail) : Span(name, -1, detail) {}
+
+  ~Span();
+
+  Span(Span const&) = delete;
+  Span& operator=(Span const&) = delete;
+
+ private:
+  char const* m_name;
+  int64_t m_index;
+  std::string_view m_detail;
+  uint64_t m_generation;
+  uint64_t m_begin;
+};
+
+inline Span::~Span() {
+  if (!m_name || !active.load(std::memory_order_relaxed)) return;
+
+  // Opened before a later start().
+  if (generation.load(std::memory_order_acquire) != m_generation) return;
+  uint64_t end = now();
+
+  Event event{m_name, m_begin, end - m_begin, m_index, {}};
+  // The end of a path names the file.
+  std::string_view detail = m_detail;
+  if (detail.size() >= sizeof(event.detail))
+    detail = detail.substr(detail.size() - sizeof(event.detail) + 1);
+  detail.copy(event.detail, detail.size());
+  record(event);
+}
+
+}  // namespace trace
+
+}  // namespace platform
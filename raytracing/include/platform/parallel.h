@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace platform {
+
+inline size_t defaultThreadCount() {
+  return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+// Threads that parallelFor(n, nThreads, ...) runs on.
+inline size_t threadCount(size_t n, size_t nThreads) {
+  return std::min(nThreads == 0 ? defaultThreadCount() : nThreads, n);
+}
+
+/**
+ * @brief Calls f(i) for every i in [0, n) on threadCount(n, nThreads)
+ * threads. Indices are handed out one at a time, so uneven work per index
+ * balances out. The first exception thrown by f stops handing out indices
+ * and is rethrown on the calling thread once all threads have joined.
+ * Thread t, the calling thread being 0, calls done(t) before it finishes.
+ */
+template <typename F, typename Done>
+void parallelFor(size_t n, size_t nThreads, F const& f, Done const& done) {
+  nThreads = threadCount(n, nThreads);
+
+  std::atomic<size_t> next(0);
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  auto worker = [&](size_t t) {
+    try {
+      for (size_t i = next++; i < n; i = next++) f(i);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(errorMutex);
+      if (!error) error = std::current_exception();
+      next = n;
+    }
+    done(t);
+  };
+
+  std::vector<std::thread> threads;
+  for (size_t t = 1; t < nThreads; ++t) threads.emplace_back(worker, t);
+  worker(0);
+  for (auto& thread : threads) thread.join();
+  if (error) std::rethrow_exception(error);
+}
+
+template <typename F>
+void parallelFor(size_t n, size_t nThreads, F const& f) {
+  parallelFor(n, nThreads, f, [](size_t) {});
+}
+
+/**
+ * @brief Fixed set of threads running submitted tasks in FIFO order. The
+ * destructor finishes the queued tasks before joining.
+ */
+class ThreadPool {
+ public:
+  explicit ThreadPool(size_t nThreads = 0) {
+    if (nThreads == 0) nThreads = defaultThreadCount();
+    for (size_t t = 0; t < nThreads; ++t)
+      m_threads.emplace_back([this]() { run(); });
+  }
+
+  ~ThreadPool() {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_stop = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) thread.join();
+  }
+
+  ThreadPool(ThreadPool const&) = delete;
+  ThreadPool& operator=(ThreadPool const&) = delete;
+
+  template <typename F>
+  std::future<std::invoke_result_t<F>> submit(F f) {
+    auto task =
+        std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(
+            std::move(f));
+    auto result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.emplace_back([task]() { (*task)(); });
+    }
+    m_wake.notify_one();
+    return result;
+  }
+
+ private:
+  void run() {
+    for (;;) {
+      std::function<void()> task;
+      {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wake.wait(lock, [this]() { return m_stop || !m_tasks.empty(); });
+        if (m_tasks.empty()) return;
+        task = std::move(m_tasks.front());
+        m_tasks.pop_front();
+      }
+      task();
+    }
+  }
+
+  std::mutex m_mutex;
+  std::condition_variable m_wake;
+  std::deque<std::function<void()>> m_tasks;
+  bool m_stop = false;
+  std::vector<std::thread> m_threads;
+};
+
+}  // namespace platform
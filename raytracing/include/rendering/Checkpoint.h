@@ -0,0 +1,75 @@
+#pragma once
+
+#include <color/Framebuffer.h>
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace rendering {
+
+struct CheckpointSettings {
+  // Accumulation file; empty renders in memory without checkpoints.
+  std::string path;
+  // Seconds between flushes of the file to disk.
+  double interval = 30.0;
+  // Identifies the content of the scene. The fingerprint of the file covers
+  // the image size, the settings, the camera and the number and shapes of
+  // the primitives and emitters, but not their parameters, materials or
+  // textures; a caller that edits those between runs must change the id,
+  // e.g. to a hash of its scene description, or the stale samples of the
+  // file are blended into the new image. The fingerprint also covers the
+  // instruction set level of the kernels, whose results differ in the last
+  // digits between levels: resume on another machine with RAYTRACING_ISA
+  // set to the level of the first run.
+  uint64_t sceneId = 0;
+};
+
+/**
+ * @brief Per-pixel sums of linear RGB samples and their counts, kept in a
+ * memory-mapped file. The file is created on first use and reopened by a
+ * render that resumes; its fingerprint identifies the render it belongs to.
+ *
+ * A pixel is written with a single aligned 16-byte store, so a process that
+ * is killed leaves each pixel either before or after its last sample.
+ */
+class AccumulationBuffer {
+ public:
+  struct alignas(16) Pixel {
+    float sum[3];
+    uint32_t samples;
+  };
+
+  AccumulationBuffer(std::string const& path, color::ImageSize size,
+                     uint64_t fingerprint);
+  ~AccumulationBuffer();
+  AccumulationBuffer(AccumulationBuffer const&) = delete;
+  AccumulationBuffer& operator=(AccumulationBuffer const&) = delete;
+
+  color::ImageSize size() const { return m_size; }
+  // True if the file existed and holds samples of an earlier run.
+  bool resumed() const { return m_resumed; }
+
+  Pixel get(size_t x, size_t y) const;
+  void set(size_t x, size_t y, Pixel const& pixel);
+
+  // Writes the file to disk. Safe to call while other threads set pixels.
+  void flush();
+  // Flushes if interval seconds have passed since the last flush.
+  void flushEvery(double interval);
+
+  // Mean of the samples of each pixel.
+  color::Framebuffer framebuffer(color::Framebuffer::Storage storage) const;
+
+ private:
+  color::ImageSize m_size;
+  int m_fd;
+  size_t m_bytes;
+  void* m_map;
+  Pixel* m_pixels;
+  bool m_resumed;
+  std::mutex m_flushMutex;
+  double m_lastFlush;
+};
+
+}  // namespace rendering
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <color/Image.h>
+#include <modelling/Primitive.h>
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace rendering {
+
+/**
+ * @brief Where the time of a render goes: per-pixel heatmaps of wall-clock
+ * time, intersection tests and path depth, and the share of each primitive.
+ */
+struct CostMap {
+  struct PrimitiveCost {
+    size_t index;
+    modelling::Primitive::Shape shape;
+    // Intersection tests, including those of shadow rays.
+    uint64_t tests;
+    // Nearest hits of any ray.
+    uint64_t hits;
+    // Pixels in which it is the first surface seen, and their total time.
+    uint64_t pixels;
+    double seconds;
+  };
+
+  color::ImageSize size;
+  // Row-major, row 0 at the top.
+  std::vector<float> nanoseconds;
+  std::vector<float> tests;
+  // Mean path vertices per sample.
+  std::vector<float> depth;
+  // In the order of RenderScene::primitives.
+  std::vector<PrimitiveCost> primitives;
+
+  // Writes <prefix>_time.png, <prefix>_tests.png and <prefix>_depth.png,
+  // each scaled so that its 99th percentile is the hottest color.
+  void saveHeatmaps(std::string const& prefix) const;
+  // CSV of the primitives, most expensive first.
+  void writeTable(std::ostream& out) const;
+};
+
+}  // namespace rendering
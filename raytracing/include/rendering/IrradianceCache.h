@@ -0,0 +1,84 @@
+#pragma once
+
+#include <color/Spectrum.h>
+#include <geometry/Point3D.h>
+
+#include <array>
+#include <functional>
+#include <memory>
+#include <shared_mutex>
+#include <vector>
+
+// Irradiance caching after Ward et al. (1988) with the translational and
+// rotational gradients of Ward and Heckbert (1992).
+//
+// The cached quantity is the diffuse transfer of the path tracer's diffuse
+// lobe, the integral of cos^3 / pi^2 times the incident radiance over the
+// hemisphere, so that cached and path traced images converge to the same
+// result.
+
+namespace rendering {
+
+struct IrradianceCacheSettings {
+  bool enabled = false;
+  // Maximal interpolation error; records are used within a * R_i.
+  double accuracy = 0.4;
+  // Hemisphere strata of a new record, in theta and phi, one path each.
+  // Fewer strata give cheaper but noisier records; with the accuracy above,
+  // 4 x 12 reached a given error soonest on the convergence scenes.
+  size_t thetaStrata = 4;
+  size_t phiStrata = 12;
+  // Clamping of the record radius R_i.
+  geometry::Coord minSpacing = 0.05;
+  geometry::Coord maxSpacing = 4.0;
+};
+
+/**
+ * @brief Octree of irradiance records. Lookups may run concurrently with each
+ * other; inserting takes an exclusive lock.
+ */
+class IrradianceCache {
+ public:
+  struct Record {
+    geometry::Point3D x;
+    geometry::Normal3D n;
+    geometry::Coord radius;
+    color::SColor value;
+    std::array<color::SColor, 3> rotation;
+    std::array<color::SColor, 3> translation;
+  };
+
+  // Incident radiance along a ray and the distance of the first hit.
+  using Incoming =
+      std::function<std::pair<color::SColor, geometry::Coord>(geometry::Ray)>;
+
+  IrradianceCache(geometry::Point3D min, geometry::Point3D max,
+                  IrradianceCacheSettings const& settings);
+  ~IrradianceCache();
+
+  // Interpolates the records around x, returns false if none is valid.
+  bool lookup(geometry::Point3D const& x, geometry::Normal3D const& n,
+              color::SColor& value) const;
+
+  Record computeRecord(geometry::Point3D const& x, geometry::Normal3D const& n,
+                       Incoming const& incoming) const;
+
+  void insert(Record record);
+
+  // Looks up x and computes and inserts a new record if needed.
+  color::SColor get(geometry::Point3D const& x, geometry::Normal3D const& n,
+                    Incoming const& incoming);
+
+  size_t size() const;
+
+ private:
+  struct Node;
+
+ private:
+  IrradianceCacheSettings m_settings;
+  std::unique_ptr<Node> m_root;
+  size_t m_size;
+  mutable std::shared_mutex m_mutex;
+};
+
+}  // namespace rendering
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <geometry/Point2D.h>
+#include <geometry/Point3D.h>
+#include <modelling/Material.h>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Path guiding after Mueller et al., "Practical Path Guiding for Efficient
+// Light-Transport Simulation" (2017): a binary spatial tree whose leaves hold
+// directional quadtrees over the cylindrical parameterization of the sphere.
+
+namespace rendering {
+
+struct PathGuidingSettings {
+  bool enabled = false;
+  // Number of training passes; pass k traces 2^k samples per pixel.
+  size_t trainingPasses = 4;
+  // Probability of sampling the cosine lobe instead of the learned
+  // distribution at diffuse vertices.
+  double bsdfFraction = 0.5;
+  // A spatial leaf is split after pass k once it collected more than
+  // spatialThreshold * sqrt(2^k) samples.
+  double spatialThreshold = 4000.0;
+  // A directional node is subdivided if it holds more than this fraction of
+  // the energy of its tree.
+  double directionalThreshold = 0.01;
+  size_t maxDirectionalDepth = 20;
+};
+
+/**
+ * @brief Directional quadtree: a piecewise constant distribution of incident
+ * radiance over the sphere.
+ *
+ * Recording is thread-safe; build(), refine() and copying are not and must
+ * only run between passes.
+ */
+class DTree : public modelling::DirectionalDistribution {
+ public:
+  DTree();
+
+  void record(geometry::Normal3D const& dir, double value);
+
+  // Propagates the recorded leaf energies to the inner nodes.
+  void build();
+
+  // Rebuilds the structure of this tree from the energies of `learned` and
+  // clears the recorded energies.
+  void refine(DTree const& learned, double threshold, size_t maxDepth);
+
+  double total() const;
+
+  geometry::Normal3D sample(double u, double v) const override;
+  double pdf(geometry::Normal3D const& dir) const override;
+
+ private:
+  struct Node {
+    Node();
+    Node(Node const& other);
+    Node& operator=(Node const& other);
+
+    std::atomic<float> sum[4];
+    uint32_t child[4];
+  };
+
+  void subdivide(uint32_t node, DTree const& learned, int64_t learnedNode,
+                 double const energy[4], double total, double threshold,
+                 size_t depth, size_t maxDepth);
+
+ private:
+  std::vector<Node> m_nodes;
+};
+
+/**
+ * @brief Spatial binary tree over the scene bounds whose leaves hold the
+ * directional distribution used for sampling and the one being learned.
+ */
+class SDTree {
+ public:
+  SDTree(geometry::Point3D min, geometry::Point3D max);
+
+  DTree const& distribution(geometry::Point3D const& x) const;
+
+  void record(geometry::Point3D const& x, geometry::Normal3D const& dir,
+              double value);
+
+  // Finishes training pass `pass`: the learned distributions become the
+  // sampling distributions and dense leaves are split.
+  void refine(size_t pass, PathGuidingSettings const& settings);
+
+ private:
+  struct Leaf {
+    DTree sampling;
+    DTree building;
+    std::atomic<size_t> samples{0};
+  };
+
+  struct Node {
+    uint32_t child[2];
+    unsigned axis;
+    std::unique_ptr<Leaf> leaf;
+  };
+
+  Leaf& leaf(geometry::Point3D const& x) const;
+  void split(uint32_t node, size_t samples, double threshold);
+
+ private:
+  geometry::Point3D m_min, m_max;
+  std::vector<Node> m_nodes;
+};
+
+}  // namespace rendering
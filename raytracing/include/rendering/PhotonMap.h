@@ -0,0 +1,59 @@
+#pragma once
+
+#include <color/Spectrum.h>
+#include <geometry/Point3D.h>
+#include <rendering/RenderScene.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace rendering {
+
+struct PhotonMapSettings {
+  bool enabled = false;
+  // Number of photons emitted from all emitters together.
+  size_t photons = 200000;
+  // Radius of the density estimation.
+  geometry::Coord radius = 0.1;
+  size_t maxDepth = 16;
+};
+
+/**
+ * @brief Caustic photon map: photons that reached a non-specular surface
+ * through at least one ideal reflection or refraction, stored in a hashed
+ * uniform grid with cells of twice the lookup radius.
+ */
+class PhotonMap {
+ public:
+  struct Photon {
+    float pos[3];
+    float dir[3];
+    float power[3];
+  };
+
+  PhotonMap(RenderScene const& renderScene, PhotonMapSettings const& settings,
+            size_t threads = 0);
+
+  // Radiance reflected towards V by the photons around x.
+  color::SColor estimate(modelling::Primitive const& primitive,
+                         geometry::Point3D const& x,
+                         geometry::Normal3D const& N,
+                         geometry::Normal3D const& V,
+                         geometry::TexCoord const& uv) const;
+
+  size_t size() const { return m_photons.size(); }
+
+ private:
+  void build(std::vector<Photon> const& photons, size_t threads);
+
+  size_t cellIndex(int64_t x, int64_t y, int64_t z) const;
+  int64_t cellCoord(geometry::Coord c) const;
+
+ private:
+  PhotonMapSettings m_settings;
+  std::vector<Photon> m_photons;
+  // Photons of hash cell i are m_photons[m_cellStart[i] .. m_cellStart[i+1]).
+  std::vector<uint32_t> m_cellStart;
+};
+
+}  // namespace rendering
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+
+// Counters of the tracing hot paths. Each thread counts into a block of its
+// own, without atomics, and parallelFor() adds the blocks of its workers to
+// that of the calling thread when they join. The work of a render therefore
+// ends up in the block of the thread that called it, apart from concurrent
+// renders. Configuring with -DRAYTRACING_STATS=OFF removes the counting,
+// leaving only the stage times.
+
+namespace rendering {
+
+#ifdef RAYTRACING_STATS
+constexpr bool StatsEnabled = true;
+#else
+constexpr bool StatsEnabled = false;
+#endif
+
+// Why a path stopped.
+enum class Termination {
+  Missed,         // left the scene
+  Absorbed,       // no reflection sampled
+  Cached,         // diffuse lobe taken from the irradiance cache
+  Grazing,        // reflection tangent to the surface
+  LowThroughput,  // weight below 1e-8
+  MaxDepth,
+  Count
+};
+
+// Surface types, in the order of modelling::Primitive::Shape.
+constexpr size_t ShapeCount = 5;
+constexpr size_t MaxPathLength = 64;
+
+struct RenderCounters {
+  uint64_t cameraRays = 0;
+  uint64_t bounceRays = 0;
+  uint64_t shadowRays = 0;
+  // Shadow rays stopped by an opaque or fully attenuating surface.
+  uint64_t shadowRaysBlocked = 0;
+  // Emitter samples below the emission threshold, without a shadow ray.
+  uint64_t emitterSamplesSkipped = 0;
+  std::array<uint64_t, ShapeCount> primitiveTests{};
+  std::array<uint64_t, ShapeCount> shadowTests{};
+  // Vertices per path; longer paths are counted in the last bin.
+  std::array<uint64_t, MaxPathLength + 1> pathLengths{};
+  uint64_t pathVertices = 0;
+  std::array<uint64_t, size_t(Termination::Count)> terminations{};
+
+  RenderCounters& operator+=(RenderCounters const& other);
+  RenderCounters& operator-=(RenderCounters const& other);
+};
+
+struct RenderStats {
+  RenderCounters counters;
+  // Seconds per stage.
+  double photonMapTime = 0.0;
+  double guidingTime = 0.0;
+  double imageTime = 0.0;
+  double totalTime = 0.0;
+
+  void writeJSON(std::ostream& out) const;
+};
+
+namespace stats {
+
+// Counts per scene primitive, indexed like RenderScene::primitives, kept by
+// a thread only while a cost map is rendered.
+struct PrimitiveCounters {
+  std::vector<uint64_t> tests;
+  // Nearest hits of any ray.
+  std::vector<uint64_t> hits;
+  // The first primitive hit since this was last reset, normally the one
+  // seen by the camera ray.
+  size_t firstHit = NoPrimitive;
+
+  static constexpr size_t NoPrimitive = ~size_t(0);
+};
+
+struct ThreadCounters {
+  RenderCounters counters;
+  PrimitiveCounters* primitives = nullptr;
+};
+
+// Constant initialized and defined here, so that access needs no call.
+inline thread_local ThreadCounters threadCounters;
+
+// The block of the calling thread, including the blocks of the parallelFor()
+// workers it has joined.
+inline RenderCounters& counters() { return threadCounters.counters; }
+
+inline void count(uint64_t RenderCounters::*field, uint64_t n = 1) {
+  if constexpr (StatsEnabled) counters().*field += n;
+}
+
+inline void countTest(size_t shape) {
+  if constexpr (StatsEnabled) ++counters().primitiveTests[shape];
+}
+
+inline void countShadowTest(size_t shape) {
+  if constexpr (StatsEnabled) ++counters().shadowTests[shape];
+}
+
+inline void countPath(size_t length, Termination termination) {
+  if constexpr (StatsEnabled) {
+    RenderCounters& c = counters();
+    ++c.pathLengths[length < MaxPathLength ? length : MaxPathLength];
+    c.pathVertices += length;
+    ++c.terminations[size_t(termination)];
+  }
+}
+
+inline void countPrimitiveTest(size_t index) {
+  if constexpr (StatsEnabled)
+    if (PrimitiveCounters* p = threadCounters.primitives) ++p->tests[index];
+}
+
+inline void countPrimitiveHit(size_t index) {
+  if constexpr (StatsEnabled) {
+    if (PrimitiveCounters* p = threadCounters.primitives) {
+      ++p->hits[index];
+      if (p->firstHit == PrimitiveCounters::NoPrimitive) p->firstHit = index;
+    }
+  }
+}
+
+}  // namespace stats
+
+}  // namespace rendering
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <platform/parallel.h>
+#include <rendering/RenderStats.h>
+
+#include <vector>
+
+namespace rendering {
+
+/**
+ * @brief platform::parallelFor() that adds the stats counters of the worker
+ * threads to those of the calling thread once they have joined, also when
+ * f throws.
+ */
+template <typename F>
+void parallelFor(size_t n, size_t nThreads, F const& f) {
+  std::vector<RenderCounters> counters(
+      StatsEnabled ? platform::threadCount(n, nThreads) : 0);
+  auto fold = [&counters]() {
+    for (size_t t = 1; t < counters.size(); ++t)
+      stats::counters() += counters[t];
+  };
+  try {
+    platform::parallelFor(n, nThreads, f, [&counters](size_t t) {
+      if (t > 0 && t < counters.size()) counters[t] = stats::counters();
+    });
+  } catch (...) {
+    fold();
+    throw;
+  }
+  fold();
+}
+
+}  // namespace rendering
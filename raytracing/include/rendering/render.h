@@ -1,12 +1,79 @@
 #pragma once
 
+#include <color/Framebuffer.h>
 #include <color/Image.h>
+#include <color/RowWriter.h>
+#include <rendering/Checkpoint.h>
+#include <rendering/CostMap.h>
+#include <rendering/IrradianceCache.h>
+#include <rendering/PathGuiding.h>
+#include <rendering/PhotonMap.h>
 #include <rendering/RenderScene.h>
+#include <rendering/RenderStats.h>
 
 namespace rendering {
 
+struct Intersection {
+  std::shared_ptr<modelling::Primitive> primitive;
+  geometry::Coord x;
+  // Part of the primitive hit, for its shading queries.
+  uint32_t part;
+};
+
+Intersection intersect(RenderScene const& renderScene, geometry::Ray ray);
+
+struct RenderSettings {
+  size_t gridSize = 4;
+  size_t maxDepth = 32;
+  // 0: one thread per hardware thread
+  size_t threads = 0;
+  PathGuidingSettings guiding{};
+  // Caustics from density estimation on a photon map; shadow rays then no
+  // longer pass through transparent objects.
+  PhotonMapSettings caustics{};
+  // Diffuse interreflection is interpolated from an irradiance cache at the
+  // first diffuse vertex of each path instead of being path traced.
+  IrradianceCacheSettings irradianceCache{};
+  // Precision of the linear framebuffer.
+  color::Framebuffer::Storage framebuffer = color::Framebuffer::Float;
+  // With a path, samples accumulate in that file, and a render started
+  // again with the same scene id and settings continues from it. The photon
+  // map is rebuilt the same; a guiding tree or irradiance cache is learned
+  // again, from other samples than in the interrupted run.
+  CheckpointSettings checkpoint{};
+};
+
 color::ImageData render(RenderScene const& renderScene,
                         color::ImageSize imageSize, size_t gridSize = 4,
                         size_t maxDepth = 32);
 
-}  // namespace rendering
\ No newline at end of file
+// Clamped to [0, 1].
+color::ImageData render(RenderScene const& renderScene,
+                        color::ImageSize imageSize,
+                        RenderSettings const& settings);
+
+// Linear radiance, not clamped. Without path guiding and irradiance caching,
+// which learn from the samples in the order they are taken, the image does
+// not depend on the number of threads; the caustic photon map is seeded per
+// photon, so it is the same on every run. With stats, the ray counters and
+// stage times of the render are stored there.
+color::Framebuffer renderFramebuffer(RenderScene const& renderScene,
+                                     color::ImageSize imageSize,
+                                     RenderSettings const& settings,
+                                     RenderStats* stats = nullptr);
+
+// Diagnostic render: times every pixel of the same pipeline as
+// renderFramebuffer() and attributes it to the first primitive seen.
+// Intersection tests and path depth are only counted with RAYTRACING_STATS.
+CostMap renderCostMap(RenderScene const& renderScene,
+                      color::ImageSize imageSize,
+                      RenderSettings const& settings);
+
+// Renders bands of bandHeight rows and hands each finished band to writer,
+// so that memory does not grow with the image height.
+void renderStreaming(RenderScene const& renderScene,
+                     color::ImageSize imageSize,
+                     RenderSettings const& settings, color::RowWriter& writer,
+                     size_t bandHeight = 64, RenderStats* stats = nullptr);
+
+}  // namespace rendering
@@ -0,0 +1,133 @@
+#include <color/Framebuffer.h>
+#include <color/Half.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace color {
+
+/**
+ * @brief Construct a new Framebuffer:: Framebuffer object
+ *
+ * @param size
+ * @param storage
+ */
+Framebuffer::Framebuffer(ImageSize size, Storage storage)
+    : m_size(size), m_storage(storage) {
+  if (m_storage == Half)
+    m_half.assign(3 * size.width * size.height, floatToHalf(0.0f));
+  else
+    m_float.assign(3 * size.width * size.height, 0.0f);
+}
+
+RGB Framebuffer::get(size_t x, size_t y) const {
+  size_t i = 3 * (y * m_size.width + x);
+  if (m_storage == Half)
+    return RGB(halfToFloat(m_half[i]), halfToFloat(m_half[i + 1]),
+               halfToFloat(m_half[i + 2]));
+  return RGB(m_float[i], m_float[i + 1], m_float[i + 2]);
+}
+
+void Framebuffer::set(size_t x, size_t y, RGB const& rgb) {
+  size_t i = 3 * (y * m_size.width + x);
+  float c[3] = {static_cast<float>(rgb.r), static_cast<float>(rgb.g),
+                static_cast<float>(rgb.b)};
+  if (m_storage == Half) {
+    for (size_t k = 0; k < 3; ++k) m_half[i + k] = floatToHalf(c[k]);
+  } else {
+    for (size_t k = 0; k < 3; ++k) m_float[i + k] = c[k];
+  }
+}
+
+void Framebuffer::add(size_t x, size_t y, RGB const& rgb) {
+  RGB sum = get(x, y);
+  set(x, y, RGB(sum.r + rgb.r, sum.g + rgb.g, sum.b + rgb.b));
+}
+
+void Framebuffer::row(size_t y, float* out) const {
+  // Every half value, for decoding whole rows.
+  static const std::vector<float> halfTable = []() {
+    std::vector<float> table(1 << 16);
+    for (size_t h = 0; h < table.size(); ++h)
+      table[h] = halfToFloat(static_cast<uint16_t>(h));
+    return table;
+  }();
+
+  size_t n = 3 * m_size.width;
+  if (m_storage == Half) {
+    uint16_t const* in = m_half.data() + y * n;
+    for (size_t i = 0; i < n; ++i) out[i] = halfTable[in[i]];
+  } else {
+    std::copy_n(m_float.data() + y * n, n, out);
+  }
+}
+
+size_t Framebuffer::memoryUsage() const {
+  return m_float.size() * sizeof(float) + m_half.size() * sizeof(uint16_t);
+}
+
+Image Framebuffer::toImage(Intensity exposure) const {
+  auto clamp = [&](Intensity c) {
+    return std::max(Intensity(0.0), std::min(Intensity(1.0), c * exposure));
+  };
+
+  Image image{m_size, {}};
+  image.data.reserve(m_size.width * m_size.height);
+  for (size_t y = 0; y < m_size.height; ++y)
+    for (size_t x = 0; x < m_size.width; ++x) {
+      RGB rgb = get(x, y);
+      image.data.emplace_back(clamp(rgb.r), clamp(rgb.g), clamp(rgb.b));
+    }
+  return image;
+}
+
+void savePFM(std::string filename, Framebuffer const& framebuffer) {
+  std::ofstream out(filename, std::ios::binary);
+  if (!out) throw "[write_pfm_file] File could not be opened for writing";
+
+  ImageSize size = framebuffer.size();
+  // A negative scale marks little-endian data.
+  out << "PF\n" << size.width << " " << size.height << "\n-1.0\n";
+
+  // Rows are stored bottom to top.
+  std::vector<float> row(3 * size.width);
+  for (size_t y = size.height; y-- > 0;) {
+    for (size_t x = 0; x < size.width; ++x) {
+      RGB rgb = framebuffer.get(x, y);
+      row[3 * x] = static_cast<float>(rgb.r);
+      row[3 * x + 1] = static_cast<float>(rgb.g);
+      row[3 * x + 2] = static_cast<float>(rgb.b);
+    }
+    out.write(reinterpret_cast<char const*>(row.data()),
+              static_cast<std::streamsize>(row.size() * sizeof(float)));
+  }
+
+  if (!out) throw "[write_pfm_file] Error during writing bytes";
+}
+
+Framebuffer loadPFM(std::string filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) throw "[read_pfm_file] File could not be opened for reading";
+
+  std::string magic;
+  size_t width = 0, height = 0;
+  double scale = 0.0;
+  in >> magic >> width >> height >> scale;
+  in.get();
+  if (!in || magic != "PF") throw "[read_pfm_file] Not an RGB PFM file";
+  if (scale > 0.0) throw "[read_pfm_file] Big-endian PFM is not supported";
+
+  Framebuffer framebuffer({width, height}, Framebuffer::Float);
+  std::vector<float> row(3 * width);
+  for (size_t y = height; y-- > 0;) {
+    in.read(reinterpret_cast<char*>(row.data()),
+            static_cast<std::streamsize>(row.size() * sizeof(float)));
+    if (!in) throw "[read_pfm_file] Error during reading bytes";
+    for (size_t x = 0; x < width; ++x)
+      framebuffer.set(x, y, RGB(row[3 * x], row[3 * x + 1], row[3 * x + 2]));
+  }
+  return framebuffer;
+}
+
+}  // namespace color
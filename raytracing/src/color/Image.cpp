@@ -1,159 +1,278 @@
 #include <color/Image.h>
+#include <color/RowWriter.h>
+#include <external/fpng/include/fpng.h>
 #include <png.h>
+#include <platform/Trace.h>
+#include <platform/parallel.h>
 #include <stdio.h>
+#include <zlib.h>
 
-#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <mutex>
 
-// Source: http://zarb.org/~gc/html/libpng.html
+// PNG files are written with fpng, or for large frames as zlib-compressed
+// stripes in parallel. Files written by fpng are read back with fpng; any
+// other PNG goes through libpng's simplified API.
 
 namespace color {
 
-void saveImage(std::string filename, Image const& image) {
-  int bit_depth = 8;
-  int color_type = PNG_COLOR_TYPE_RGB;
-  png_bytep* row_pointers = new png_bytep[image.size.height];
-
-  std::vector<png_byte> rawData;
-  rawData.reserve(3 * image.data.size());
+// Frames of at least this many pixels are compressed in parallel stripes
+// when there are enough threads; one zlib stripe encoder runs at about a
+// third of fpng's speed.
+static const size_t StripedEncodePixels = size_t(1) << 21;
+static const size_t StripedEncodeThreads = 4;
+static const size_t StripeRows = 128;
 
-  for (auto const& rgb : image.data) {
-    rawData.push_back(static_cast<png_byte>(255 * rgb.r));
-    rawData.push_back(static_cast<png_byte>(255 * rgb.g));
-    rawData.push_back(static_cast<png_byte>(255 * rgb.b));
-  }
+static_assert(sizeof(RGB) == 3 * sizeof(Intensity),
+              "RGB is read and written as a flat array of intensities");
 
-  for (size_t i = 0; i < image.size.height; ++i)
-    row_pointers[i] = rawData.data() + i * 3 * image.size.width;
+static void initFpng() {
+  static std::once_flag once;
+  std::call_once(once, []() { fpng::fpng_init(); });
+}
 
-  png_structp png_ptr;
-  png_infop info_ptr;
+// Plain loops over flat arrays so that the compiler vectorizes them. Values
+// are rounded to the nearest byte, the same rule as postProcess().
+static std::vector<uint8_t> toBytes(Image const& image) {
+  size_t n = 3 * image.data.size();
+  Intensity const* in = &image.data.data()->r;
+  std::vector<uint8_t> out(n);
+  for (size_t i = 0; i < n; ++i)
+    out[i] = static_cast<uint8_t>(
+        std::min(std::max(255.0 * in[i] + 0.5, 0.0), 255.0));
+  return out;
+}
 
-  /* create file */
-  FILE* fp = fopen(filename.c_str(), "wb");
-  if (!fp) throw "[write_png_file] File could not be opened for writing";
+static ImageData fromBytes(uint8_t const* in, size_t pixels) {
+  ImageData data(pixels, RGB(0.0, 0.0, 0.0));
+  Intensity* out = &data.data()->r;
+  for (size_t i = 0; i < 3 * pixels; ++i)
+    out[i] = static_cast<Intensity>(in[i]) / 255.0;
+  return data;
+}
 
-  /* initialize stuff */
-  png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+static void putUint32(std::vector<uint8_t>& out, uint32_t v) {
+  uint8_t bytes[4] = {uint8_t(v >> 24), uint8_t(v >> 16), uint8_t(v >> 8),
+                      uint8_t(v)};
+  out.insert(out.end(), bytes, bytes + 4);
+}
 
-  if (!png_ptr) throw "[write_png_file] png_create_write_struct failed";
+struct Stripe {
+  std::vector<uint8_t> deflated;
+  uLong adler;
+  size_t filteredBytes;
+};
+
+// Sub-filters and deflates `rows` rows as a raw deflate stream that ends on a
+// byte boundary without a final block, so that stripes can be concatenated.
+static Stripe compressStripe(uint8_t const* bytes, size_t width,
+                             size_t rows) {
+  size_t rowBytes = 3 * width;
+  std::vector<uint8_t> filtered((rowBytes + 1) * rows);
+  for (size_t i = 0; i < rows; ++i) {
+    uint8_t const* row = bytes + i * rowBytes;
+    uint8_t* out = filtered.data() + i * (rowBytes + 1);
+    out[0] = 1;
+    std::memcpy(out + 1, row, std::min<size_t>(3, rowBytes));
+    for (size_t j = 3; j < rowBytes; ++j)
+      out[1 + j] = static_cast<uint8_t>(row[j] - row[j - 3]);
+  }
 
-  info_ptr = png_create_info_struct(png_ptr);
-  if (!info_ptr) throw "[write_png_file] png_create_info_struct failed";
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (deflateInit2(&stream, 1, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    throw "[write_png_file] deflateInit2 failed";
+
+  Stripe stripe;
+  stripe.deflated.resize(
+      deflateBound(&stream, static_cast<uLong>(filtered.size())) + 16);
+  stream.next_in = filtered.data();
+  stream.avail_in = static_cast<uInt>(filtered.size());
+  stream.next_out = stripe.deflated.data();
+  stream.avail_out = static_cast<uInt>(stripe.deflated.size());
+  int status = deflate(&stream, Z_SYNC_FLUSH);
+  stripe.deflated.resize(stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_OK) throw "[write_png_file] deflate failed";
+
+  stripe.adler =
+      adler32(1, filtered.data(), static_cast<uInt>(filtered.size()));
+  stripe.filteredBytes = filtered.size();
+  return stripe;
+}
 
-  if (setjmp(png_jmpbuf(png_ptr)))
-    throw "[write_png_file] Error during init_io";
+/**
+ * @brief Construct a new PNGRowWriter:: PNGRowWriter object
+ *
+ * @param filename
+ * @param size
+ * @param settings
+ */
+PNGRowWriter::PNGRowWriter(std::string const& filename, ImageSize size,
+                           PostProcessSettings settings)
+    : m_file(fopen(filename.c_str(), "wb")),
+      m_size(size),
+      m_settings(settings),
+      m_row(0),
+      m_adler(1) {
+  if (!m_file) throw "[write_png_file] File could not be opened for writing";
+
+  // The destructor does not run if the constructor throws.
+  try {
+    uint8_t const signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a,
+                                  '\n'};
+    if (fwrite(signature, 1, 8, m_file) != 8)
+      throw "[write_png_file] Error during writing header";
+
+    std::vector<uint8_t> header;
+    putUint32(header, static_cast<uint32_t>(size.width));
+    putUint32(header, static_cast<uint32_t>(size.height));
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    writeChunk("IHDR", header.data(), header.size());
+
+    uint8_t const zlibHeader[2] = {0x78, 0x01};
+    writeChunk("IDAT", zlibHeader, 2);
+  } catch (...) {
+    fclose(m_file);
+    throw;
+  }
+}
 
-  png_init_io(png_ptr, fp);
+PNGRowWriter::~PNGRowWriter() {
+  if (m_file) fclose(m_file);
+}
 
-  /* write header */
-  if (setjmp(png_jmpbuf(png_ptr)))
-    throw "[write_png_file] Error during writing header";
+void PNGRowWriter::writeChunk(char const* type, uint8_t const* data,
+                              size_t size) {
+  std::vector<uint8_t> out;
+  putUint32(out, static_cast<uint32_t>(size));
+  out.insert(out.end(), type, type + 4);
+  uLong crc = crc32(0, out.data() + 4, 4);
+  if (size > 0) crc = crc32(crc, data, static_cast<uInt>(size));
+
+  std::vector<uint8_t> trailer;
+  putUint32(trailer, static_cast<uint32_t>(crc));
+  if (fwrite(out.data(), 1, out.size(), m_file) != out.size() ||
+      (size > 0 && fwrite(data, 1, size, m_file) != size) ||
+      fwrite(trailer.data(), 1, trailer.size(), m_file) != trailer.size())
+    throw "[write_png_file] Error during writing bytes";
+}
 
-  auto width = static_cast<png_uint_32>(image.size.width);
-  auto height = static_cast<png_uint_32>(image.size.height);
+void PNGRowWriter::write(Framebuffer const& rows) {
+  std::vector<uint8_t> bytes = postProcess(rows, m_settings, m_row);
+  writeBytes(bytes.data(), rows.size().height);
+}
 
-  png_set_IHDR(png_ptr, info_ptr, width, height, bit_depth, color_type,
-               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE,
-               PNG_FILTER_TYPE_BASE);
+void PNGRowWriter::writeBytes(uint8_t const* bytes, size_t rows) {
+  if (m_row + rows > m_size.height) throw "[write_png_file] Too many rows";
+
+  size_t stripes = (rows + StripeRows - 1) / StripeRows;
+  std::vector<Stripe> compressed(stripes);
+  platform::parallelFor(stripes, 0, [&](size_t s) {
+    size_t begin = s * StripeRows;
+    size_t end = std::min(rows, begin + StripeRows);
+    compressed[s] = compressStripe(bytes + begin * 3 * m_size.width,
+                                   m_size.width, end - begin);
+  });
+
+  for (auto const& stripe : compressed) {
+    writeChunk("IDAT", stripe.deflated.data(), stripe.deflated.size());
+    m_adler = adler32_combine(m_adler, stripe.adler,
+                              static_cast<z_off_t>(stripe.filteredBytes));
+  }
+  m_row += rows;
+}
 
-  png_write_info(png_ptr, info_ptr);
+void PNGRowWriter::finish() {
+  if (m_row != m_size.height) throw "[write_png_file] Missing rows";
 
-  /* write bytes */
-  if (setjmp(png_jmpbuf(png_ptr)))
-    throw "[write_png_file] Error during writing bytes";
+  // An empty final block with fixed codes ends the deflate stream.
+  std::vector<uint8_t> end = {0x03, 0x00};
+  putUint32(end, static_cast<uint32_t>(m_adler));
+  writeChunk("IDAT", end.data(), end.size());
+  writeChunk("IEND", nullptr, 0);
 
-  png_write_image(png_ptr, row_pointers);
+  int status = fclose(m_file);
+  m_file = nullptr;
+  if (status != 0) throw "[write_png_file] Error during end of write";
+}
 
-  /* end write */
-  if (setjmp(png_jmpbuf(png_ptr)))
-    throw "[write_png_file] Error during end of write";
+void saveImage(std::string filename, Image const& image) {
+  saveImage(filename, image.size, toBytes(image));
+}
 
-  png_write_end(png_ptr, NULL);
+void saveImage(std::string filename, ImageSize size,
+               std::vector<uint8_t> const& bytes) {
+  platform::trace::Span span("encode PNG", filename);
+  auto width = static_cast<uint32_t>(size.width);
+  auto height = static_cast<uint32_t>(size.height);
+
+  bool striped = size.width * size.height >= StripedEncodePixels &&
+                 platform::defaultThreadCount() >= StripedEncodeThreads;
+  if (striped) {
+    PNGRowWriter writer(filename, size);
+    writer.writeBytes(bytes.data(), size.height);
+    writer.finish();
+    return;
+  }
 
-  /* cleanup heap allocation */
-  delete[] row_pointers;
+  initFpng();
+  std::vector<uint8_t> encoded;
+  if (!fpng::fpng_encode_image_to_memory(bytes.data(), width, height, 3,
+                                         encoded)) {
+    // Fall back to libpng.
+    png_image png;
+    std::memset(&png, 0, sizeof(png));
+    png.version = PNG_IMAGE_VERSION;
+    png.width = width;
+    png.height = height;
+    png.format = PNG_FORMAT_RGB;
+    if (!png_image_write_to_file(&png, filename.c_str(), 0, bytes.data(), 0,
+                                 nullptr))
+      throw "[write_png_file] png_image_write_to_file failed";
+    return;
+  }
 
-  fclose(fp);
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if (!fp) throw "[write_png_file] File could not be opened for writing";
+  bool written = fwrite(encoded.data(), 1, encoded.size(), fp) == encoded.size();
+  if (fclose(fp) != 0 || !written)
+    throw "[write_png_file] Error during writing bytes";
 }
 
 Image loadImage(std::string filename) {
-  png_structp png_ptr;
-  png_infop info_ptr;
-  png_byte header[8];  // 8 is the maximum size that can be checked
-
-  /* open file and test for it being a png */
-  FILE* fp = fopen(filename.c_str(), "rb");
-  if (!fp) throw "[read_png_file] File could not be opened for reading";
-
-  if (fread(header, 1, 8, fp) != 8)
-    throw "[read_png_file] Could not read header";
-
-  if (png_sig_cmp(header, 0, 8))
+  platform::trace::Span span("decode image", filename);
+  initFpng();
+
+  std::vector<uint8_t> bytes;
+  uint32_t width, height, channels;
+  int status = fpng::fpng_decode_file(filename.c_str(), bytes, width, height,
+                                      channels, 3);
+
+  if (status == fpng::FPNG_DECODE_SUCCESS)
+    return {ImageSize{width, height}, fromBytes(bytes.data(), size_t(width) * height)};
+
+  if (status == fpng::FPNG_DECODE_FILE_OPEN_FAILED)
+    throw "[read_png_file] File could not be opened for reading";
+
+  // Not written by fpng, or beyond its limits on the image and file size;
+  // libpng converts any PNG to 8-bit RGB and rejects what is not one.
+  png_image png;
+  std::memset(&png, 0, sizeof(png));
+  png.version = PNG_IMAGE_VERSION;
+  if (!png_image_begin_read_from_file(&png, filename.c_str()))
     throw "[read_png_file] File is not recognized as a PNG file";
 
-  /* initialize stuff */
-  png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-
-  if (!png_ptr) throw "[read_png_file] png_create_read_struct failed";
-
-  info_ptr = png_create_info_struct(png_ptr);
-  if (!info_ptr) throw "[read_png_file] png_create_info_struct failed";
-
-  if (setjmp(png_jmpbuf(png_ptr))) throw "[read_png_file] Error during init_io";
-
-  png_init_io(png_ptr, fp);
-  png_set_sig_bytes(png_ptr, 8);
-
-  png_read_info(png_ptr, info_ptr);
-
-  size_t width = png_get_image_width(png_ptr, info_ptr);
-  size_t height = png_get_image_height(png_ptr, info_ptr);
-  png_byte color_type = png_get_color_type(png_ptr, info_ptr);
-  png_byte bit_depth = png_get_bit_depth(png_ptr, info_ptr);
-
-  if (color_type != PNG_COLOR_TYPE_RGB)
-    throw "[read_png_file] Not an RGB image";
-
-  if (bit_depth != 8)
-    throw "[read_png_file] Image is not 8-bit format";
-
-  size_t row_bytes = png_get_rowbytes(png_ptr, info_ptr);
-
-  if (row_bytes != 3 * width) throw "[read_png_file] Wrong number of row bytes";
-
-  std::vector<png_byte> rawData;
-  rawData.resize(3 * height * width);
-
-  png_bytep* row_pointers = new png_bytep[height];
-  for (size_t i = 0; i < height; ++i)
-    row_pointers[i] = rawData.data() + i * 3 * width;
-
-  png_read_image(png_ptr, row_pointers);
-  // std::cout << width << " " << height << " " << int(color_type) << " " <<
-  // int(bit_depth) << std::endl;
-  //  std::cout << png_get_rowbytes(png_ptr,info_ptr) << std::endl;
-  //  std::cout << rawData.size() << " " << width << " " << height << std::endl;
-
-  delete[] row_pointers;
-
-  color::ImageData data;
-  data.reserve(height * width);
-
-  for (size_t i = 0; i < height; ++i)
-    for (size_t j = 0; j < width; ++j) {
-      color::Intensity r =
-          static_cast<color::Intensity>(rawData[0 + 3 * (i * width + j)]) /
-          255.0;
-      color::Intensity g =
-          static_cast<color::Intensity>(rawData[1 + 3 * (i * width + j)]) /
-          255.0;
-      color::Intensity b =
-          static_cast<color::Intensity>(rawData[2 + 3 * (i * width + j)]) /
-          255.0;
-      data.push_back(color::RGB(r, g, b));
-    }
+  png.format = PNG_FORMAT_RGB;
+  bytes.resize(PNG_IMAGE_SIZE(png));
+  if (!png_image_finish_read(&png, nullptr, bytes.data(), 0, nullptr)) {
+    png_image_free(&png);
+    throw "[read_png_file] Error during reading bytes";
+  }
 
-  return {color::ImageSize{width, height}, data};
+  return {ImageSize{png.width, png.height},
+          fromBytes(bytes.data(), size_t(png.width) * png.height)};
 }
 
-}  // namespace color
\ No newline at end of file
+}  // namespace color
@@ -0,0 +1,258 @@
+#include <color/Framebuffer.h>
+#include <color/Half.h>
+#include <color/RowWriter.h>
+#include <platform/Cpu.h>
+#include <platform/Trace.h>
+#include <platform/parallel.h>
+#include <zlib.h>
+
+#include <cstring>
+
+// Writer for the scanline subset of the OpenEXR file format, following
+// "OpenEXR File Layout" (openexr.com). Multi-byte values are little-endian,
+// like the host.
+
+namespace color {
+
+template <typename T>
+static void put(std::vector<char>& out, T v) {
+  char bytes[sizeof(T)];
+  std::memcpy(bytes, &v, sizeof(T));
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+static void putString(std::vector<char>& out, char const* s) {
+  out.insert(out.end(), s, s + std::strlen(s) + 1);
+}
+
+static void putAttribute(std::vector<char>& out, char const* name,
+                         char const* type, std::vector<char> const& value) {
+  putString(out, name);
+  putString(out, type);
+  put(out, static_cast<int32_t>(value.size()));
+  out.insert(out.end(), value.begin(), value.end());
+}
+
+static size_t linesPerBlock(ExrCompression compression) {
+  return compression == ExrCompression::Zip ? 16 : 1;
+}
+
+// The ZIP codecs deflate the bytes after splitting them into even and odd
+// ones and delta-encoding the result. The delta runs backwards, so that each
+// byte reads its unmodified predecessor and the loop vectorizes.
+RAYTRACING_KERNEL void zipPredict(char const* raw, unsigned char* out,
+                                  size_t n) {
+  size_t half = (n + 1) / 2;
+  for (size_t i = 0; i < half; ++i)
+    out[i] = static_cast<unsigned char>(raw[2 * i]);
+  for (size_t i = 0; i < n / 2; ++i)
+    out[half + i] = static_cast<unsigned char>(raw[2 * i + 1]);
+
+  for (size_t i = n; i-- > 1;)
+    out[i] = static_cast<unsigned char>(out[i] - out[i - 1] + 128);
+}
+
+static std::vector<char> zipCompress(std::vector<char> const& raw) {
+  size_t n = raw.size();
+  std::vector<unsigned char> tmp(n);
+  platform::Multiversioned<zipPredict>::call(raw.data(), tmp.data(), n);
+
+  uLongf size = compressBound(static_cast<uLong>(n));
+  std::vector<char> out(size);
+  if (compress2(reinterpret_cast<Bytef*>(out.data()), &size, tmp.data(),
+                static_cast<uLong>(n), Z_DEFAULT_COMPRESSION) != Z_OK)
+    throw "[write_exr_file] compress2 failed";
+  out.resize(size);
+  return out;
+}
+
+// Lines [y0, y1) with the channels in alphabetical order, B, G, R.
+static std::vector<char> blockData(Framebuffer const& framebuffer, size_t y0,
+                                   size_t y1) {
+  size_t width = framebuffer.size().width;
+  bool half = framebuffer.storage() == Framebuffer::Half;
+
+  std::vector<char> data;
+  data.reserve((y1 - y0) * 3 * width * (half ? 2 : 4));
+  for (size_t y = y0; y < y1; ++y) {
+    for (size_t channel = 0; channel < 3; ++channel) {
+      for (size_t x = 0; x < width; ++x) {
+        RGB rgb = framebuffer.get(x, y);
+        float c = static_cast<float>(channel == 0   ? rgb.b
+                                     : channel == 1 ? rgb.g
+                                                    : rgb.r);
+        if (half)
+          put(data, floatToHalf(c));
+        else
+          put(data, c);
+      }
+    }
+  }
+  return data;
+}
+
+static std::vector<char> fileHeader(ImageSize size, int32_t pixelType,
+                                    ExrCompression compression) {
+  std::vector<char> header;
+  put(header, static_cast<int32_t>(20000630));  // magic number
+  put(header, static_cast<int32_t>(2));         // version 2, scanline
+
+  std::vector<char> channels;
+  for (char const* name : {"B", "G", "R"}) {
+    putString(channels, name);
+    put(channels, pixelType);
+    put(channels, static_cast<int32_t>(0));  // pLinear and reserved
+    put(channels, static_cast<int32_t>(1));  // x sampling
+    put(channels, static_cast<int32_t>(1));  // y sampling
+  }
+  channels.push_back(0);
+  putAttribute(header, "channels", "chlist", channels);
+
+  putAttribute(header, "compression", "compression",
+               {static_cast<char>(compression)});
+
+  std::vector<char> window;
+  put(window, static_cast<int32_t>(0));
+  put(window, static_cast<int32_t>(0));
+  put(window, static_cast<int32_t>(size.width - 1));
+  put(window, static_cast<int32_t>(size.height - 1));
+  putAttribute(header, "dataWindow", "box2i", window);
+  putAttribute(header, "displayWindow", "box2i", window);
+
+  putAttribute(header, "lineOrder", "lineOrder", {0});  // increasing y
+
+  std::vector<char> one;
+  put(one, 1.0f);
+  putAttribute(header, "pixelAspectRatio", "float", one);
+  std::vector<char> center;
+  put(center, 0.0f);
+  put(center, 0.0f);
+  putAttribute(header, "screenWindowCenter", "v2f", center);
+  putAttribute(header, "screenWindowWidth", "float", one);
+  header.push_back(0);
+  return header;
+}
+
+/**
+ * @brief Construct a new EXRRowWriter:: EXRRowWriter object
+ *
+ * @param filename
+ * @param size
+ * @param storage
+ * @param compression
+ */
+EXRRowWriter::EXRRowWriter(std::string const& filename, ImageSize size,
+                           Framebuffer::Storage storage,
+                           ExrCompression compression)
+    : m_file(fopen(filename.c_str(), "wb")),
+      m_size(size),
+      m_storage(storage),
+      m_compression(compression),
+      m_linesPerBlock(linesPerBlock(compression)),
+      m_row(0),
+      m_pendingRows(0) {
+  if (!m_file) throw "[write_exr_file] File could not be opened for writing";
+
+  // The destructor does not run if the constructor throws.
+  try {
+    std::vector<char> header = fileHeader(
+        size, storage == Framebuffer::Half ? 1 : 2, compression);
+    size_t blocks = (size.height + m_linesPerBlock - 1) / m_linesPerBlock;
+    m_tableOffset = header.size();
+    m_offset = m_tableOffset + blocks * sizeof(uint64_t);
+
+    // The offset table is written as zeros and filled in by finish().
+    header.resize(m_offset, 0);
+    if (fwrite(header.data(), 1, header.size(), m_file) != header.size())
+      throw "[write_exr_file] Error during writing header";
+
+    m_pending = std::make_unique<Framebuffer>(
+        ImageSize{size.width, m_linesPerBlock}, storage);
+  } catch (...) {
+    fclose(m_file);
+    throw;
+  }
+}
+
+EXRRowWriter::~EXRRowWriter() {
+  if (m_file) fclose(m_file);
+}
+
+void EXRRowWriter::writeBlocks(Framebuffer const& rows, size_t first,
+                               size_t blocks, size_t lines) {
+  std::vector<std::vector<char>> data(blocks);
+  platform::parallelFor(blocks, 0, [&](size_t b) {
+    size_t y0 = first + b * lines;
+    std::vector<char> raw = blockData(rows, y0, y0 + lines);
+    if (m_compression != ExrCompression::None) {
+      // Blocks that do not shrink are stored uncompressed.
+      std::vector<char> zipped = zipCompress(raw);
+      if (zipped.size() < raw.size()) raw = std::move(zipped);
+    }
+    data[b] = std::move(raw);
+  });
+
+  for (auto const& block : data) {
+    std::vector<char> prefix;
+    put(prefix, static_cast<int32_t>(m_row));
+    put(prefix, static_cast<int32_t>(block.size()));
+    if (fwrite(prefix.data(), 1, prefix.size(), m_file) != prefix.size() ||
+        fwrite(block.data(), 1, block.size(), m_file) != block.size())
+      throw "[write_exr_file] Error during writing bytes";
+
+    m_offsets.push_back(m_offset);
+    m_offset += prefix.size() + block.size();
+    m_row += lines;
+  }
+}
+
+void EXRRowWriter::write(Framebuffer const& rows) {
+  size_t n = rows.size().height;
+  if (m_row + m_pendingRows + n > m_size.height)
+    throw "[write_exr_file] Too many rows";
+
+  auto keep = [&](size_t y) {
+    for (size_t x = 0; x < m_size.width; ++x)
+      m_pending->set(x, m_pendingRows, rows.get(x, y));
+    if (++m_pendingRows == m_linesPerBlock) {
+      writeBlocks(*m_pending, 0, 1, m_linesPerBlock);
+      m_pendingRows = 0;
+    }
+  };
+
+  // Complete a started block, write whole blocks directly from rows, and
+  // keep the remaining lines for the next call.
+  size_t y = 0;
+  while (m_pendingRows > 0 && y < n) keep(y++);
+  size_t blocks = (n - y) / m_linesPerBlock;
+  writeBlocks(rows, y, blocks, m_linesPerBlock);
+  y += blocks * m_linesPerBlock;
+  while (y < n) keep(y++);
+}
+
+void EXRRowWriter::finish() {
+  // The last block may hold fewer lines.
+  if (m_pendingRows > 0) writeBlocks(*m_pending, 0, 1, m_pendingRows);
+  if (m_row != m_size.height) throw "[write_exr_file] Missing rows";
+
+  std::vector<char> table;
+  for (uint64_t offset : m_offsets) put(table, offset);
+  if (fseek(m_file, static_cast<long>(m_tableOffset), SEEK_SET) != 0 ||
+      fwrite(table.data(), 1, table.size(), m_file) != table.size())
+    throw "[write_exr_file] Error during writing offsets";
+
+  int status = fclose(m_file);
+  m_file = nullptr;
+  if (status != 0) throw "[write_exr_file] Error during end of write";
+}
+
+void saveEXR(std::string filename, Framebuffer const& framebuffer,
+             ExrCompression compression) {
+  platform::trace::Span span("encode EXR", filename);
+  EXRRowWriter writer(filename, framebuffer.size(), framebuffer.storage(),
+                      compression);
+  writer.write(framebuffer);
+  writer.finish();
+}
+
+}  // namespace color
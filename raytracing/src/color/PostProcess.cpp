@@ -0,0 +1,135 @@
+#include <color/PostProcess.h>
+#include <platform/Cpu.h>
+#include <platform/parallel.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace color {
+
+static const size_t RowsPerTask = 16;
+
+/**
+ * @brief x^(1/gamma) on [0, 1], piecewise linear over 16 segments per octave
+ * from 2^-24 up. The segment is found from the float's exponent and leading
+ * mantissa bits; the relative error is below 1e-4.
+ */
+class GammaCurve {
+ public:
+  explicit GammaCurve(float gamma) {
+    for (uint32_t i = 0; i < Segments; ++i) {
+      double x0 = fromBits(MinBits + (i << SegmentShift));
+      double x1 = fromBits(MinBits + ((i + 1) << SegmentShift));
+      double y0 = std::pow(x0, 1.0 / gamma);
+      double y1 = std::pow(x1, 1.0 / gamma);
+      double slope = (y1 - y0) / (x1 - x0);
+      m_slope[i] = static_cast<float>(slope);
+      m_offset[i] = static_cast<float>(y0 - slope * x0);
+    }
+  }
+
+  float operator()(float x) const {
+    if (!(x > MinValue)) return 0.0f;
+    if (x >= 1.0f) return 1.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &x, sizeof(bits));
+    uint32_t i = (bits - MinBits) >> SegmentShift;
+    return m_offset[i] + m_slope[i] * x;
+  }
+
+ private:
+  static constexpr uint32_t Octaves = 24;
+  static constexpr uint32_t SegmentShift = 23 - 4;
+  static constexpr uint32_t Segments = Octaves << 4;
+  static constexpr uint32_t MinBits = (127u - Octaves) << 23;
+  static constexpr float MinValue = 1.0f / float(1u << Octaves);
+
+  static float fromBits(uint32_t bits) {
+    float x;
+    std::memcpy(&x, &bits, sizeof(x));
+    return x;
+  }
+
+  float m_slope[Segments];
+  float m_offset[Segments];
+};
+
+// Two uniform variates from a hash of the sample index give triangular noise
+// in (-1, 1).
+static float triangularNoise(uint32_t i) {
+  i ^= i >> 16;
+  i *= 0x7feb352du;
+  i ^= i >> 15;
+  i *= 0x846ca68bu;
+  i ^= i >> 16;
+  float u1 = static_cast<float>(i & 0xffffu) * (1.0f / 65536.0f);
+  float u2 = static_cast<float>(i >> 16) * (1.0f / 65536.0f);
+  return u1 + u2 - 1.0f;
+}
+
+// The stages are separate loops over a row of floats so that each one
+// vectorizes, for the instruction set level of the CPU.
+RAYTRACING_KERNEL void processRow(float* c, size_t n, uint8_t* out,
+                                  uint32_t first,
+                                  PostProcessSettings const& settings,
+                                  GammaCurve const* gamma) {
+  float exposure = settings.exposure;
+  for (size_t i = 0; i < n; ++i) c[i] = std::max(c[i] * exposure, 0.0f);
+
+  switch (settings.toneMap) {
+    case PostProcessSettings::Reinhard:
+      for (size_t i = 0; i < n; ++i) c[i] = c[i] / (1.0f + c[i]);
+      break;
+    case PostProcessSettings::ACES:
+      // Narkowicz's fit of the ACES filmic curve.
+      for (size_t i = 0; i < n; ++i)
+        c[i] = (c[i] * (2.51f * c[i] + 0.03f)) /
+               (c[i] * (2.43f * c[i] + 0.59f) + 0.14f);
+      break;
+    default:
+      break;
+  }
+  for (size_t i = 0; i < n; ++i) c[i] = std::min(c[i], 1.0f);
+
+  if (gamma)
+    for (size_t i = 0; i < n; ++i) c[i] = (*gamma)(c[i]);
+
+  if (settings.dither) {
+    for (size_t i = 0; i < n; ++i)
+      c[i] = c[i] * 255.0f + triangularNoise(first + static_cast<uint32_t>(i));
+  } else {
+    for (size_t i = 0; i < n; ++i) c[i] = c[i] * 255.0f;
+  }
+
+  for (size_t i = 0; i < n; ++i)
+    out[i] =
+        static_cast<uint8_t>(std::min(std::max(c[i] + 0.5f, 0.0f), 255.0f));
+}
+
+std::vector<uint8_t> postProcess(Framebuffer const& framebuffer,
+                                 PostProcessSettings const& settings,
+                                 size_t firstRow) {
+  ImageSize size = framebuffer.size();
+  size_t n = 3 * size.width;
+  std::vector<uint8_t> out(n * size.height);
+
+  std::unique_ptr<GammaCurve> gamma;
+  if (settings.gamma != 1.0f)
+    gamma = std::make_unique<GammaCurve>(settings.gamma);
+
+  size_t tasks = (size.height + RowsPerTask - 1) / RowsPerTask;
+  platform::parallelFor(tasks, settings.threads, [&](size_t task) {
+    std::vector<float> row(n);
+    size_t end = std::min(size.height, (task + 1) * RowsPerTask);
+    for (size_t y = task * RowsPerTask; y < end; ++y) {
+      framebuffer.row(y, row.data());
+      platform::Multiversioned<processRow>::call(
+          row.data(), n, out.data() + y * n,
+          static_cast<uint32_t>((firstRow + y) * n), settings, gamma.get());
+    }
+  });
+  return out;
+}
+
+}  // namespace color
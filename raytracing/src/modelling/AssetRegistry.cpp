@@ -0,0 +1,120 @@
+#include <modelling/AssetRegistry.h>
+
+#include <filesystem>
+#include <fstream>
+
+namespace modelling {
+
+enum AssetKind { TextureAsset = 1, NormalMapAsset = 2 };
+
+/**
+ * @brief Construct a new Asset Registry:: Asset Registry object
+ *
+ * @param threads
+ * @param cache
+ */
+AssetRegistry::AssetRegistry(size_t threads,
+                             std::shared_ptr<TextureCache const> cache)
+    : m_cache(std::move(cache)), m_pool(threads) {}
+
+// Size and modification time of filename, so that a path is only looked up
+// again as long as the file is unchanged.
+static std::pair<uint64_t, int64_t> fileStamp(std::string const& filename) {
+  std::error_code error;
+  uint64_t size = std::filesystem::file_size(filename, error);
+  if (error) throw "Cannot open image";
+  auto time = std::filesystem::last_write_time(filename, error);
+  if (error) throw "Cannot open image";
+  return {size, int64_t(time.time_since_epoch().count())};
+}
+
+// FNV-1a over 64-bit words of the file contents, and the bytes of the tail.
+// Reading the whole file is not free, so it runs without holding the lock.
+uint64_t AssetRegistry::contentHash(std::string const& filename) {
+  std::ifstream in(filename, std::ios::binary);
+  if (!in) throw "Cannot open image";
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  uint64_t buffer[1 << 13];
+  while (in) {
+    in.read(reinterpret_cast<char*>(buffer), sizeof(buffer));
+    size_t bytes = size_t(in.gcount());
+    for (size_t i = 0; i < bytes / 8; ++i) {
+      hash ^= buffer[i];
+      hash *= 0x100000001b3ull;
+    }
+    unsigned char const* tail =
+        reinterpret_cast<unsigned char const*>(buffer) + bytes / 8 * 8;
+    for (size_t i = 0; i < bytes % 8; ++i) {
+      hash ^= tail[i];
+      hash *= 0x100000001b3ull;
+    }
+  }
+  return hash;
+}
+
+template <typename T, typename Make>
+std::shared_ptr<T> AssetRegistry::find(int kind, int interpolation,
+                                       int format, std::string const& filename,
+                                       Make make) {
+  auto [size, time] = fileStamp(filename);
+  PathKey pathKey{kind, interpolation, format, filename, size, time};
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto byPath = m_byPath.find(pathKey);
+    if (byPath != m_byPath.end())
+      return std::static_pointer_cast<T>(byPath->second);
+  }
+
+  ContentKey contentKey{kind, interpolation, format, contentHash(filename)};
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  // Another thread may have added the path while this one was hashing.
+  auto byPath = m_byPath.find(pathKey);
+  if (byPath != m_byPath.end())
+    return std::static_pointer_cast<T>(byPath->second);
+  auto byContent = m_byContent.find(contentKey);
+  if (byContent != m_byContent.end()) {
+    m_byPath.emplace(pathKey, byContent->second);
+    return std::static_pointer_cast<T>(byContent->second);
+  }
+
+  std::shared_ptr<T> asset = make();
+  m_byPath.emplace(pathKey, asset);
+  m_byContent.emplace(contentKey, asset);
+  return asset;
+}
+
+std::shared_ptr<Texture> AssetRegistry::texture(
+    std::string const& filename, Texture::Interpolation interpolation,
+    Texture::Format format) {
+  return find<Texture>(TextureAsset, interpolation, format, filename, [&]() {
+    auto texture = std::make_shared<Texture>(m_pool, filename, interpolation,
+                                             format, m_cache);
+    m_textures.push_back(texture);
+    return texture;
+  });
+}
+
+std::shared_ptr<NormalMap> AssetRegistry::normalMap(
+    std::string const& filename, NormalMap::Interpolation interpolation) {
+  return find<NormalMap>(NormalMapAsset, interpolation, 0, filename, [&]() {
+    auto normalMap =
+        std::make_shared<NormalMap>(m_pool, filename, interpolation, m_cache);
+    m_normalMaps.push_back(normalMap);
+    return normalMap;
+  });
+}
+
+void AssetRegistry::wait() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  for (auto const& texture : m_textures) texture->wait();
+  for (auto const& normalMap : m_normalMaps) normalMap->wait();
+}
+
+size_t AssetRegistry::size() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_textures.size() + m_normalMaps.size();
+}
+
+}  // namespace modelling
@@ -11,4 +11,24 @@ geometry::Ray Camera::getRay(geometry::Coord x, geometry::Coord y) const {
   return geometry::Ray{p, p-m_eye};
 }
 
+geometry::RayDifferential Camera::getRayDifferential(geometry::Coord x,
+                                                     geometry::Coord y,
+                                                     geometry::Coord dx,
+                                                     geometry::Coord dy) const {
+  geometry::Point3D p = m_vrp + x*m_u + y*m_v;
+  geometry::Vector3D d = p - m_eye;
+  geometry::Coord length = d.length();
+  geometry::Vector3D dir = d / length;
+
+  // Derivative of the normalized direction: the part of the step orthogonal
+  // to the ray, scaled by the distance to the eye.
+  auto dDir = [&](geometry::Vector3D const& step) {
+    return (step - dir * (dir * step)) / length;
+  };
+
+  geometry::Vector3D stepX = m_u * dx;
+  geometry::Vector3D stepY = m_v * dy;
+  return {stepX, stepY, dDir(stepX), dDir(stepY)};
+}
+
 }  // namespace modelling
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include <modelling/Emitter.h>
+#include <modelling/Random.h>
 
+#include <algorithm>
 #include <cmath>
 
 namespace modelling {
@@ -19,10 +21,24 @@ Emission PositionalLight::emission(geometry::Point3D const& x,
   return {(m_color) / (((x - m_pos) * (x - m_pos)) / cost), m_pos, {x, L}};
 }
 
+// Uniformly distributed direction on the unit sphere.
+static geometry::Normal3D uniformDirection(double u, double v) {
+  geometry::Coord z = 1.0 - 2.0 * u;
+  geometry::Coord r = std::sqrt(std::max(0.0, 1.0 - z * z));
+  geometry::Coord phi = 2.0 * M_PI * v;
+  return {r * std::cos(phi), r * std::sin(phi), z};
+}
+
+color::SColor PositionalLight::power() const { return m_color * (4.0 * M_PI); }
+
+PhotonEmission PositionalLight::emitPhoton(double u1, double u2,
+                                           double) const {
+  return {{m_pos, uniformDirection(u1, u2)}, power()};
+}
+
 SphereLight::SphereLight(geometry::Point3D pos, geometry::Coord radius,
                          color::SColor color)
     : m_positions(generatePositions(pos, radius)),
-      m_pos_it(m_positions.begin()),
       m_color(std::move(color)) {}
 
 Emission SphereLight::emission(geometry::Point3D const& x,
@@ -36,10 +52,20 @@ Emission SphereLight::emission(geometry::Point3D const& x,
   return {m_color / (((x - pos) * (x - pos)) / cost), pos, {x, L}};
 }
 
+color::SColor SphereLight::power() const { return m_color * (4.0 * M_PI); }
+
+PhotonEmission SphereLight::emitPhoton(double u1, double u2, double u3) const {
+  auto i = std::min(static_cast<size_t>(u3 * double(m_positions.size())),
+                    m_positions.size() - 1);
+  return {{m_positions[i], uniformDirection(u1, u2)}, power()};
+}
+
 geometry::Point3D const& SphereLight::randomPoint() {
-  geometry::Point3D const& ret = *m_pos_it;
-  if (++m_pos_it == m_positions.end()) m_pos_it = m_positions.begin();
-  return ret;
+  // Drawn from the thread's stream rather than cycled through a shared
+  // counter, so that the point does not depend on the thread schedule.
+  size_t i = static_cast<size_t>(threadRandom().uniform() *
+                                 static_cast<double>(m_positions.size()));
+  return m_positions[std::min(i, m_positions.size() - 1)];
 }
 
 SphereLight::Positions SphereLight::generatePositions(geometry::Point3D pos,
@@ -1,11 +1,14 @@
+#include <geometry/FastMath.h>
 #include <modelling/Material.h>
+#include <modelling/Random.h>
 
 #include <algorithm>
 #include <cmath>
-#include <random>
 
 namespace modelling {
 
+DirectionalDistribution::~DirectionalDistribution() = default;
+
 Material::~Material() = default;
 
 color::SColor Material::transparency() const {
@@ -14,6 +17,168 @@ color::SColor Material::transparency() const {
 
 bool Material::requiresUV() const { return false; }
 
+color::Intensity Material::diffuseWeight() const { return 0.0; }
+
+color::SColor Material::diffuseColor(geometry::TexCoord const &) const {
+  return color::SColor(0.0);
+}
+
+Reflection Material::reflection(geometry::Normal3D const &N,
+                                geometry::Normal3D const &V,
+                                geometry::TexCoord const &uv,
+                                DirectionalDistribution const &,
+                                color::Intensity) const {
+  return reflection(N, V, uv);
+}
+
+static double uniform() { return threadRandom().uniform(); }
+
+static Reflection noReflection() {
+  return {0.0, geometry::Vector3D{0.0, 0.0, 0.0},
+          color::SColor({0.0, 0.0, 0.0})};
+}
+
+static geometry::Vector3D sampleCosine(geometry::Normal3D const &N,
+                                       double &prob) {
+  double u = uniform();
+  double v = uniform();
+
+  // theta = asin(sqrt(u))
+  double sinTheta = std::sqrt(u);
+  double cosTheta = std::sqrt(1.0 - u);
+  double sinPhi, cosPhi;
+  geometry::math::sinCos(M_PI * 2.0 * v, sinPhi, cosPhi);
+
+  geometry::Vector3D O = N % geometry::Vector3D{0, 0, 1};
+  if (O.length() < 1e-2) O = N % geometry::Vector3D{0, 1, 0};
+  geometry::Vector3D P = N % O;
+
+  prob = cosTheta / M_PI;
+
+  return N * cosTheta + O * sinTheta * cosPhi + P * sinTheta * sinPhi;
+}
+
+// One-sample mixture of the cosine lobe and the guiding distribution. The
+// returned prob keeps the expected value of the plain cosine-sampled estimator:
+// it is scaled by pCos / pdf, where pdf is the density of the mixture.
+static geometry::Vector3D sampleGuided(geometry::Normal3D const &N,
+                                       DirectionalDistribution const &guide,
+                                       double bsdfFraction, double &prob,
+                                       double &pdf) {
+  geometry::Normal3D L{0.0, 0.0, 0.0};
+  if (uniform() < bsdfFraction) {
+    L = sampleCosine(N, prob);
+  } else {
+    double u = uniform();
+    double v = uniform();
+    L = guide.sample(u, v);
+  }
+
+  double pCos = std::max(0.0, N * L) / M_PI;
+  pdf = bsdfFraction * pCos + (1.0 - bsdfFraction) * guide.pdf(L);
+  prob = pdf > 0.0 ? pCos * pCos / pdf : 0.0;
+  return L;
+}
+
+// Factor of the normalized Phong spectrum in the BRDF.
+static color::Intensity phongFactor(color::Intensity shine,
+                                    geometry::Normal3D const &L,
+                                    geometry::Normal3D const &N,
+                                    geometry::Normal3D const &V) {
+  geometry::Coord cos_in = L * N;
+
+  if (cos_in > 1e-2) {
+    geometry::Vector3D R = N * (2.0 * cos_in) - L;
+    geometry::Coord cos_refl_out = R * V;
+    if (cos_refl_out > 1e-2) return geometry::math::pow(cos_refl_out, shine);
+  }
+
+  return 0.0;
+}
+
+static color::SColor phongBRDF(color::SColor const &normalizedSpectrum,
+                               color::Intensity shine,
+                               geometry::Normal3D const &L,
+                               geometry::Normal3D const &N,
+                               geometry::Normal3D const &V) {
+  return normalizedSpectrum * phongFactor(shine, L, N, V);
+}
+
+// Direction of the Phong lobe around the mirror direction of V, and its
+// probability; false if the sample is rejected.
+static bool samplePhongDirection(color::Intensity shine,
+                                 geometry::Normal3D const &N,
+                                 geometry::Normal3D const &V,
+                                 geometry::Normal3D &L, double &prob) {
+  double u = uniform();
+  double v = uniform();
+
+  geometry::Coord cos_ang_V_R = geometry::math::pow(u, 1.0 / (shine + 1));
+
+  // cos_ang_V_R^shine = u / cos_ang_V_R
+  prob = cos_ang_V_R > 0.0 ? (shine + 1) / 2 / M_PI * u / cos_ang_V_R : 0.0;
+
+  if (prob < 1e-2) return false;
+
+  geometry::Coord sin_ang_V_R = std::sqrt(1.0 - cos_ang_V_R * cos_ang_V_R);
+
+  geometry::Vector3D O = V % geometry::Vector3D{0, 0, 1};
+  if (O.length() < 1e-2) O = V % geometry::Vector3D{0, 1, 0};
+  geometry::Vector3D P = O % V;
+
+  double sinPhi, cosPhi;
+  geometry::math::sinCos(2.0 * M_PI * v, sinPhi, cosPhi);
+  geometry::Vector3D R = O * sin_ang_V_R * cosPhi + P * sin_ang_V_R * sinPhi +
+                         V * cos_ang_V_R;
+
+  L = N * (N * R) * 2.0 - R;
+  return N * L >= 0;
+}
+
+static Reflection samplePhong(color::SColor const &normalizedSpectrum,
+                              color::Intensity shine,
+                              geometry::Normal3D const &N,
+                              geometry::Normal3D const &V) {
+  geometry::Normal3D L{0.0, 0.0, 1.0};
+  double prob;
+  if (!samplePhongDirection(shine, N, V, L, prob)) return noReflection();
+  return {prob, L, phongBRDF(normalizedSpectrum, shine, L, N, V)};
+}
+
+static Reflection reflectIdeal(color::SColor const &kr,
+                               geometry::Normal3D const &N,
+                               geometry::Normal3D const &V) {
+  geometry::Vector3D L = N * (N * V) * 2 - V;
+  geometry::Coord cost = N * L;
+  color::SColor brdf = cost > 1e-2 ? kr / cost : color::SColor(0);
+  return {1.0, L, brdf, 0.0, true};
+}
+
+static Reflection refractIdeal(color::SColor const &kt, color::Intensity n,
+                               geometry::Normal3D const &N,
+                               geometry::Normal3D const &V) {
+  geometry::Coord cosa = N * V;
+  color::Intensity cn = (cosa > 0.0) ? n : 1.0 / n;
+  geometry::Normal3D norm = (cosa < 0.0) ? -N : N;
+
+  if (cosa < 0) cosa = -cosa;
+
+  color::Intensity disc = 1.0 - (1.0 - cosa * cosa) / cn / cn;
+  if (disc < 0.0) return noReflection();
+
+  geometry::Normal3D L = norm * (cosa / cn - std::sqrt(disc)) - V / cn;
+
+  geometry::Coord cost = -(norm * L);
+  color::SColor brdf = cost > 1e-8 ? kt / cost : color::SColor({0, 0, 0});
+
+  return {1.0, L, brdf, 0.0, true};
+}
+
+static color::SColor phongNormalization(color::SColor const &spectrum,
+                                        color::Intensity shine) {
+  return spectrum * (shine + 2) / M_PI / 2.0;
+}
+
 /**
  * @brief Construct a new Diffuse Material:: Diffuse Material object
  *
@@ -26,7 +191,7 @@ DiffuseMaterial::DiffuseMaterial(color::SColor spectrum,
 color::SColor DiffuseMaterial::BRDF(geometry::Normal3D const &,
                                     geometry::Normal3D const &,
                                     geometry::Normal3D const &,
-                                    geometry::Point2D const &uv) const {
+                                    geometry::TexCoord const &uv) const {
   if (m_texture != nullptr) return m_spectrum * m_texture->get(uv);
   return m_spectrum;
 }
@@ -37,34 +202,32 @@ color::Intensity DiffuseMaterial::averageAlbedo() const {
 
 Reflection DiffuseMaterial::reflection(geometry::Normal3D const &N,
                                        geometry::Normal3D const &V,
-                                       geometry::Point2D const &uv) const {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::uniform_real_distribution<geometry::Coord> dist(0.0, 1.0);
-
-  double u = dist(gen);
-  double v = dist(gen);
-
-  double theta = std::asin(std::sqrt(u));
-  double phi = M_PI * 2.0 * v;
-
-  // std::cout << u << " " << theta << " " << phi << std::endl;
+                                       geometry::TexCoord const &uv) const {
+  double prob;
+  geometry::Normal3D L = sampleCosine(N, prob);
+  return {prob, L, BRDF(L, N, V, uv), prob};
+}
 
-  geometry::Vector3D O = N % geometry::Vector3D{0, 0, 1};
-  if (O.length() < 1e-2) O = N % geometry::Vector3D{0, 1, 0};
-  geometry::Vector3D P = N % O;
+Reflection DiffuseMaterial::reflection(geometry::Normal3D const &N,
+                                       geometry::Normal3D const &V,
+                                       geometry::TexCoord const &uv,
+                                       DirectionalDistribution const &guide,
+                                       color::Intensity bsdfFraction) const {
+  Reflection r = noReflection();
+  r.dir = sampleGuided(N, guide, bsdfFraction, r.prob, r.pdf);
+  r.color = BRDF(r.dir, N, V, uv);
+  return r;
+}
 
-  geometry::Vector3D L = N * std::cos(theta) +
-                         O * std::sin(theta) * std::cos(phi) +
-                         P * std::sin(theta) * std::sin(phi);
+bool DiffuseMaterial::requiresUV() const { return m_texture != nullptr; }
 
-  double prob = std::cos(theta) / M_PI;
+color::Intensity DiffuseMaterial::diffuseWeight() const { return 1.0; }
 
-  return {prob, L, BRDF(L, N, V, uv)};
+color::SColor DiffuseMaterial::diffuseColor(geometry::TexCoord const &uv) const {
+  if (m_texture != nullptr) return m_spectrum * m_texture->get(uv);
+  return m_spectrum;
 }
 
-bool DiffuseMaterial::requiresUV() const { return m_texture != nullptr; }
-
 SpecularMaterial::SpecularMaterial(color::SColor spectrum,
                                    color::Intensity shine)
     : m_spectrum(std::move(spectrum)), m_shine(shine) {}
@@ -72,19 +235,9 @@ SpecularMaterial::SpecularMaterial(color::SColor spectrum,
 color::SColor SpecularMaterial::BRDF(geometry::Normal3D const &L,
                                      geometry::Normal3D const &N,
                                      geometry::Normal3D const &V,
-                                     geometry::Point2D const &) const {
-  geometry::Coord cos_in = L * N;
-
-  if (cos_in > 1e-2 && m_spectrum.luminance() != 0) {
-    geometry::Vector3D R = N * (2.0 * cos_in) - L;
-    geometry::Coord cos_refl_out = R * V;
-    if (cos_refl_out > 1e-2) {
-      color::SColor ref = m_spectrum * (m_shine + 2) / M_PI / 2.0;
-      return ref * std::pow(cos_refl_out, m_shine);
-    }
-  }
-
-  return color::SColor(0);
+                                     geometry::TexCoord const &) const {
+  if (m_spectrum.luminance() == 0) return color::SColor(0);
+  return phongBRDF(phongNormalization(m_spectrum, m_shine), m_shine, L, N, V);
 }
 
 color::Intensity SpecularMaterial::averageAlbedo() const {
@@ -93,39 +246,8 @@ color::Intensity SpecularMaterial::averageAlbedo() const {
 
 Reflection SpecularMaterial::reflection(geometry::Normal3D const &N,
                                         geometry::Normal3D const &V,
-                                        geometry::Point2D const &uv) const {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::uniform_real_distribution<geometry::Coord> dist(0.0, 1.0);
-
-  double u = dist(gen);
-  double v = dist(gen);
-
-  geometry::Coord cos_ang_V_R = std::pow(u, 1.0 / (m_shine + 1));
-
-  double prob = (m_shine + 1) / 2 / M_PI * std::pow(cos_ang_V_R, m_shine);
-
-  if (prob < 1e-2)
-    return {0.0, geometry::Vector3D{0.0, 0.0, 0.0},
-            color::SColor({0.0, 0.0, 0.0})};
-
-  geometry::Coord sin_ang_V_R = std::sqrt(1.0 - cos_ang_V_R * cos_ang_V_R);
-
-  geometry::Vector3D O = V % geometry::Vector3D{0, 0, 1};
-  if (O.length() < 1e-2) O = V % geometry::Vector3D{0, 1, 0};
-  geometry::Vector3D P = O % V;
-
-  geometry::Vector3D R = O * sin_ang_V_R * std::cos(2.0 * M_PI * v) +
-                         P * sin_ang_V_R * std::sin(2.0 * M_PI * v) +
-                         V * cos_ang_V_R;
-
-  geometry::Normal3D L = N * (N * R) * 2.0 - R;
-
-  if (N * L < 0)
-    return {0.0, geometry::Vector3D{0.0, 0.0, 0.0},
-            color::SColor({0.0, 0.0, 0.0})};
-
-  return {prob, L, BRDF(L, N, V, uv)};
+                                        geometry::TexCoord const &) const {
+  return samplePhong(phongNormalization(m_spectrum, m_shine), m_shine, N, V);
 }
 
 /**
@@ -141,17 +263,14 @@ color::SColor const &IdealReflector::kr() const { return m_Kr; }
 
 Reflection IdealReflector::reflection(geometry::Normal3D const &N,
                                       geometry::Normal3D const &V,
-                                      geometry::Point2D const &) const {
-  geometry::Vector3D L = N * (N * V) * 2 - V;
-  geometry::Coord cost = N * L;
-  color::SColor brdf = cost > 1e-2 ? m_Kr / cost : color::SColor(0);
-  return {1.0, L, brdf};
+                                      geometry::TexCoord const &) const {
+  return reflectIdeal(m_Kr, N, V);
 }
 
 color::SColor IdealReflector::BRDF(geometry::Normal3D const &,
                                    geometry::Normal3D const &,
                                    geometry::Normal3D const &,
-                                   geometry::Point2D const &) const {
+                                   geometry::TexCoord const &) const {
   return color::SColor(0.0);
 }
 
@@ -170,30 +289,14 @@ color::SColor const &IdealRefractor::kt() const { return m_Kt; }
 
 Reflection IdealRefractor::reflection(geometry::Normal3D const &N,
                                       geometry::Normal3D const &V,
-                                      geometry::Point2D const &) const {
-  geometry::Coord cosa = N * V;
-  color::Intensity cn = (cosa > 0.0) ? m_N : 1.0 / m_N;
-  geometry::Normal3D norm = (cosa < 0.0) ? -N : N;
-
-  if (cosa < 0) cosa = -cosa;
-
-  color::Intensity disc = 1.0 - (1.0 - cosa * cosa) / cn / cn;
-  if (disc < 0.0)
-    return {0.0, geometry::Vector3D{0.0, 0.0, 0.0},
-            color::SColor({0.0, 0.0, 0.0})};
-
-  geometry::Normal3D L = norm * (cosa / cn - std::sqrt(disc)) - V / cn;
-
-  geometry::Coord cost = -(norm * L);
-  color::SColor brdf = cost > 1e-8 ? m_Kt / cost : color::SColor({0, 0, 0});
-
-  return {1.0, L, brdf};
+                                      geometry::TexCoord const &) const {
+  return refractIdeal(m_Kt, m_N, N, V);
 }
 
 color::SColor IdealRefractor::BRDF(geometry::Normal3D const &,
                                    geometry::Normal3D const &,
                                    geometry::Normal3D const &,
-                                   geometry::Point2D const &) const {
+                                   geometry::TexCoord const &) const {
   return color::SColor(0.0);
 }
 
@@ -202,6 +305,10 @@ color::SColor IdealRefractor::transparency() const { return m_Kt; }
 /**
  * @brief Construct a new General Material:: General Material object
  *
+ * The material is compiled into a flat list of its non-zero lobes together
+ * with the cumulative selection probabilities, so shading only has to draw
+ * one random number and evaluate the selected lobe.
+ *
  * @param diffuseColor
  * @param kr
  */
@@ -210,75 +317,141 @@ GeneralMaterial::GeneralMaterial(color::SColor diffuseColor,
                                  color::Intensity shine, color::SColor kr,
                                  color::SColor kt, color::Intensity N,
                                  std::shared_ptr<Texture> texture)
-    : DiffuseMaterial(std::move(diffuseColor), std::move(texture)),
-      SpecularMaterial(std::move(specularColor), shine),
-      IdealReflector(std::move(kr)),
-      IdealRefractor(std::move(kt), N) {}
+    : m_nLobes(0), m_texture(std::move(texture)), m_transparency(0.0) {
+  addLobe(Lobe::Diffuse, diffuseColor, 0.0,
+          DiffuseMaterial(diffuseColor).averageAlbedo());
+  addLobe(Lobe::Specular, phongNormalization(specularColor, shine), shine,
+          SpecularMaterial(specularColor, shine).averageAlbedo());
+  addLobe(Lobe::Reflector, kr, 0.0, kr.luminance());
+  addLobe(Lobe::Refractor, kt, N, kt.luminance());
+
+  color::Intensity sum = 0.0;
+  for (size_t i = 0; i < m_nLobes; ++i) sum += m_lobes[i].weight;
+
+  color::Intensity cdf = 0.0;
+  for (size_t i = 0; i < m_nLobes; ++i) {
+    m_lobes[i].weight /= sum;
+    cdf += m_lobes[i].weight;
+    m_lobes[i].cdf = cdf;
+    if (m_lobes[i].type == Lobe::Refractor)
+      m_transparency = m_lobes[i].spectrum * m_lobes[i].weight;
+  }
+  if (m_nLobes > 0) m_lobes[m_nLobes - 1].cdf = 1.0;
+}
+
+void GeneralMaterial::addLobe(Lobe::Type type, color::SColor spectrum,
+                              color::Intensity param,
+                              color::Intensity weight) {
+  if (weight <= 0.0) return;
+  m_lobes[m_nLobes++] = Lobe{type, std::move(spectrum), param, weight, 0.0};
+}
 
 color::SColor GeneralMaterial::BRDF(geometry::Normal3D const &L,
                                     geometry::Normal3D const &N,
                                     geometry::Normal3D const &V,
-                                    geometry::Point2D const &uv) const {
-  return DiffuseMaterial::BRDF(L, N, V, uv) +
-         SpecularMaterial::BRDF(L, N, V, uv);
+                                    geometry::TexCoord const &uv) const {
+  color::SColor brdf(0.0);
+  for (size_t i = 0; i < m_nLobes; ++i) {
+    Lobe const &lobe = m_lobes[i];
+    switch (lobe.type) {
+      case Lobe::Diffuse:
+        if (m_texture != nullptr) {
+          color::SColor texel = m_texture->get(uv);
+          texel *= lobe.spectrum;
+          brdf += texel;
+        } else {
+          brdf += lobe.spectrum;
+        }
+        break;
+      case Lobe::Specular: {
+        // In place: spectra are heap-backed, temporaries are not free.
+        color::Intensity f = phongFactor(lobe.param, L, N, V);
+        if (f == 0.0) break;
+        color::Intensities &out = brdf.intensities();
+        color::Intensities const &in = lobe.spectrum.intensities();
+        for (size_t k = 0; k < out.size(); ++k) out[k] += in[k] * f;
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  return brdf;
 }
 
 Reflection GeneralMaterial::reflection(geometry::Normal3D const &N,
                                        geometry::Normal3D const &V,
-                                       geometry::Point2D const &uv) const {
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
-  static std::uniform_real_distribution<double> dist(0.0, 1.0);
-
-  double w1 = DiffuseMaterial::averageAlbedo();
-  double w2 = SpecularMaterial::averageAlbedo();
-  double w3 = IdealReflector::kr().luminance();
-  double w4 = IdealRefractor::kt().luminance();
-
-  double sum = w1 + w2 + w3 + w4;
-  w1 /= sum;
-  w2 /= sum;
-  w3 /= sum;
-  w4 /= sum;
-
-  double p = dist(gen);
-
-  if ((p -= w1) < 0) {
-    Reflection r = DiffuseMaterial::reflection(N, V, uv);
-    r.prob *= w1;
-    return r;
-  }
-  if ((p -= w2) < 0) {
-    Reflection r = SpecularMaterial::reflection(N, V, uv);
-    r.prob *= w2;
-    return r;
-  }
-  if ((p -= w3) < 0) {
-    Reflection r = IdealReflector::reflection(N, V, uv);
-    r.prob *= w3;
+                                       geometry::TexCoord const &uv) const {
+  return sample(N, V, uv, nullptr, 1.0);
+}
+
+Reflection GeneralMaterial::reflection(geometry::Normal3D const &N,
+                                       geometry::Normal3D const &V,
+                                       geometry::TexCoord const &uv,
+                                       DirectionalDistribution const &guide,
+                                       color::Intensity bsdfFraction) const {
+  return sample(N, V, uv, &guide, bsdfFraction);
+}
+
+Reflection GeneralMaterial::sample(geometry::Normal3D const &N,
+                                   geometry::Normal3D const &V,
+                                   geometry::TexCoord const &uv,
+                                   DirectionalDistribution const *guide,
+                                   color::Intensity bsdfFraction) const {
+  if (m_nLobes == 0) return noReflection();
+
+  double p = uniform();
+
+  Lobe const *lobe = m_lobes;
+  while (p >= lobe->cdf && lobe < m_lobes + m_nLobes - 1) ++lobe;
+
+  // Each case builds its reflection once, since spectra are heap-backed.
+  auto weighted = [lobe](Reflection r) {
+    r.prob *= lobe->weight;
+    r.pdf *= lobe->weight;
     return r;
+  };
+  switch (lobe->type) {
+    case Lobe::Diffuse: {
+      double prob, pdf;
+      geometry::Normal3D dir{0.0, 0.0, 1.0};
+      if (guide != nullptr) {
+        dir = sampleGuided(N, *guide, bsdfFraction, prob, pdf);
+      } else {
+        dir = sampleCosine(N, prob);
+        pdf = prob;
+      }
+      return weighted({prob, dir, GeneralMaterial::BRDF(dir, N, V, uv), pdf});
+    }
+    case Lobe::Specular: {
+      geometry::Normal3D dir{0.0, 0.0, 1.0};
+      double prob;
+      if (!samplePhongDirection(lobe->param, N, V, dir, prob))
+        return noReflection();
+      return weighted({prob, dir, GeneralMaterial::BRDF(dir, N, V, uv)});
+    }
+    case Lobe::Reflector:
+      return weighted(reflectIdeal(lobe->spectrum, N, V));
+    case Lobe::Refractor:
+      return weighted(refractIdeal(lobe->spectrum, lobe->param, N, V));
   }
-  Reflection r = IdealRefractor::reflection(N, V, uv);
-  r.prob *= w4;
-  return r;
+  return noReflection();
 }
 
-color::SColor GeneralMaterial::transparency() const {
-  double w1 = DiffuseMaterial::averageAlbedo();
-  double w2 = SpecularMaterial::averageAlbedo();
-  double w3 = IdealReflector::kr().luminance();
-  double w4 = IdealRefractor::kt().luminance();
+color::SColor GeneralMaterial::transparency() const { return m_transparency; }
+
+bool GeneralMaterial::requiresUV() const { return m_texture != nullptr; }
 
-  return (DiffuseMaterial::transparency() * w1 +
-          SpecularMaterial::transparency() * w2 +
-          IdealReflector::transparency() * w3 +
-          IdealRefractor::transparency() * w4) /
-         (w1 + w2 + w3 + w4);
+color::Intensity GeneralMaterial::diffuseWeight() const {
+  if (m_nLobes == 0 || m_lobes[0].type != Lobe::Diffuse) return 0.0;
+  return m_lobes[0].weight;
 }
 
-bool GeneralMaterial::requiresUV() const {
-  return DiffuseMaterial::requiresUV() || SpecularMaterial::requiresUV() ||
-         IdealReflector::requiresUV() || IdealRefractor::requiresUV();
+color::SColor GeneralMaterial::diffuseColor(geometry::TexCoord const &uv) const {
+  if (m_nLobes == 0 || m_lobes[0].type != Lobe::Diffuse)
+    return color::SColor(0.0);
+  if (m_texture != nullptr) return m_lobes[0].spectrum * m_texture->get(uv);
+  return m_lobes[0].spectrum;
 }
 
-}  // namespace modelling
\ No newline at end of file
+}  // namespace modelling
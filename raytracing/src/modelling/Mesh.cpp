@@ -0,0 +1,344 @@
+#include <modelling/Mesh.h>
+
+#include <geometry/Batch.h>
+#include <platform/Cpu.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace modelling {
+
+// Triangles per leaf of the hierarchy.
+static const size_t LeafSize = 4;
+
+static const geometry::Coord EPS = 1e-8;
+
+// Barycentric coordinates of the projection of x onto the plane of abc, as
+// the weights of b and c.
+static void barycentric(geometry::Point3D const& a, geometry::Point3D const& b,
+                        geometry::Point3D const& c, geometry::Point3D const& x,
+                        geometry::Coord& v, geometry::Coord& w) {
+  geometry::Vector3D e1 = b - a, e2 = c - a, p = x - a;
+  geometry::Coord d11 = e1 * e1, d12 = e1 * e2, d22 = e2 * e2;
+  geometry::Coord p1 = p * e1, p2 = p * e2;
+  geometry::Coord det = d11 * d22 - d12 * d12;
+  if (std::abs(det) < 1e-300) {
+    v = w = 0.0;
+    return;
+  }
+  v = (d22 * p1 - d12 * p2) / det;
+  w = (d11 * p2 - d12 * p1) / det;
+}
+
+/**
+ * @brief Construct a new Mesh:: Mesh object
+ *
+ * @param data
+ * @param material
+ * @param view
+ */
+Mesh::Mesh(MeshData data, std::shared_ptr<Material> material,
+           geometry::Matrix<4, 4> view)
+    : Primitive(std::move(material), nullptr, Shape::Mesh),
+      m_positions(std::move(data.positions)),
+      m_indices(std::move(data.indices)) {
+  if (m_positions.size() % 3 != 0 || m_indices.size() % 3 != 0)
+    throw "Mesh data is not made of vertices and triangles";
+  if (m_indices.size() / 3 > std::numeric_limits<uint32_t>::max())
+    throw "Mesh has too many triangles";
+  size_t vertices = m_positions.size() / 3;
+  for (uint32_t index : m_indices)
+    if (index >= vertices) throw "Mesh index out of range";
+
+  geometry::Affine3D transform(view);
+  for (size_t i = 0; i < m_positions.size(); i += 3) {
+    geometry::Point3D p = transform * geometry::Point3D{
+                                          m_positions[i], m_positions[i + 1],
+                                          m_positions[i + 2]};
+    m_positions[i] = float(p.x);
+    m_positions[i + 1] = float(p.y);
+    m_positions[i + 2] = float(p.z);
+  }
+  build();
+}
+
+geometry::Point3D Mesh::vertex(size_t triangle, size_t corner) const {
+  float const* p = &m_positions[3 * size_t(m_indices[3 * triangle + corner])];
+  return {p[0], p[1], p[2]};
+}
+
+// Median splits along the longest axis of the centroids, so that building
+// takes O(n log n) for any mesh.
+void Mesh::build() {
+  size_t n = triangleCount();
+  m_nodes.clear();
+  if (n == 0) return;
+
+  std::vector<float> centroids(3 * n);
+  std::vector<uint32_t> order(n);
+  for (size_t t = 0; t < n; ++t) {
+    for (size_t k = 0; k < 3; ++k) {
+      float sum = 0.0f;
+      for (size_t corner = 0; corner < 3; ++corner)
+        sum += m_positions[3 * size_t(m_indices[3 * t + corner]) + k];
+      centroids[3 * t + k] = sum / 3.0f;
+    }
+    order[t] = uint32_t(t);
+  }
+  m_nodes.reserve(2 * n / LeafSize + 1);
+
+  auto split = [&](auto& self, size_t begin, size_t end) -> uint32_t {
+    uint32_t index = uint32_t(m_nodes.size());
+    m_nodes.emplace_back();
+
+    float inf = std::numeric_limits<float>::infinity();
+    float lower[3] = {inf, inf, inf}, upper[3] = {-inf, -inf, -inf};
+    float centerLower[3] = {inf, inf, inf};
+    float centerUpper[3] = {-inf, -inf, -inf};
+    for (size_t i = begin; i < end; ++i) {
+      size_t t = order[i];
+      for (size_t k = 0; k < 3; ++k) {
+        for (size_t corner = 0; corner < 3; ++corner) {
+          float p = m_positions[3 * size_t(m_indices[3 * t + corner]) + k];
+          lower[k] = std::min(lower[k], p);
+          upper[k] = std::max(upper[k], p);
+        }
+        centerLower[k] = std::min(centerLower[k], centroids[3 * t + k]);
+        centerUpper[k] = std::max(centerUpper[k], centroids[3 * t + k]);
+      }
+    }
+    for (size_t k = 0; k < 3; ++k) {
+      m_nodes[index].lower[k] = lower[k];
+      m_nodes[index].upper[k] = upper[k];
+    }
+
+    size_t axis = 0;
+    for (size_t k = 1; k < 3; ++k)
+      if (centerUpper[k] - centerLower[k] >
+          centerUpper[axis] - centerLower[axis])
+        axis = k;
+    if (end - begin <= LeafSize || centerUpper[axis] <= centerLower[axis]) {
+      m_nodes[index].first = uint32_t(begin);
+      m_nodes[index].count = uint32_t(end - begin);
+      return index;
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    std::nth_element(order.begin() + long(begin), order.begin() + long(mid),
+                     order.begin() + long(end), [&](uint32_t a, uint32_t b) {
+                       return centroids[3 * size_t(a) + axis] <
+                              centroids[3 * size_t(b) + axis];
+                     });
+    self(self, begin, mid);
+    uint32_t right = self(self, mid, end);
+    m_nodes[index].first = right;
+    m_nodes[index].count = 0;
+    return index;
+  };
+  split(split, 0, n);
+
+  std::vector<uint32_t> indices(m_indices.size());
+  for (size_t i = 0; i < n; ++i)
+    for (size_t corner = 0; corner < 3; ++corner)
+      indices[3 * i + corner] = m_indices[3 * size_t(order[i]) + corner];
+  m_indices = std::move(indices);
+}
+
+/**
+ * @brief Nearest hit of a ray in the hierarchy of a mesh, as a kernel
+ * compiled for every instruction set level. The triangles of a leaf are
+ * tested as the lanes of a batch.
+ */
+struct MeshTraversal {
+  static const size_t Lanes = 4;
+
+  RAYTRACING_KERNEL Hit nearest(Mesh const* mesh, geometry::Ray const* ray) {
+    using Coord = geometry::Coord;
+    std::vector<Mesh::Node> const& nodes = mesh->m_nodes;
+    Coord const infinity = std::numeric_limits<Coord>::infinity();
+    if (nodes.empty()) return {-1.0, 0};
+
+    geometry::Point3D const& o = ray->start;
+    geometry::Vector3D const& d = ray->direction;
+    Coord inv[3] = {1.0 / d.x, 1.0 / d.y, 1.0 / d.z};
+    geometry::Point3Dx4 origin = geometry::Point3Dx4::broadcast(o);
+    geometry::Point3Dx4 direction = geometry::Point3Dx4::broadcast(d);
+
+    Coord best = infinity;
+    size_t hit = 0;
+
+    // Entry distances of the ray into the bounds of nodes, as lanes, or
+    // infinity where it misses them or enters beyond the best hit. A zero
+    // component of the direction makes NaNs, which the comparisons skip.
+    Coord shift[3] = {-o.x * inv[0], -o.y * inv[1], -o.z * inv[2]};
+    auto enter = [&](Mesh::Node const* const (&node)[2], Coord (&t)[2]) {
+      Coord t0[2] = {0.0, 0.0}, t1[2] = {best, best};
+      for (size_t k = 0; k < 3; ++k) {
+        for (size_t c = 0; c < 2; ++c) {
+          Coord a = node[c]->lower[k] * inv[k] + shift[k];
+          Coord b = node[c]->upper[k] * inv[k] + shift[k];
+          t0[c] = std::max(t0[c], std::min(a, b));
+          t1[c] = std::min(t1[c], std::max(a, b));
+        }
+      }
+      for (size_t c = 0; c < 2; ++c) t[c] = t0[c] <= t1[c] ? t0[c] : infinity;
+    };
+
+    struct Entry {
+      uint32_t node;
+      Coord t;
+    };
+    Entry stack[64];
+    size_t top = 0;
+    Coord t[2];
+    enter({&nodes[0], &nodes[0]}, t);
+    if (t[0] < best) stack[top++] = {0, 0.0};
+
+    while (top > 0) {
+      Entry entry = stack[--top];
+      if (entry.t >= best) continue;
+      Mesh::Node const* node = &nodes[entry.node];
+
+      // Descend to the nearer child until a leaf.
+      while (node->count == 0) {
+        uint32_t near = uint32_t(node - nodes.data()) + 1, far = node->first;
+        enter({&nodes[near], &nodes[far]}, t);
+        Coord tNear = t[0], tFar = t[1];
+        if (tFar < tNear) {
+          std::swap(near, far);
+          std::swap(tNear, tFar);
+        }
+        if (tNear >= best) break;
+        if (tFar < best) stack[top++] = {far, tFar};
+        node = &nodes[near];
+      }
+      if (node->count == 0) continue;
+
+      // Möller-Trumbore, from both sides. Lanes past the end of the leaf
+      // repeat its last triangle.
+      size_t end = size_t(node->first) + node->count;
+      for (size_t first = node->first; first < end; first += Lanes) {
+        geometry::Point3Dx4 a, e1, e2;
+        for (size_t l = 0; l < Lanes; ++l) {
+          size_t i = std::min(first + l, end - 1);
+          geometry::Point3D v0 = mesh->vertex(i, 0);
+          a.set(l, v0);
+          e1.set(l, mesh->vertex(i, 1) - v0);
+          e2.set(l, mesh->vertex(i, 2) - v0);
+        }
+        geometry::Point3Dx4 p = direction % e2;
+        geometry::Coordx4 det = e1 * p;
+        geometry::Point3Dx4 s = origin - a;
+        geometry::Coordx4 u = s * p;
+        geometry::Point3Dx4 q = s % e1;
+        geometry::Coordx4 v = direction * q;
+        geometry::Coordx4 t = e2 * q;
+        for (size_t l = 0; l < Lanes; ++l) {
+          Coord invDet = 1.0 / det.v[l];
+          Coord ul = u.v[l] * invDet, vl = v.v[l] * invDet;
+          Coord tl = t.v[l] * invDet;
+          bool inside = std::abs(det.v[l]) >= 1e-14 && ul >= 0.0 &&
+                        ul <= 1.0 && vl >= 0.0 && ul + vl <= 1.0 && tl > EPS;
+          t.v[l] = inside ? tl : infinity;
+        }
+        for (size_t l = 0; l < Lanes; ++l) {
+          if (t.v[l] < best) {
+            best = t.v[l];
+            hit = first + l;
+          }
+        }
+      }
+    }
+
+    if (best == infinity) return {-1.0, 0};
+    return {best, uint32_t(hit)};
+  }
+};
+
+geometry::Coord Mesh::intersect(geometry::Ray const& ray) const {
+  return hit(ray).t;
+}
+
+Hit Mesh::hit(geometry::Ray const& ray) const {
+  return platform::Multiversioned<&MeshTraversal::nearest>::call(this, &ray);
+}
+
+// The triangle closest to x among the leaves whose bounds contain x, up to
+// the rounding of the positions to single precision.
+size_t Mesh::locate(geometry::Point3D const& x) const {
+  if (m_nodes.empty()) return 0;
+  float tolerance = float(1e-5 * (1.0 + std::sqrt(x * x)));
+  float point[3] = {float(x.x), float(x.y), float(x.z)};
+
+  size_t closest = 0;
+  geometry::Coord closestDistance = std::numeric_limits<double>::infinity();
+  uint32_t stack[64];
+  size_t top = 0;
+  stack[top++] = 0;
+  while (top > 0) {
+    Node const& node = m_nodes[stack[--top]];
+    bool inside = true;
+    for (size_t k = 0; k < 3; ++k)
+      inside = inside && point[k] >= node.lower[k] - tolerance &&
+               point[k] <= node.upper[k] + tolerance;
+    if (!inside) continue;
+    if (node.count == 0) {
+      stack[top++] = node.first;
+      stack[top++] = uint32_t(&node - m_nodes.data()) + 1;
+      continue;
+    }
+
+    for (size_t i = node.first; i < size_t(node.first) + node.count; ++i) {
+      geometry::Point3D a = vertex(i, 0), b = vertex(i, 1), c = vertex(i, 2);
+      geometry::Coord v, w;
+      barycentric(a, b, c, x, v, w);
+      geometry::Normal3D n((b - a) % (c - a));
+      // Distance from the plane, plus how far outside the edges x is.
+      geometry::Coord outside = std::max({0.0, -v, -w, v + w - 1.0});
+      geometry::Coord size = std::max((b - a).length(), (c - a).length());
+      geometry::Coord distance = std::abs((x - a) * n) + outside * size;
+      if (distance < closestDistance) {
+        closestDistance = distance;
+        closest = i;
+      }
+    }
+  }
+  return closest;
+}
+
+geometry::Point2D Mesh::getUV(geometry::Point3D const& x) const {
+  return getUV(x, uint32_t(locate(x)));
+}
+
+geometry::Normal3D Mesh::normal(geometry::Point3D const& x) const {
+  return normal(x, uint32_t(locate(x)));
+}
+
+geometry::Normal3D Mesh::normal(geometry::Point3D const& x,
+                                geometry::TexCoord const&) const {
+  return normal(x);
+}
+
+// Barycentric coordinates in the plane of the triangle, also for points
+// beside it such as the ends of ray differentials.
+geometry::Point2D Mesh::getUV(geometry::Point3D const& x,
+                              uint32_t part) const {
+  geometry::Coord v, w;
+  barycentric(vertex(part, 0), vertex(part, 1), vertex(part, 2), x, v, w);
+  return {v, w};
+}
+
+geometry::Normal3D Mesh::normal(geometry::Point3D const&,
+                                uint32_t part) const {
+  geometry::Point3D a = vertex(part, 0);
+  return (vertex(part, 1) - a) % (vertex(part, 2) - a);
+}
+
+geometry::Normal3D Mesh::normal(geometry::Point3D const& x,
+                                geometry::TexCoord const&,
+                                uint32_t part) const {
+  return normal(x, part);
+}
+
+}  // namespace modelling
@@ -0,0 +1,696 @@
+#include <modelling/MeshLoader.h>
+#include <platform/parallel.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <sstream>
+
+namespace modelling {
+
+// Bytes of OBJ text and PLY records parsed per task.
+static const size_t ChunkSize = size_t(1) << 20;
+
+static double seconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+namespace {
+
+// Read-only mapping of a whole file.
+class MappedFile {
+ public:
+  explicit MappedFile(std::string const& filename)
+      : m_fd(::open(filename.c_str(), O_RDONLY)), m_size(0), m_map(nullptr) {
+    if (m_fd < 0) throw "Cannot open mesh file";
+    struct stat info;
+    if (::fstat(m_fd, &info) != 0) {
+      ::close(m_fd);
+      throw "Cannot open mesh file";
+    }
+    m_size = size_t(info.st_size);
+    if (m_size == 0) return;
+    m_map = ::mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+    if (m_map == MAP_FAILED) {
+      ::close(m_fd);
+      throw "Cannot map mesh file";
+    }
+    // The chunks are read at once from several threads.
+    ::madvise(m_map, m_size, MADV_WILLNEED);
+  }
+
+  ~MappedFile() {
+    if (m_map) ::munmap(m_map, m_size);
+    ::close(m_fd);
+  }
+
+  MappedFile(MappedFile const&) = delete;
+  MappedFile& operator=(MappedFile const&) = delete;
+
+  char const* data() const { return static_cast<char const*>(m_map); }
+  size_t size() const { return m_size; }
+
+ private:
+  int m_fd;
+  size_t m_size;
+  void* m_map;
+};
+
+}  // namespace
+
+// parallelFor that rethrows the first error of f on the calling thread.
+template <typename F>
+static void parallelChunks(size_t n, size_t threads, F const& f) {
+  std::mutex mutex;
+  char const* error = nullptr;
+  platform::parallelFor(n, threads, [&](size_t i) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (error) return;
+    }
+    try {
+      f(i);
+    } catch (char const* e) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error) error = e;
+    }
+  });
+  if (error) throw error;
+}
+
+static void finish(MeshData const& mesh, size_t bytes, double start,
+                   MeshLoadStats* stats) {
+  if (mesh.vertexCount() > std::numeric_limits<uint32_t>::max())
+    throw "Mesh has too many vertices";
+  if (stats) *stats = {bytes, seconds() - start};
+}
+
+// ----------------------------------------------------------------- OBJ
+
+static inline bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline void skipBlanks(char const*& p, char const* end) {
+  while (p < end && isBlank(*p)) ++p;
+}
+
+// Decimal number with an optional fraction and exponent, without the locale
+// and the generality of strtod. Digits past the 19th only scale the value,
+// which is far below the precision of the float it is stored in.
+static bool parseFloat(char const*& p, char const* end, double& value) {
+  static const double Powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+
+  uint64_t mantissa = 0;
+  int digits = 0, exponent = 0;
+  bool any = false;
+  for (; p < end && isDigit(*p); ++p) {
+    any = true;
+    if (digits < 19) {
+      mantissa = mantissa * 10 + uint64_t(*p - '0');
+      if (mantissa) ++digits;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && isDigit(*p); ++p) {
+      any = true;
+      if (digits < 19) {
+        mantissa = mantissa * 10 + uint64_t(*p - '0');
+        if (mantissa) ++digits;
+        --exponent;
+      }
+    }
+  }
+  if (!any) return false;
+
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+')) negativeExponent = *p++ == '-';
+    if (p == end || !isDigit(*p)) return false;
+    int e = 0;
+    for (; p < end && isDigit(*p); ++p)
+      if (e < 10000) e = e * 10 + (*p - '0');
+    exponent += negativeExponent ? -e : e;
+  }
+
+  double v = double(mantissa);
+  if (exponent < 0)
+    v = exponent >= -22 ? v / Powers[-exponent] : v * std::pow(10.0, exponent);
+  else if (exponent > 0)
+    v = exponent <= 22 ? v * Powers[exponent] : v * std::pow(10.0, exponent);
+  value = negative ? -v : v;
+  return true;
+}
+
+static bool parseInteger(char const*& p, char const* end, int64_t& value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) negative = *p++ == '-';
+  if (p == end || !isDigit(*p)) return false;
+  int64_t v = 0;
+  for (; p < end && isDigit(*p); ++p)
+    if (v < (int64_t(1) << 40)) v = v * 10 + (*p - '0');
+  value = negative ? -v : v;
+  return true;
+}
+
+// Indices of the faces of a chunk before the vertices of the earlier chunks
+// are counted. Relative indices are stored minus RelativeTag, as offsets
+// from the first vertex of the chunk.
+static const int64_t RelativeTag = int64_t(1) << 62;
+
+struct ObjChunk {
+  std::vector<float> positions;
+  std::vector<int64_t> indices;
+};
+
+// The lines that start in [begin, end) of data.
+static void parseObjLines(char const* data, size_t size, size_t begin,
+                          size_t end, ObjChunk& chunk) {
+  size_t line = begin;
+  while (line < end) {
+    char const* p = data + line;
+    char const* lineEnd =
+        static_cast<char const*>(std::memchr(p, '\n', size - line));
+    if (!lineEnd) lineEnd = data + size;
+    line = size_t(lineEnd - data) + 1;
+
+    skipBlanks(p, lineEnd);
+    if (lineEnd - p < 2 || !isBlank(p[1])) continue;
+
+    if (p[0] == 'v') {
+      p += 2;
+      for (size_t k = 0; k < 3; ++k) {
+        double value;
+        skipBlanks(p, lineEnd);
+        if (!parseFloat(p, lineEnd, value))
+          throw "Malformed vertex in OBJ file";
+        chunk.positions.push_back(float(value));
+      }
+    } else if (p[0] == 'f') {
+      p += 2;
+      int64_t vertices = int64_t(chunk.positions.size() / 3);
+      int64_t first = 0, previous = 0;
+      size_t corners = 0;
+      for (;;) {
+        skipBlanks(p, lineEnd);
+        if (p == lineEnd || *p == '#') break;
+        int64_t index;
+        if (!parseInteger(p, lineEnd, index) || index == 0)
+          throw "Malformed face in OBJ file";
+        index = index > 0 ? index - 1 : vertices + index - RelativeTag;
+        // Texture coordinate and normal indices.
+        while (p < lineEnd && !isBlank(*p)) ++p;
+
+        if (corners == 0) first = index;
+        if (corners >= 2) {
+          chunk.indices.push_back(first);
+          chunk.indices.push_back(previous);
+          chunk.indices.push_back(index);
+        }
+        previous = index;
+        ++corners;
+      }
+      if (corners < 3) throw "Face with fewer than three vertices in OBJ file";
+    }
+  }
+}
+
+MeshData loadObj(std::string const& filename, size_t threads,
+                 MeshLoadStats* stats) {
+  double start = seconds();
+  MappedFile file(filename);
+  char const* data = file.data();
+  size_t size = file.size();
+
+  size_t n = std::max<size_t>(1, (size + ChunkSize - 1) / ChunkSize);
+  std::vector<ObjChunk> chunks(n);
+  parallelChunks(n, threads, [&](size_t i) {
+    size_t begin = std::min(size, i * ChunkSize);
+    size_t end = std::min(size, begin + ChunkSize);
+    // The line that starts before begin belongs to the previous chunk.
+    if (begin > 0) {
+      char const* newline = static_cast<char const*>(
+          std::memchr(data + begin - 1, '\n', size - begin + 1));
+      begin = newline ? size_t(newline - data) + 1 : size;
+    }
+    parseObjLines(data, size, begin, end, chunks[i]);
+  });
+
+  std::vector<size_t> vertexBase(n + 1, 0), indexBase(n + 1, 0);
+  for (size_t i = 0; i < n; ++i) {
+    vertexBase[i + 1] = vertexBase[i] + chunks[i].positions.size() / 3;
+    indexBase[i + 1] = indexBase[i] + chunks[i].indices.size();
+  }
+
+  MeshData mesh;
+  mesh.positions.resize(3 * vertexBase[n]);
+  mesh.indices.resize(indexBase[n]);
+  int64_t vertices = int64_t(vertexBase[n]);
+  parallelChunks(n, threads, [&](size_t i) {
+    ObjChunk& chunk = chunks[i];
+    std::copy(chunk.positions.begin(), chunk.positions.end(),
+              mesh.positions.begin() + long(3 * vertexBase[i]));
+    uint32_t* out = mesh.indices.data() + indexBase[i];
+    for (int64_t index : chunk.indices) {
+      if (index < -RelativeTag / 2)
+        index += RelativeTag + int64_t(vertexBase[i]);
+      if (index < 0 || index >= vertices)
+        throw "Face index out of range in OBJ file";
+      *out++ = uint32_t(index);
+    }
+    chunk = ObjChunk();
+  });
+
+  finish(mesh, size, start, stats);
+  return mesh;
+}
+
+// ----------------------------------------------------------------- PLY
+
+namespace {
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float, Double };
+
+struct PlyProperty {
+  std::string name;
+  PlyType type;
+  // Lists have a count of countType followed by elements of type.
+  bool list;
+  PlyType countType;
+};
+
+struct PlyElement {
+  std::string name;
+  size_t count;
+  std::vector<PlyProperty> properties;
+};
+
+}  // namespace
+
+static PlyType plyType(std::string const& name) {
+  static const std::pair<char const*, PlyType> Types[] = {
+      {"char", PlyType::Int8},      {"int8", PlyType::Int8},
+      {"uchar", PlyType::UInt8},    {"uint8", PlyType::UInt8},
+      {"short", PlyType::Int16},    {"int16", PlyType::Int16},
+      {"ushort", PlyType::UInt16},  {"uint16", PlyType::UInt16},
+      {"int", PlyType::Int32},      {"int32", PlyType::Int32},
+      {"uint", PlyType::UInt32},    {"uint32", PlyType::UInt32},
+      {"float", PlyType::Float},    {"float32", PlyType::Float},
+      {"double", PlyType::Double},  {"float64", PlyType::Double}};
+  for (auto const& type : Types)
+    if (name == type.first) return type.second;
+  throw "Unknown property type in PLY file";
+}
+
+static size_t plySize(PlyType type) {
+  switch (type) {
+    case PlyType::Int8:
+    case PlyType::UInt8:
+      return 1;
+    case PlyType::Int16:
+    case PlyType::UInt16:
+      return 2;
+    case PlyType::Int32:
+    case PlyType::UInt32:
+    case PlyType::Float:
+      return 4;
+    default:
+      return 8;
+  }
+}
+
+template <typename T>
+static inline T readRaw(char const* p, bool swap) {
+  unsigned char bytes[sizeof(T)];
+  std::memcpy(bytes, p, sizeof(T));
+  if (swap) std::reverse(bytes, bytes + sizeof(T));
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+static inline double readNumber(char const* p, PlyType type, bool swap) {
+  switch (type) {
+    case PlyType::Int8:
+      return readRaw<int8_t>(p, swap);
+    case PlyType::UInt8:
+      return readRaw<uint8_t>(p, swap);
+    case PlyType::Int16:
+      return readRaw<int16_t>(p, swap);
+    case PlyType::UInt16:
+      return readRaw<uint16_t>(p, swap);
+    case PlyType::Int32:
+      return readRaw<int32_t>(p, swap);
+    case PlyType::UInt32:
+      return readRaw<uint32_t>(p, swap);
+    case PlyType::Float:
+      return readRaw<float>(p, swap);
+    default:
+      return readRaw<double>(p, swap);
+  }
+}
+
+static inline int64_t readInteger(char const* p, PlyType type, bool swap) {
+  switch (type) {
+    case PlyType::Int8:
+      return readRaw<int8_t>(p, swap);
+    case PlyType::UInt8:
+      return readRaw<uint8_t>(p, swap);
+    case PlyType::Int16:
+      return readRaw<int16_t>(p, swap);
+    case PlyType::UInt16:
+      return readRaw<uint16_t>(p, swap);
+    case PlyType::Int32:
+      return readRaw<int32_t>(p, swap);
+    case PlyType::UInt32:
+      return readRaw<uint32_t>(p, swap);
+    default:
+      throw "Integer property of floating point type in PLY file";
+  }
+}
+
+// Elements of the header, and the offset of the data after it.
+static std::vector<PlyElement> parsePlyHeader(char const* data, size_t size,
+                                              bool& bigEndian,
+                                              size_t& offset) {
+  if (size < 4 || std::memcmp(data, "ply", 3) != 0 ||
+      (data[3] != '\n' && data[3] != '\r'))
+    throw "Not a PLY file";
+
+  std::vector<PlyElement> elements;
+  bool format = false;
+  char const* magic =
+      static_cast<char const*>(std::memchr(data, '\n', size));
+  if (!magic) throw "PLY header without end_header";
+  size_t line = size_t(magic - data) + 1;
+  for (;;) {
+    if (line >= size) throw "PLY header without end_header";
+    char const* end =
+        static_cast<char const*>(std::memchr(data + line, '\n', size - line));
+    if (!end) throw "PLY header without end_header";
+    std::istringstream in(std::string(data + line, end));
+    line = size_t(end - data) + 1;
+
+    std::string keyword;
+    in >> keyword;
+    if (keyword == "format") {
+      std::string name;
+      in >> name;
+      if (name == "binary_little_endian")
+        bigEndian = false;
+      else if (name == "binary_big_endian")
+        bigEndian = true;
+      else
+        throw "Only binary PLY files are supported";
+      format = true;
+    } else if (keyword == "element") {
+      PlyElement element;
+      in >> element.name >> element.count;
+      if (!in) throw "Malformed element in PLY file";
+      elements.push_back(element);
+    } else if (keyword == "property") {
+      if (elements.empty()) throw "PLY property outside of an element";
+      PlyProperty property;
+      std::string type;
+      in >> type;
+      property.list = type == "list";
+      if (property.list) {
+        std::string countType;
+        in >> countType >> type;
+        property.countType = plyType(countType);
+      }
+      property.type = plyType(type);
+      in >> property.name;
+      if (!in) throw "Malformed property in PLY file";
+      elements.back().properties.push_back(property);
+    } else if (keyword == "end_header") {
+      break;
+    }
+  }
+  if (!format) throw "PLY file without format";
+  offset = line;
+  return elements;
+}
+
+// Bytes of the record of element at p, which has lists; 0 if it does not
+// fit before end.
+static size_t plyRecordSize(PlyElement const& element, char const* p,
+                            char const* end, bool swap) {
+  char const* q = p;
+  for (auto const& property : element.properties) {
+    if (!property.list) {
+      q += plySize(property.type);
+      continue;
+    }
+    size_t countSize = plySize(property.countType);
+    if (q > end || size_t(end - q) < countSize) return 0;
+    int64_t count = readInteger(q, property.countType, swap);
+    if (count < 0) throw "Negative list length in PLY file";
+    q += countSize + size_t(count) * plySize(property.type);
+  }
+  return q <= end ? size_t(q - p) : 0;
+}
+
+static bool hasLists(PlyElement const& element) {
+  for (auto const& property : element.properties)
+    if (property.list) return true;
+  return false;
+}
+
+// Bytes per record of an element without lists.
+static size_t plyStride(PlyElement const& element) {
+  size_t stride = 0;
+  for (auto const& property : element.properties)
+    stride += plySize(property.type);
+  return stride;
+}
+
+static void readPlyVertices(PlyElement const& element, char const* data,
+                            size_t bytes, bool swap, size_t threads,
+                            MeshData& mesh) {
+  if (hasLists(element)) throw "PLY vertices with list properties";
+  size_t stride = plyStride(element);
+  if (stride == 0 || bytes / stride < element.count)
+    throw "PLY file ends within the vertices";
+
+  size_t offsets[3] = {0, 0, 0};
+  PlyType types[3] = {PlyType::Float, PlyType::Float, PlyType::Float};
+  char const* names[3] = {"x", "y", "z"};
+  for (size_t k = 0; k < 3; ++k) {
+    size_t offset = 0;
+    bool found = false;
+    for (auto const& property : element.properties) {
+      if (property.name == names[k]) {
+        offsets[k] = offset;
+        types[k] = property.type;
+        found = true;
+        break;
+      }
+      offset += plySize(property.type);
+    }
+    if (!found) throw "PLY vertices without x, y and z";
+  }
+
+  mesh.positions.resize(3 * element.count);
+  size_t perChunk = std::max<size_t>(1, ChunkSize / stride);
+  size_t n = (element.count + perChunk - 1) / perChunk;
+  parallelChunks(n, threads, [&](size_t chunk) {
+    size_t begin = chunk * perChunk;
+    size_t end = std::min(element.count, begin + perChunk);
+    for (size_t i = begin; i < end; ++i) {
+      char const* record = data + i * stride;
+      for (size_t k = 0; k < 3; ++k)
+        mesh.positions[3 * i + k] =
+            float(readNumber(record + offsets[k], types[k], swap));
+    }
+  });
+}
+
+// Fan of the polygon of count indices at p.
+static void readPlyPolygon(char const* p, int64_t count, PlyType type,
+                           bool swap, size_t vertices,
+                           std::vector<uint32_t>& indices) {
+  if (count < 3) throw "Face with fewer than three vertices in PLY file";
+  size_t size = plySize(type);
+  auto index = [&](int64_t k) {
+    int64_t i = readInteger(p + size_t(k) * size, type, swap);
+    if (i < 0 || uint64_t(i) >= vertices)
+      throw "Face index out of range in PLY file";
+    return uint32_t(i);
+  };
+  for (int64_t k = 2; k < count; ++k) {
+    indices.push_back(index(0));
+    indices.push_back(index(k - 1));
+    indices.push_back(index(k));
+  }
+}
+
+// Returns the bytes of the face records.
+static size_t readPlyFaces(PlyElement const& element, char const* data,
+                           size_t bytes, bool swap, size_t threads,
+                           MeshData& mesh) {
+  char const* end = data + bytes;
+  size_t list = element.properties.size();
+  size_t before = 0, after = 0, lists = 0;
+  for (size_t k = 0; k < element.properties.size(); ++k) {
+    auto const& property = element.properties[k];
+    if (property.list) {
+      ++lists;
+      if (property.name == "vertex_indices" || property.name == "vertex_index")
+        list = k;
+    } else {
+      (list < k ? after : before) += plySize(property.type);
+    }
+  }
+  if (list == element.properties.size())
+    throw "PLY faces without vertex_indices";
+  PlyProperty const& indexList = element.properties[list];
+  size_t countSize = plySize(indexList.countType);
+  size_t indexSize = plySize(indexList.type);
+  size_t vertices = mesh.vertexCount();
+
+  // Records of triangles have a fixed size, so that they are read in
+  // parallel; other faces are read one after the other. Past the first face
+  // that is not a triangle the records are misaligned, so an index out of
+  // range only counts as an error if all faces were triangles.
+  if (lists == 1) {
+    size_t stride = before + countSize + 3 * indexSize + after;
+    if (bytes / stride >= element.count) {
+      mesh.indices.resize(3 * element.count);
+      std::atomic<bool> triangles(true), outOfRange(false);
+      size_t perChunk = std::max<size_t>(1, ChunkSize / stride);
+      size_t n = (element.count + perChunk - 1) / perChunk;
+      parallelChunks(n, threads, [&](size_t chunk) {
+        size_t begin = chunk * perChunk;
+        size_t last = std::min(element.count, begin + perChunk);
+        for (size_t i = begin; i < last && triangles; ++i) {
+          char const* record = data + i * stride + before;
+          if (readInteger(record, indexList.countType, swap) != 3) {
+            triangles = false;
+            return;
+          }
+          for (size_t k = 0; k < 3; ++k) {
+            int64_t index = readInteger(record + countSize + k * indexSize,
+                                        indexList.type, swap);
+            if (index < 0 || uint64_t(index) >= vertices) {
+              outOfRange = true;
+              return;
+            }
+            mesh.indices[3 * i + k] = uint32_t(index);
+          }
+        }
+      });
+      if (triangles) {
+        if (outOfRange) throw "Face index out of range in PLY file";
+        return element.count * stride;
+      }
+      mesh.indices.clear();
+    }
+  }
+
+  char const* p = data;
+  for (size_t i = 0; i < element.count; ++i) {
+    size_t size = plyRecordSize(element, p, end, swap);
+    if (size == 0) throw "PLY file ends within the faces";
+    char const* q = p;
+    for (size_t k = 0; k < element.properties.size(); ++k) {
+      auto const& property = element.properties[k];
+      if (!property.list) {
+        q += plySize(property.type);
+        continue;
+      }
+      int64_t count = readInteger(q, property.countType, swap);
+      q += plySize(property.countType);
+      if (k == list)
+        readPlyPolygon(q, count, property.type, swap, vertices,
+                       mesh.indices);
+      q += size_t(count) * plySize(property.type);
+    }
+    p += size;
+  }
+  return size_t(p - data);
+}
+
+MeshData loadPly(std::string const& filename, size_t threads,
+                 MeshLoadStats* stats) {
+  double start = seconds();
+  MappedFile file(filename);
+  char const* data = file.data();
+  size_t size = file.size();
+
+  bool bigEndian = false;
+  size_t offset = 0;
+  std::vector<PlyElement> elements =
+      parsePlyHeader(data, size, bigEndian, offset);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+  bool swap = !bigEndian;
+#else
+  bool swap = bigEndian;
+#endif
+
+  MeshData mesh;
+  bool vertices = false, faces = false;
+  for (auto const& element : elements) {
+    if (vertices && faces) break;
+    char const* p = data + offset;
+    size_t bytes = size - offset;
+    if (element.name == "vertex") {
+      readPlyVertices(element, p, bytes, swap, threads, mesh);
+      offset += element.count * plyStride(element);
+      vertices = true;
+    } else if (element.name == "face") {
+      if (!vertices) throw "PLY faces before the vertices";
+      offset += readPlyFaces(element, p, bytes, swap, threads, mesh);
+      faces = true;
+    } else if (!hasLists(element)) {
+      size_t skip = element.count * plyStride(element);
+      if (skip > bytes) throw "PLY file ends within an element";
+      offset += skip;
+    } else {
+      for (size_t i = 0; i < element.count; ++i) {
+        size_t record = plyRecordSize(element, data + offset, data + size,
+                                      swap);
+        if (record == 0) throw "PLY file ends within an element";
+        offset += record;
+      }
+    }
+  }
+  if (!vertices) throw "PLY file without vertices";
+
+  finish(mesh, size, start, stats);
+  return mesh;
+}
+
+MeshData loadMesh(std::string const& filename, size_t threads,
+                  MeshLoadStats* stats) {
+  auto dot = filename.rfind('.');
+  std::string extension =
+      dot == std::string::npos ? "" : filename.substr(dot + 1);
+  for (char& c : extension) c = char(std::tolower(c));
+  if (extension == "obj") return loadObj(filename, threads, stats);
+  if (extension == "ply") return loadPly(filename, threads, stats);
+  throw "Unknown mesh file extension";
+}
+
+}  // namespace modelling
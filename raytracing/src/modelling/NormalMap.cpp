@@ -1,52 +1,103 @@
 #include <modelling/NormalMap.h>
 
+#include <algorithm>
 #include <cmath>
 
 namespace modelling {
 
-NormalMap::NormalMap(std::string filename, Interpolation interpolation)
-    : m_interpolation(interpolation) {
-  color::Image image = color::loadImage(filename);
-  size = image.size;
+using OctValue = TexelValue<2>;
 
-  values.resize(size.width * size.height);
+static float signNotZero(float v) { return v < 0.0f ? -1.0f : 1.0f; }
 
-  std::transform(image.data.begin(), image.data.end(), values.begin(),
-                 [](color::RGB const& rgb) { return geometry::Vector3D{rgb.r-0.5, rgb.g-0.5, rgb.b-0.5}; });
+// Octahedral mapping of the unit sphere to [-1, 1]^2, after Cigolle et al.,
+// "A Survey of Efficient Representations for Independent Unit Vectors"
+// (2014).
+static OctValue octEncode(float x, float y, float z) {
+  float l1 = std::abs(x) + std::abs(y) + std::abs(z);
+  if (l1 <= 0.0f) return OctValue{{0.0f, 0.0f}};
+  float u = x / l1;
+  float v = y / l1;
+  if (z < 0.0f) {
+    float fu = (1.0f - std::abs(v)) * signNotZero(u);
+    float fv = (1.0f - std::abs(u)) * signNotZero(v);
+    u = fu;
+    v = fv;
+  }
+  return OctValue{{u, v}};
 }
 
-geometry::Vector3D const NormalMap::get(geometry::Point2D const& p) const {
-  geometry::Coord x =
-      fmod(p.x, 1.0) * static_cast<geometry::Coord>(size.width - 1);
-  geometry::Coord y =
-      fmod(p.y, 1.0) * static_cast<geometry::Coord>(size.height - 1);
-
-  geometry::Coord x1 = std::floor(x);
-  geometry::Coord y1 = std::floor(y);
-  geometry::Coord rx = fmod(x, 1.0);
-  geometry::Coord ry = fmod(y, 1.0);
-
-  size_t u1 = static_cast<size_t>(x1);
-  size_t v1 = static_cast<size_t>(y1);
-  size_t u2 = static_cast<size_t>(std::ceil(x));
-  size_t v2 = static_cast<size_t>(std::ceil(y));
-
-  if (m_interpolation == Bilinear) {
-    return values[u1 + size.width * v1] * ((1.0 - rx) * (1.0 - ry)) +
-           values[u2 + size.width * v1] * ((rx) * (1.0 - ry)) +
-           values[u1 + size.width * v2] * ((1.0 - rx) * (ry)) +
-           values[u2 + size.width * v2] * ((rx) * (ry));
+static geometry::Vector3D octDecode(OctValue const& o) {
+  float u = o.c[0];
+  float v = o.c[1];
+  float z = 1.0f - std::abs(u) - std::abs(v);
+  if (z < 0.0f) {
+    float fu = (1.0f - std::abs(v)) * signNotZero(u);
+    float fv = (1.0f - std::abs(u)) * signNotZero(v);
+    u = fu;
+    v = fv;
   }
+  return {u, v, z};
+}
 
-  if (rx < 0.5) {
-    if (ry < 0.5)
-      return values[u1 + size.width * v1];
-    else
-      return values[u1 + size.width * v2];
-  }
-  if (ry < 0.5) return values[u2 + size.width * v1];
+static std::pair<std::vector<OctValue>, color::ImageSize> loadValues(
+    std::string const& filename) {
+  color::Image image = color::loadImage(filename);
+
+  std::vector<OctValue> values(image.size.width * image.size.height);
+  std::transform(image.data.begin(), image.data.end(), values.begin(),
+                 [](color::RGB const& rgb) {
+                   return octEncode(static_cast<float>(rgb.r - 0.5),
+                                    static_cast<float>(rgb.g - 0.5),
+                                    static_cast<float>(rgb.b - 0.5));
+                 });
+
+  return {std::move(values), image.size};
+}
+
+NormalMap::MipMaps NormalMap::load(
+    std::string const& filename,
+    std::shared_ptr<TextureCache const> const& cache) {
+  return loadMipMap<MipMaps, texel::SNorm16<2>>(
+      filename, cache, "oct16", [&] { return loadValues(filename); });
+}
+
+/**
+ * @brief Construct a new Normal Map:: Normal Map object
+ *
+ * @param filename
+ * @param interpolation
+ * @param cache
+ */
+NormalMap::NormalMap(std::string filename, Interpolation interpolation,
+                     std::shared_ptr<TextureCache const> cache)
+    : m_mipMap(load(filename, cache)), m_interpolation(interpolation) {}
+
+/**
+ * @brief Construct a new Normal Map:: Normal Map object
+ *
+ * @param pool
+ * @param filename
+ * @param interpolation
+ * @param cache
+ */
+NormalMap::NormalMap(platform::ThreadPool& pool, std::string filename,
+                     Interpolation interpolation,
+                     std::shared_ptr<TextureCache const> cache)
+    : m_mipMap(
+          pool.submit([filename, cache]() { return load(filename, cache); })
+              .share()),
+      m_interpolation(interpolation) {}
+
+geometry::Vector3D const NormalMap::get(geometry::TexCoord const& p) const {
+  bool bilinear = m_interpolation == Bilinear;
+  return octDecode(
+      std::visit([&](auto const& mipMap) { return mipMap.get(p, bilinear); },
+                 m_mipMap.get()));
+}
 
-  return values[u2 + size.width * v2];
+size_t NormalMap::memoryUsage() const {
+  return std::visit([](auto const& mipMap) { return mipMap.memoryUsage(); },
+                    m_mipMap.get());
 }
 
-}  // namespace modelling
\ No newline at end of file
+}  // namespace modelling
@@ -1,25 +1,36 @@
 
+#include <geometry/FastMath.h>
 #include <modelling/Primitive.h>
 
 namespace modelling {
 
 Primitive::Primitive(std::shared_ptr<Material> material,
-                     std::shared_ptr<NormalMap> normalMap)
-    : m_material(std::move(material)), m_normalMap(std::move(normalMap)) {}
+                     std::shared_ptr<NormalMap> normalMap, Shape shape)
+    : m_material(std::move(material)),
+      m_normalMap(std::move(normalMap)),
+      m_shape(shape) {}
 
 color::SColor Primitive::BRDF(geometry::Normal3D const& L,
                               geometry::Normal3D const& N,
                               geometry::Normal3D const& V,
-                              geometry::Point2D const& uv) const {
+                              geometry::TexCoord const& uv) const {
   return m_material->BRDF(L, N, V, uv);
 }
 
 Reflection Primitive::reflection(geometry::Normal3D const& N,
                                  geometry::Normal3D const& V,
-                                 geometry::Point2D const& uv) const {
+                                 geometry::TexCoord const& uv) const {
   return m_material->reflection(N, V, uv);
 }
 
+Reflection Primitive::reflection(geometry::Normal3D const& N,
+                                 geometry::Normal3D const& V,
+                                 geometry::TexCoord const& uv,
+                                 DirectionalDistribution const& guide,
+                                 color::Intensity bsdfFraction) const {
+  return m_material->reflection(N, V, uv, guide, bsdfFraction);
+}
+
 color::SColor Primitive::transparency() const {
   return m_material->transparency();
 }
@@ -28,11 +39,39 @@ bool Primitive::requiresUV() const {
   return m_material->requiresUV() || m_normalMap != nullptr;
 }
 
+color::Intensity Primitive::diffuseWeight() const {
+  return m_material->diffuseWeight();
+}
+
+color::SColor Primitive::diffuseColor(geometry::TexCoord const& uv) const {
+  return m_material->diffuseColor(uv);
+}
+
+geometry::Normal3D Primitive::normal(geometry::Point3D const& x,
+                                     geometry::TexCoord const&) const {
+  return normal(x);
+}
+
+Hit Primitive::hit(geometry::Ray const& ray) const {
+  return {intersect(ray), 0};
+}
+
+geometry::Point2D Primitive::getUV(geometry::Point3D const& x,
+                                   uint32_t) const {
+  return getUV(x);
+}
+
 geometry::Normal3D Primitive::normal(geometry::Point3D const& x,
-                                     geometry::Point2D const&) const {
+                                     uint32_t) const {
   return normal(x);
 }
 
+geometry::Normal3D Primitive::normal(geometry::Point3D const& x,
+                                     geometry::TexCoord const& uv,
+                                     uint32_t) const {
+  return normal(x, uv);
+}
+
 /**
  * @brief Construct a new Sphere:: Sphere object
  *
@@ -47,29 +86,32 @@ Sphere::Sphere(geometry::Point3D center, geometry::Coord radius,
                std::shared_ptr<Material> material,
                std::shared_ptr<NormalMap> normalMap)
     : geometry::Sphere(center, radius),
-      Primitive(std::move(material), std::move(normalMap)),
-      m_orientation(std::move(orientation)),
-      m_invOrientation(m_orientation.inv()) {}
+      Primitive(std::move(material), std::move(normalMap), Shape::Sphere),
+      m_invOrientation(geometry::Affine3D(orientation).inverse()) {}
 
 geometry::Point2D Sphere::getUV(geometry::Point3D const& x) const {
   geometry::Point3D p = m_invOrientation * ((x - m_center) / std::abs(m_radius));
-  geometry::Coord u = std::atan2(p.x, p.z) / (2 * M_PI) + 0.5;
+  geometry::Coord u = geometry::math::atan2(p.x, p.z) / (2 * M_PI) + 0.5;
   geometry::Coord v =
-      std::atan2(p.y, std::sqrt(p.x * p.x + p.z * p.z)) / M_PI + 0.5;
+      geometry::math::atan2(p.y, std::sqrt(p.x * p.x + p.z * p.z)) / M_PI +
+      0.5;
   return geometry::Point2D{u, 1.0 - v};
 }
 
 geometry::Normal3D Sphere::normal(geometry::Point3D const& x,
-                                  geometry::Point2D const& uv) const {
+                                  geometry::TexCoord const& uv) const {
   geometry::Normal3D n = geometry::Sphere::normal(x);
-  if (m_normalMap) {
-    geometry::Vector3D d = m_normalMap->get(uv);
-    geometry::Normal3D u = n % geometry::Vector3D{0, -1, 0};
-    geometry::Normal3D v = n % u;
-    n = geometry::Normal3D(u * d.x + v * d.y + n * d.z);
-  }
+  if (!m_normalMap) return n;
+
+  // Closed form of the frame u = n x (0, -1, 0), v = n x u.
+  geometry::Coord rho = std::sqrt(n.x * n.x + n.z * n.z);
+  geometry::Frame frame{{1, 0, 0}, {0, 0, 1}, n};
+  if (rho > 1e-12)
+    frame = {{n.z / rho, 0, -n.x / rho},
+             {-n.x * n.y / rho, rho, -n.y * n.z / rho},
+             n};
 
-  return n;
+  return geometry::Normal3D(frame.toWorld(m_normalMap->get(uv)));
 }
 
 static geometry::Matrix<2, 3> computeLinearUVMap(
@@ -90,6 +132,16 @@ static geometry::Matrix<2, 3> computeLinearUVMap(
        {DEF.values[0][0], DEF.values[1][0], DEF.values[2][0]}}};
 }
 
+// Orthonormalizes su and sv against the normal n, keeping the side of sv.
+static geometry::Frame tangentFrame(geometry::Normal3D const& n,
+                                    geometry::Vector3D const& su,
+                                    geometry::Vector3D const& sv) {
+  geometry::Normal3D t = su - n * (n * su);
+  geometry::Vector3D b = static_cast<geometry::Vector3D const&>(n) % t;
+  if (b * sv < 0.0) b = b * -1.0;
+  return {t, b, n};
+}
+
 /**
  * @brief Construct a new Triangle:: Triangle object
  *
@@ -110,46 +162,47 @@ Triangle::Triangle(geometry::Point3D p1, geometry::Point3D p2,
                    geometry::Point2D uv3, std::shared_ptr<NormalMap> normalMap,
                    geometry::Point3D su, geometry::Point3D sv)
     : geometry::Triangle(p1, p2, p3),
-      Primitive(std::move(material), std::move(normalMap)),
+      Primitive(std::move(material), std::move(normalMap), Shape::Triangle),
       m_uvMap(computeLinearUVMap(p1, p2, p3, uv1, uv2, uv3)),
-      m_su(su),
-      m_sv(sv) {}
+      m_frame(tangentFrame(geometry::Triangle::normal(p1), su, sv)) {}
 
 geometry::Point2D Triangle::getUV(geometry::Point3D const& x) const {
   return m_uvMap * x;
 }
 
 geometry::Normal3D Triangle::normal(geometry::Point3D const& x,
-                                    geometry::Point2D const& uv) const {
-  geometry::Normal3D n = geometry::Triangle::normal(x);
+                                    geometry::TexCoord const& uv) const {
+  if (!m_normalMap) return geometry::Triangle::normal(x);
 
-  if (!m_normalMap) return n;
-
-  geometry::Vector3D d = m_normalMap->get(uv);
-  return geometry::Normal3D(m_su * d.x + m_sv * d.y + n * d.z);
+  return geometry::Normal3D(m_frame.toWorld(m_normalMap->get(uv)));
 }
 
 Torus::Torus(geometry::Coord R, geometry::Coord r, geometry::Matrix<4, 4> view,
              std::shared_ptr<Material> material,
              std::shared_ptr<NormalMap> normalMap)
     : geometry::Torus(R, r),
-      Primitive(std::move(material), std::move(normalMap)),
-      m_view(std::move(view)),
-      m_invView(m_view.inv()) {}
+      Primitive(std::move(material), std::move(normalMap), Shape::Torus),
+      m_view(view),
+      m_invView(m_view.inverse()) {}
 
 geometry::Coord Torus::intersect(geometry::Ray const& ray) const {
-  geometry::Ray invRay = m_invView * ray;
+  // The hit along the object-space ray is t / scale along the world ray, as
+  // the inverse view stretches the unit direction by scale.
+  geometry::Vector3D d = m_invView.linear(ray.direction);
+  geometry::Coord scale = d.length();
+  geometry::Ray invRay{m_invView * ray.start,
+                       geometry::Normal3D::fromUnit(d / scale)};
   geometry::Coord t = geometry::Torus::intersect(invRay);
-  if (t <= 0.0) return t;
-  return (m_view * (invRay.start + t * invRay.direction) - ray.start).length();
+  return t <= 0.0 ? t : t / scale;
 }
 
 geometry::Point2D Torus::getUV(geometry::Point3D const& x) const {
   geometry::Point3D p = m_invView * x;
 
-  geometry::Coord u = std::atan2(p.y, p.x) / (2 * M_PI) + 0.5;
+  geometry::Coord u = geometry::math::atan2(p.y, p.x) / (2 * M_PI) + 0.5;
   geometry::Coord z = 0.9999 * std::max(-1.0, std::min(1.0, -p.z / r));
-  geometry::Coord v = std::asin(z) / (M_PI * 2) + 0.5;  // 0.25 .. 0.75
+  geometry::Coord v =
+      geometry::math::asin(z) / (M_PI * 2) + 0.5;  // 0.25 .. 0.75
 
   if (p.x * p.x + p.y * p.y < R * R) {
     if (v > 0.5)
@@ -161,23 +214,28 @@ geometry::Point2D Torus::getUV(geometry::Point3D const& x) const {
   return geometry::Point2D{u, v};
 }
 
+geometry::Normal3D Torus::normal(geometry::Point3D const& x) const {
+  return m_view * geometry::Torus::normal(m_invView * x);
+}
+
 geometry::Normal3D Torus::normal(geometry::Point3D const& x,
-                                 geometry::Point2D const& uv) const {
+                                 geometry::TexCoord const& uv) const {
   geometry::Point3D p = m_invView * x;
   geometry::Normal3D n = geometry::Torus::normal(p);
-
-  if (m_normalMap) {
-    geometry::Vector3D d = m_normalMap->get(uv);
-    geometry::Normal3D u = n % geometry::Vector3D{0, 0, -1};
-    if (p.x * p.x + p.y * p.y < R * R) u = -u;
-    geometry::Normal3D v = n % u;
-
-    n = geometry::Normal3D(u * d.x + v * d.y + n * d.z);
-    // std::cout << uv.x << " " << uv.y << " " << d << " " << u << " " << v <<
-    // " " << n << std::endl;
+  if (!m_normalMap) return m_view * n;
+
+  // Closed form of the frame u = n x (0, 0, -1), v = n x u; u is flipped on
+  // the inner half.
+  geometry::Coord rho = std::sqrt(n.x * n.x + n.y * n.y);
+  geometry::Frame frame{{1, 0, 0}, {0, 1, 0}, n};
+  if (rho > 1e-12) {
+    geometry::Coord s = p.x * p.x + p.y * p.y < R * R ? -1.0 : 1.0;
+    frame = {{-s * n.y / rho, s * n.x / rho, 0},
+             {-s * n.z * n.x / rho, -s * n.z * n.y / rho, s * rho},
+             n};
   }
-  // std::cout << n.length() << std::endl;
-  return m_view * n;
+
+  return m_view * geometry::Normal3D(frame.toWorld(m_normalMap->get(uv)));
 }
 
 }  // namespace modelling
\ No newline at end of file
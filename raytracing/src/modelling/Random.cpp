@@ -0,0 +1,18 @@
+#include <modelling/Random.h>
+
+#include <random>
+
+namespace modelling {
+
+uint64_t sampleSeed(uint64_t pixel, uint64_t sample) {
+  RandomStream mix(pixel * 0x2545f4914f6cdd1dull + sample);
+  return mix.next();
+}
+
+RandomStream& threadRandom() {
+  static thread_local RandomStream stream(
+      (uint64_t(std::random_device{}()) << 32) | std::random_device{}());
+  return stream;
+}
+
+}  // namespace modelling
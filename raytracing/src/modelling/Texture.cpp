@@ -1,52 +1,93 @@
 #include <modelling/Texture.h>
 
-#include <cmath>
+#include <algorithm>
 
 namespace modelling {
 
-Texture::Texture(std::string filename, Interpolation interpolation)
-    : m_interpolation(interpolation) {
-  color::Image image = color::loadImage(filename);
-  size = image.size;
+using RGBValue = TexelValue<3>;
 
-  values.resize(size.width * size.height);
+static std::pair<std::vector<RGBValue>, color::ImageSize> loadValues(
+    std::string const& filename, Texture::Format format) {
+  color::Image image = color::loadImage(filename);
 
+  std::vector<RGBValue> values(image.size.width * image.size.height);
   std::transform(image.data.begin(), image.data.end(), values.begin(),
-                 [](color::RGB const& rgb) { return color::SColor(rgb); });
+                 [](color::RGB const& rgb) {
+                   return RGBValue{{static_cast<float>(rgb.r),
+                                    static_cast<float>(rgb.g),
+                                    static_cast<float>(rgb.b)}};
+                 });
+
+  // The values were read as value / 255; undo that before encoding.
+  if (format == Texture::SRGB8)
+    for (auto& v : values)
+      for (auto& c : v.c) c = texel::srgb8Table[texel::quantize(c)];
+
+  return {std::move(values), image.size};
 }
 
-color::SColor const Texture::get(geometry::Point2D const& p) const {
-  geometry::Coord x =
-      fmod(p.x, 1.0) * static_cast<geometry::Coord>(size.width - 1);
-  geometry::Coord y =
-      fmod(p.y, 1.0) * static_cast<geometry::Coord>(size.height - 1);
-
-  geometry::Coord x1 = std::floor(x);
-  geometry::Coord y1 = std::floor(y);
-  geometry::Coord rx = fmod(x, 1.0);
-  geometry::Coord ry = fmod(y, 1.0);
-
-  size_t u1 = static_cast<size_t>(x1);
-  size_t v1 = static_cast<size_t>(y1);
-  size_t u2 = static_cast<size_t>(std::ceil(x));
-  size_t v2 = static_cast<size_t>(std::ceil(y));
-
-  if (m_interpolation == Bilinear) {
-    return values[u1 + size.width * v1] * ((1.0 - rx) * (1.0 - ry)) +
-           values[u2 + size.width * v1] * ((rx) * (1.0 - ry)) +
-           values[u1 + size.width * v2] * ((1.0 - rx) * (ry)) +
-           values[u2 + size.width * v2] * ((rx) * (ry));
-  }
+Texture::MipMaps Texture::load(std::string const& filename, Format format,
+                               std::shared_ptr<TextureCache const> const& cache) {
+  auto values = [&] { return loadValues(filename, format); };
 
-  if (rx < 0.5) {
-    if (ry < 0.5)
-      return values[u1 + size.width * v1];
-    else
-      return values[u1 + size.width * v2];
+  switch (format) {
+    case SRGB8:
+      return loadMipMap<MipMaps, texel::SRGB8<3>>(filename, cache, "srgb8",
+                                                  values);
+    case Half:
+      return loadMipMap<MipMaps, texel::Half<3>>(filename, cache, "half",
+                                                 values);
+    case Float:
+      return loadMipMap<MipMaps, texel::Float<3>>(filename, cache, "float",
+                                                  values);
+    default:
+      return loadMipMap<MipMaps, texel::UNorm8<3>>(filename, cache, "unorm8",
+                                                   values);
   }
-  if (ry < 0.5) return values[u2 + size.width * v1];
+}
+
+/**
+ * @brief Construct a new Texture:: Texture object
+ *
+ * @param filename
+ * @param interpolation
+ * @param format
+ * @param cache
+ */
+Texture::Texture(std::string filename, Interpolation interpolation,
+                 Format format, std::shared_ptr<TextureCache const> cache)
+    : m_mipMap(load(filename, format, cache)),
+      m_interpolation(interpolation) {}
+
+/**
+ * @brief Construct a new Texture:: Texture object
+ *
+ * @param pool
+ * @param filename
+ * @param interpolation
+ * @param format
+ * @param cache
+ */
+Texture::Texture(platform::ThreadPool& pool, std::string filename,
+                 Interpolation interpolation, Format format,
+                 std::shared_ptr<TextureCache const> cache)
+    : m_mipMap(pool.submit([filename, format, cache]() {
+                     return load(filename, format, cache);
+                   })
+                   .share()),
+      m_interpolation(interpolation) {}
+
+color::SColor const Texture::get(geometry::TexCoord const& p) const {
+  bool bilinear = m_interpolation == Bilinear;
+  RGBValue v =
+      std::visit([&](auto const& mipMap) { return mipMap.get(p, bilinear); },
+                 m_mipMap.get());
+  return color::RGB(v.c[0], v.c[1], v.c[2]);
+}
 
-  return values[u2 + size.width * v2];
+size_t Texture::memoryUsage() const {
+  return std::visit([](auto const& mipMap) { return mipMap.memoryUsage(); },
+                    m_mipMap.get());
 }
 
-}  // namespace modelling
\ No newline at end of file
+}  // namespace modelling
@@ -0,0 +1,283 @@
+#include <modelling/TextureCache.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace modelling {
+
+// The last character versions the layout and the pyramid filter; files of
+// other versions are converted again.
+static const char Magic[8] = {'R', 'T', 'T', 'I', 'L', 'E', 'S', '2'};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t texelSize;
+  uint64_t levels;
+};
+
+struct FileLevel {
+  uint64_t width;
+  uint64_t height;
+  uint64_t offset;
+};
+
+static std::atomic<uint64_t> nextFileId{1};
+
+/**
+ * @brief Construct a new Tiled Image File:: Tiled Image File object
+ *
+ * @param path
+ * @param texelSize
+ */
+TiledImageFile::TiledImageFile(std::string const& path, size_t texelSize)
+    : m_fd(::open(path.c_str(), O_RDONLY)),
+      m_texelSize(texelSize),
+      m_id(nextFileId++) {
+  if (m_fd < 0) throw "Cannot open tiled texture file";
+
+  FileHeader header;
+  bool valid = ::pread(m_fd, &header, sizeof(header), 0) ==
+                   static_cast<ssize_t>(sizeof(header)) &&
+               std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 &&
+               header.texelSize == texelSize && header.levels > 0 &&
+               header.levels <= 64;
+
+  for (uint64_t i = 0; valid && i < header.levels; ++i) {
+    FileLevel level;
+    off_t at = static_cast<off_t>(sizeof(header) + i * sizeof(level));
+    valid = ::pread(m_fd, &level, sizeof(level), at) ==
+            static_cast<ssize_t>(sizeof(level));
+    color::ImageSize size{level.width, level.height};
+    m_levels.push_back({size, pagesPerRow(size), pageRows(size), level.offset});
+  }
+
+  if (!valid) {
+    ::close(m_fd);
+    throw "Invalid tiled texture file";
+  }
+}
+
+TiledImageFile::~TiledImageFile() { ::close(m_fd); }
+
+/**
+ * @brief Construct a new Tiled Image File:: Writer object
+ *
+ * @param path
+ * @param texelSize
+ * @param sizes
+ */
+TiledImageFile::Writer::Writer(std::string const& path, size_t texelSize,
+                               std::vector<color::ImageSize> const& sizes)
+    : m_path(path), m_temporary(path + ".tmp"), m_remaining(0) {
+  FileHeader header;
+  std::memcpy(header.magic, Magic, sizeof(Magic));
+  header.texelSize = texelSize;
+  header.levels = sizes.size();
+
+  // Write to a temporary file first so that readers never see a partial one.
+  m_out.open(m_temporary, std::ios::binary | std::ios::trunc);
+  if (!m_out) throw "Cannot write tiled texture file";
+
+  m_out.write(reinterpret_cast<char const*>(&header), sizeof(header));
+  uint64_t offset = sizeof(header) + sizes.size() * sizeof(FileLevel);
+  for (color::ImageSize size : sizes) {
+    FileLevel level{size.width, size.height, offset};
+    m_out.write(reinterpret_cast<char const*>(&level), sizeof(level));
+    uint64_t bytes =
+        pagesPerRow(size) * pageRows(size) * PageSize * PageSize * texelSize;
+    offset += bytes;
+    m_remaining += bytes;
+  }
+}
+
+TiledImageFile::Writer::~Writer() {
+  if (m_out.is_open()) {
+    m_out.close();
+    std::error_code error;
+    std::filesystem::remove(m_temporary, error);
+  }
+}
+
+void TiledImageFile::Writer::append(unsigned char const* pages, size_t bytes) {
+  if (bytes > m_remaining) throw "Too many pages for tiled texture file";
+  m_out.write(reinterpret_cast<char const*>(pages),
+              static_cast<std::streamsize>(bytes));
+  m_remaining -= bytes;
+}
+
+void TiledImageFile::Writer::finish() {
+  if (m_remaining != 0) throw "Missing pages in tiled texture file";
+  m_out.close();
+  if (!m_out) {
+    std::error_code error;
+    std::filesystem::remove(m_temporary, error);
+    throw "Cannot write tiled texture file";
+  }
+  std::filesystem::rename(m_temporary, m_path);
+}
+
+bool TiledImageFile::upToDate(std::string const& path,
+                              std::string const& source) {
+  std::error_code error;
+  auto tiled = std::filesystem::last_write_time(path, error);
+  if (error) return false;
+  auto original = std::filesystem::last_write_time(source, error);
+  return error || tiled >= original;
+}
+
+void TiledImageFile::readPage(size_t level, size_t page,
+                              unsigned char* out) const {
+  size_t bytes = pageBytes();
+  off_t at = static_cast<off_t>(m_levels[level].offset + page * bytes);
+  if (::pread(m_fd, out, bytes, at) != static_cast<ssize_t>(bytes))
+    throw "Cannot read tiled texture file";
+}
+
+struct alignas(64) TextureCache::Shard {
+  struct Entry {
+    uint64_t key;
+    Page page;
+  };
+
+  std::mutex mutex;
+  // Most recently used first.
+  std::list<Entry> lru;
+  std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+  size_t residentBytes = 0;
+
+  std::atomic<size_t> hits{0};
+  std::atomic<size_t> misses{0};
+  std::atomic<size_t> evictions{0};
+};
+
+static uint64_t pageKey(uint64_t file, size_t level, size_t page) {
+  return (file << 48) | (static_cast<uint64_t>(level) << 40) | page;
+}
+
+static size_t shardIndex(uint64_t key, size_t shards) {
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdull;
+  key ^= key >> 33;
+  return static_cast<size_t>(key % shards);
+}
+
+/**
+ * @brief Construct a new Texture Cache:: Texture Cache object
+ *
+ * @param byteBudget
+ * @param directory
+ */
+TextureCache::TextureCache(size_t byteBudget, std::string directory)
+    : m_byteBudget(byteBudget),
+      m_directory(std::move(directory)),
+      m_shards(new Shard[Shards]) {}
+
+TextureCache::~TextureCache() = default;
+
+unsigned char const* TextureCache::page(TiledImageFile const& file,
+                                        size_t level, size_t page) const {
+  // The page a thread used last; the shared pointer keeps it alive even if
+  // it is evicted meanwhile.
+  struct Last {
+    TextureCache const* cache = nullptr;
+    uint64_t key = 0;
+    Page page;
+  };
+  static thread_local Last last;
+
+  uint64_t key = pageKey(file.id(), level, page);
+  if (last.cache == this && last.key == key) return last.page->data();
+
+  Shard& shard = m_shards[shardIndex(key, Shards)];
+  Page result;
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+      result = it->second->page;
+    }
+  }
+
+  if (result) {
+    shard.hits.fetch_add(1, std::memory_order_relaxed);
+  } else {
+    shard.misses.fetch_add(1, std::memory_order_relaxed);
+
+    // Read without holding the lock; another thread may load the same page
+    // concurrently, in which case its copy is kept.
+    auto texels = std::make_shared<std::vector<unsigned char>>(file.pageBytes());
+    file.readPage(level, page, texels->data());
+    result = texels;
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+      result = it->second->page;
+    } else {
+      shard.lru.push_front({key, result});
+      shard.index.emplace(key, shard.lru.begin());
+      shard.residentBytes += result->size();
+
+      size_t budget = m_byteBudget / Shards;
+      while (shard.residentBytes > budget && shard.lru.size() > 1) {
+        Shard::Entry const& victim = shard.lru.back();
+        shard.residentBytes -= victim.page->size();
+        shard.index.erase(victim.key);
+        shard.lru.pop_back();
+        shard.evictions.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  last.cache = this;
+  last.key = key;
+  last.page = std::move(result);
+  return last.page->data();
+}
+
+std::string TextureCache::tiledPath(std::string const& source,
+                                    std::string const& tag) const {
+  std::filesystem::path path(source);
+  if (!m_directory.empty())
+    path = std::filesystem::path(m_directory) / path.filename();
+  return path.string() + "." + tag + ".tiles";
+}
+
+TextureCacheStats TextureCache::stats() const {
+  TextureCacheStats stats{0, 0, 0, 0};
+  for (size_t i = 0; i < Shards; ++i) {
+    Shard& shard = m_shards[i];
+    stats.hits += shard.hits.load(std::memory_order_relaxed);
+    stats.misses += shard.misses.load(std::memory_order_relaxed);
+    stats.evictions += shard.evictions.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    stats.residentBytes += shard.residentBytes;
+  }
+  return stats;
+}
+
+size_t TextureCache::residentBytes(TiledImageFile const& file) const {
+  size_t bytes = 0;
+  for (size_t i = 0; i < Shards; ++i) {
+    Shard& shard = m_shards[i];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (Shard::Entry const& entry : shard.lru)
+      if (entry.key >> 48 == file.id()) bytes += entry.page->size();
+  }
+  return bytes;
+}
+
+void TextureCache::resetStats() {
+  for (size_t i = 0; i < Shards; ++i) {
+    m_shards[i].hits = 0;
+    m_shards[i].misses = 0;
+    m_shards[i].evictions = 0;
+  }
+}
+
+}  // namespace modelling
@@ -0,0 +1,78 @@
+#include <platform/Cpu.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace platform {
+
+static IsaLevel detect() {
+#if RAYTRACING_MULTIVERSIONING
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") &&
+      __builtin_cpu_supports("avx512vl") &&
+      __builtin_cpu_supports("avx512bw") &&
+      __builtin_cpu_supports("avx512dq"))
+    return IsaLevel::AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return IsaLevel::AVX2;
+  if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+    return IsaLevel::SSE4;
+#endif
+  return IsaLevel::Baseline;
+}
+
+// The level of RAYTRACING_ISA up to the detected one; an unknown name is
+// ignored.
+static IsaLevel initialLevel() {
+  IsaLevel detected = detectedIsaLevel();
+  char const* name = std::getenv("RAYTRACING_ISA");
+  if (!name) return detected;
+  try {
+    return std::min(parseIsaLevel(name), detected);
+  } catch (char const*) {
+    return detected;
+  }
+}
+
+static std::atomic<IsaLevel>& activeLevel() {
+  static std::atomic<IsaLevel> level{initialLevel()};
+  return level;
+}
+
+IsaLevel detectedIsaLevel() {
+  static const IsaLevel level = detect();
+  return level;
+}
+
+IsaLevel isaLevel() {
+  return activeLevel().load(std::memory_order_relaxed);
+}
+
+void forceIsaLevel(IsaLevel level) {
+  if (level > detectedIsaLevel())
+    throw "Instruction set level not supported by this CPU";
+  activeLevel().store(level, std::memory_order_relaxed);
+}
+
+char const* isaLevelName(IsaLevel level) {
+  switch (level) {
+    case IsaLevel::SSE4:
+      return "sse4";
+    case IsaLevel::AVX2:
+      return "avx2";
+    case IsaLevel::AVX512:
+      return "avx512";
+    default:
+      return "baseline";
+  }
+}
+
+IsaLevel parseIsaLevel(std::string_view name) {
+  for (IsaLevel level : {IsaLevel::Baseline, IsaLevel::SSE4, IsaLevel::AVX2,
+                         IsaLevel::AVX512})
+    if (name == isaLevelName(level)) return level;
+  throw "Unknown instruction set level";
+}
+
+}  // namespace platform
@@ -0,0 +1,161 @@
+#include <platform/Trace.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace platform {
+
+namespace trace {
+
+namespace {
+
+// Ring buffer written by one thread at a time. A thread takes a lane when
+// it first records and gives it back when it exits, so the workers of
+// successive parallelFor() calls share lanes and the timeline keeps one row
+// per concurrently running thread.
+struct Lane {
+  size_t id = 0;
+  // Lanes of an earlier start() are cleared before they are written again.
+  std::atomic<uint64_t> generation{0};
+  size_t capacity = 0;
+  std::unique_ptr<Event[]> events;
+  std::atomic<uint64_t> written{0};
+};
+
+std::mutex mutex;
+std::vector<std::unique_ptr<Lane>> lanes;
+std::vector<Lane*> freeLanes;
+
+std::atomic<size_t> capacity{0};
+
+struct LaneHolder {
+  Lane* lane = nullptr;
+
+  ~LaneHolder() {
+    if (!lane) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    freeLanes.push_back(lane);
+  }
+};
+
+thread_local LaneHolder holder;
+
+Lane* threadLane() {
+  if (holder.lane) return holder.lane;
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (freeLanes.empty()) {
+    lanes.push_back(std::make_unique<Lane>());
+    lanes.back()->id = lanes.size() - 1;
+    holder.lane = lanes.back().get();
+  } else {
+    holder.lane = freeLanes.back();
+    freeLanes.pop_back();
+  }
+  return holder.lane;
+}
+
+}  // namespace
+
+void start(size_t eventsPerThread) {
+  active.store(false);
+  capacity.store(std::max<size_t>(1, eventsPerThread));
+  epoch.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                  std::chrono::steady_clock::now().time_since_epoch())
+                  .count());
+  ++generation;
+  active.store(true);
+}
+
+void stop() { active.store(false); }
+
+void record(Event const& event) {
+  Lane* lane = threadLane();
+
+  uint64_t current = generation.load(std::memory_order_acquire);
+  if (lane->generation.load(std::memory_order_relaxed) != current) {
+    size_t n = capacity.load(std::memory_order_relaxed);
+    if (lane->capacity != n) {
+      lane->events = std::make_unique<Event[]>(n);
+      lane->capacity = n;
+    }
+    lane->written.store(0, std::memory_order_relaxed);
+    lane->generation.store(current, std::memory_order_release);
+  }
+
+  uint64_t n = lane->written.load(std::memory_order_relaxed);
+  lane->events[n % lane->capacity] = event;
+  lane->written.store(n + 1, std::memory_order_release);
+}
+
+static void writeString(std::ostream& out, char const* s) {
+  static char const hex[] = "0123456789abcdef";
+  out << '"';
+  for (; *s; ++s) {
+    auto c = static_cast<unsigned char>(*s);
+    if (c == '"' || c == '\\')
+      out << '\\' << *s;
+    else if (c < 0x20)
+      out << "\\u00" << hex[c >> 4] << hex[c & 15];
+    else
+      out << *s;
+  }
+  out << '"';
+}
+
+// Trace event times are in microseconds.
+static void writeMicroseconds(std::ostream& out, uint64_t ns) {
+  char fraction[4] = {char('0' + ns / 100 % 10), char('0' + ns / 10 % 10),
+                      char('0' + ns % 10), 0};
+  out << ns / 1000 << '.' << fraction;
+}
+
+void writeJSON(std::ostream& out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  uint64_t current = generation.load(std::memory_order_acquire);
+
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  out << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, "
+         "\"args\": {\"name\": \"raytracing\"}}";
+
+  for (auto const& lane : lanes) {
+    if (lane->generation.load(std::memory_order_acquire) != current)
+      continue;
+
+    out << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+        << "\"tid\": " << lane->id << ", \"args\": {\"name\": \"thread "
+        << lane->id << "\"}}";
+
+    uint64_t written = lane->written.load(std::memory_order_acquire);
+    uint64_t first = written > lane->capacity ? written - lane->capacity : 0;
+    for (uint64_t n = first; n < written; ++n) {
+      Event const& event = lane->events[n % lane->capacity];
+      out << ",\n{\"name\": ";
+      writeString(out, event.name);
+      out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << lane->id
+          << ", \"ts\": ";
+      writeMicroseconds(out, event.begin);
+      out << ", \"dur\": ";
+      writeMicroseconds(out, event.duration);
+      if (event.index >= 0 || event.detail[0]) {
+        out << ", \"args\": {";
+        if (event.index >= 0) out << "\"index\": " << event.index;
+        if (event.index >= 0 && event.detail[0]) out << ", ";
+        if (event.detail[0]) {
+          out << "\"detail\": ";
+          writeString(out, event.detail);
+        }
+        out << "}";
+      }
+      out << "}";
+    }
+  }
+  out << "\n]}\n";
+}
+
+}  // namespace trace
+
+}  // namespace platform
@@ -0,0 +1,146 @@
+#include <rendering/Checkpoint.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace rendering {
+
+static const char Magic[8] = {'R', 'T', 'A', 'C', 'C', 'U', 'M', '1'};
+
+struct FileHeader {
+  char magic[8];
+  uint64_t width;
+  uint64_t height;
+  uint64_t fingerprint;
+  uint64_t reserved[4];
+};
+
+static double seconds() {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Construct a new Accumulation Buffer:: Accumulation Buffer object
+ *
+ * @param path
+ * @param size
+ * @param fingerprint
+ */
+AccumulationBuffer::AccumulationBuffer(std::string const& path,
+                                       color::ImageSize size,
+                                       uint64_t fingerprint)
+    : m_size(size),
+      m_fd(::open(path.c_str(), O_RDWR | O_CREAT, 0644)),
+      m_bytes(sizeof(FileHeader) + size.width * size.height * sizeof(Pixel)),
+      m_map(MAP_FAILED),
+      m_pixels(nullptr),
+      m_resumed(false),
+      m_lastFlush(seconds()) {
+  if (m_fd < 0) throw "Cannot open checkpoint file";
+
+  struct stat info;
+  if (::fstat(m_fd, &info) != 0) {
+    ::close(m_fd);
+    throw "Cannot open checkpoint file";
+  }
+
+  FileHeader header{};
+  if (info.st_size > 0) {
+    bool valid = static_cast<size_t>(info.st_size) == m_bytes &&
+                 ::pread(m_fd, &header, sizeof(header), 0) ==
+                     static_cast<ssize_t>(sizeof(header)) &&
+                 std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 &&
+                 header.width == size.width && header.height == size.height &&
+                 header.fingerprint == fingerprint;
+    if (!valid) {
+      ::close(m_fd);
+      throw "Checkpoint file belongs to a different render";
+    }
+    m_resumed = true;
+  } else {
+    // A new file reads as zeros, that is, no samples in any pixel.
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.width = size.width;
+    header.height = size.height;
+    header.fingerprint = fingerprint;
+    if (::ftruncate(m_fd, static_cast<off_t>(m_bytes)) != 0 ||
+        ::pwrite(m_fd, &header, sizeof(header), 0) !=
+            static_cast<ssize_t>(sizeof(header))) {
+      ::close(m_fd);
+      throw "Cannot write checkpoint file";
+    }
+  }
+
+  m_map = ::mmap(nullptr, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (m_map == MAP_FAILED) {
+    ::close(m_fd);
+    throw "Cannot map checkpoint file";
+  }
+  m_pixels = reinterpret_cast<Pixel*>(static_cast<char*>(m_map) +
+                                      sizeof(FileHeader));
+}
+
+AccumulationBuffer::~AccumulationBuffer() {
+  ::msync(m_map, m_bytes, MS_SYNC);
+  ::munmap(m_map, m_bytes);
+  ::close(m_fd);
+}
+
+AccumulationBuffer::Pixel AccumulationBuffer::get(size_t x, size_t y) const {
+  return m_pixels[y * m_size.width + x];
+}
+
+void AccumulationBuffer::set(size_t x, size_t y, Pixel const& pixel) {
+  Pixel* target = &m_pixels[y * m_size.width + x];
+#ifdef __SSE2__
+  _mm_store_si128(reinterpret_cast<__m128i*>(target),
+                  _mm_load_si128(reinterpret_cast<__m128i const*>(&pixel)));
+#else
+  *target = pixel;
+#endif
+}
+
+void AccumulationBuffer::flush() {
+  std::lock_guard<std::mutex> lock(m_flushMutex);
+  if (::msync(m_map, m_bytes, MS_SYNC) != 0)
+    throw "Cannot write checkpoint file";
+  m_lastFlush = seconds();
+}
+
+void AccumulationBuffer::flushEvery(double interval) {
+  std::unique_lock<std::mutex> lock(m_flushMutex, std::try_to_lock);
+  // Another thread is flushing already.
+  if (!lock.owns_lock() || seconds() - m_lastFlush < interval) return;
+  if (::msync(m_map, m_bytes, MS_SYNC) != 0)
+    throw "Cannot write checkpoint file";
+  m_lastFlush = seconds();
+}
+
+color::Framebuffer AccumulationBuffer::framebuffer(
+    color::Framebuffer::Storage storage) const {
+  color::Framebuffer framebuffer(m_size, storage);
+  for (size_t y = 0; y < m_size.height; ++y) {
+    for (size_t x = 0; x < m_size.width; ++x) {
+      Pixel pixel = get(x, y);
+      if (pixel.samples == 0) continue;
+      double scale = 1.0 / pixel.samples;
+      framebuffer.set(x, y,
+                      color::RGB(pixel.sum[0] * scale, pixel.sum[1] * scale,
+                                 pixel.sum[2] * scale));
+    }
+  }
+  return framebuffer;
+}
+
+}  // namespace rendering
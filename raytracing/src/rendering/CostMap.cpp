@@ -0,0 +1,67 @@
+#include <rendering/CostMap.h>
+
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+
+namespace rendering {
+
+// Black, purple, red, orange, pale yellow, roughly the inferno colormap.
+static void heatColor(float v, uint8_t* rgb) {
+  static const float stops[5][3] = {{0.0f, 0.0f, 0.02f},
+                                    {0.34f, 0.06f, 0.43f},
+                                    {0.73f, 0.21f, 0.33f},
+                                    {0.98f, 0.55f, 0.04f},
+                                    {0.99f, 1.0f, 0.64f}};
+  float x = std::min(std::max(v, 0.0f), 1.0f) * 4.0f;
+  size_t i = std::min<size_t>(static_cast<size_t>(x), 3);
+  float f = x - static_cast<float>(i);
+  for (size_t c = 0; c < 3; ++c)
+    rgb[c] = static_cast<uint8_t>(
+        255.0f * (stops[i][c] + f * (stops[i + 1][c] - stops[i][c])) + 0.5f);
+}
+
+static void saveHeatmap(std::string const& filename, color::ImageSize size,
+                        std::vector<float> const& values) {
+  std::vector<float> sorted(values);
+  size_t at = sorted.empty() ? 0 : (sorted.size() - 1) * 99 / 100;
+  float scale = 0.0f;
+  if (!sorted.empty()) {
+    std::nth_element(sorted.begin(), sorted.begin() + long(at), sorted.end());
+    scale = sorted[at];
+  }
+  if (scale <= 0.0f) scale = 1.0f;
+
+  std::vector<uint8_t> rgb(3 * values.size());
+  for (size_t i = 0; i < values.size(); ++i)
+    heatColor(values[i] / scale, &rgb[3 * i]);
+  color::saveImage(filename, size, rgb);
+}
+
+void CostMap::saveHeatmaps(std::string const& prefix) const {
+  saveHeatmap(prefix + "_time.png", size, nanoseconds);
+  saveHeatmap(prefix + "_tests.png", size, tests);
+  saveHeatmap(prefix + "_depth.png", size, depth);
+}
+
+void CostMap::writeTable(std::ostream& out) const {
+  static char const* shapes[] = {"sphere", "triangle", "torus", "mesh", "other"};
+
+  double total = 0.0;
+  for (auto const& p : primitives) total += p.seconds;
+
+  std::vector<PrimitiveCost> sorted(primitives);
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](PrimitiveCost const& a, PrimitiveCost const& b) {
+                     return a.seconds > b.seconds;
+                   });
+
+  out << "index,shape,tests,hits,pixels,seconds,time_share,us_per_pixel\n";
+  for (auto const& p : sorted)
+    out << p.index << "," << shapes[size_t(p.shape)] << "," << p.tests << ","
+        << p.hits << "," << p.pixels << "," << p.seconds << ","
+        << (total > 0.0 ? p.seconds / total : 0.0) << ","
+        << (p.pixels ? 1e6 * p.seconds / double(p.pixels) : 0.0) << "\n";
+}
+
+}  // namespace rendering
@@ -0,0 +1,240 @@
+#include <modelling/Random.h>
+#include <rendering/IrradianceCache.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace rendering {
+
+static const size_t MaxOctreeDepth = 20;
+
+struct IrradianceCache::Node {
+  geometry::Point3D center;
+  geometry::Coord halfSize;
+  std::unique_ptr<Node> children[8];
+  std::vector<Record> records;
+};
+
+static bool contains(geometry::Point3D const& center, geometry::Coord halfSize,
+                     geometry::Point3D const& x) {
+  // Without short circuits: the outcome is hard to predict.
+  return std::max({std::abs(x.x - center.x), std::abs(x.y - center.y),
+                   std::abs(x.z - center.z)}) <= halfSize;
+}
+
+static geometry::Vector3D componentwise(std::array<color::SColor, 3> const& g,
+                                        size_t lambda) {
+  return {g[0].intensities()[lambda], g[1].intensities()[lambda],
+          g[2].intensities()[lambda]};
+}
+
+/**
+ * @brief Construct a new Irradiance Cache:: Irradiance Cache object
+ *
+ * @param min
+ * @param max
+ * @param settings
+ */
+IrradianceCache::IrradianceCache(geometry::Point3D min, geometry::Point3D max,
+                                 IrradianceCacheSettings const& settings)
+    : m_settings(settings), m_root(std::make_unique<Node>()), m_size(0) {
+  geometry::Vector3D extent = max - min;
+  m_root->center = (min + max) * 0.5;
+  m_root->halfSize = std::max({extent.x, extent.y, extent.z}) * 0.5;
+}
+
+IrradianceCache::~IrradianceCache() = default;
+
+bool IrradianceCache::lookup(geometry::Point3D const& x,
+                             geometry::Normal3D const& n,
+                             color::SColor& value) const {
+  std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+  color::SColor sum(0.0);
+  double sumWeight = 0.0;
+  double a = m_settings.accuracy;
+
+  auto visit = [&](Node const& node, auto const& self) -> void {
+    for (Record const& record : node.records) {
+      geometry::Vector3D d = x - record.x;
+      // Most records are out of reach; reject them before the square roots.
+      geometry::Coord reach = a * record.radius;
+      if (d * d >= reach * reach) continue;
+      geometry::Coord nn = n * record.n;
+      double error = d.length() / record.radius +
+                     std::sqrt(std::max(0.0, 1.0 - nn));
+      if (error >= a) continue;
+
+      // Skip records in front of x.
+      if (d * (n + record.n) * 0.5 < -0.01 * record.radius) continue;
+
+      double w = error > 1e-9 ? 1.0 / error : 1e9;
+      geometry::Vector3D axis =
+          static_cast<geometry::Vector3D const&>(record.n) % n;
+      // In place: spectra are heap-backed, temporaries are not free.
+      color::Intensities& out = sum.intensities();
+      color::Intensities const& in = record.value.intensities();
+      for (size_t l = 0; l < out.size(); ++l)
+        out[l] += w * (in[l] + axis * componentwise(record.rotation, l) +
+                       d * componentwise(record.translation, l));
+      sumWeight += w;
+    }
+
+    // Records are stored in the deepest node not smaller than their radius
+    // of influence, so only nodes within one node size of x can hold one.
+    for (auto const& child : node.children)
+      if (child && contains(child->center, 2.0 * child->halfSize, x))
+        self(*child, self);
+  };
+  visit(*m_root, visit);
+
+  if (sumWeight <= 0.0) return false;
+
+  value = sum / sumWeight;
+  for (auto& i : value.intensities()) i = std::max(0.0, i);
+  return true;
+}
+
+IrradianceCache::Record IrradianceCache::computeRecord(
+    geometry::Point3D const& x, geometry::Normal3D const& n,
+    Incoming const& incoming) const {
+  modelling::RandomStream& random = modelling::threadRandom();
+
+  const size_t M = m_settings.thetaStrata;
+  const size_t N = m_settings.phiStrata;
+  const double dPhi = 2.0 * M_PI / double(N);
+  const double pi2 = M_PI * M_PI;
+
+  geometry::Normal3D O = std::abs(n.z) < 0.99
+                             ? n % geometry::Normal3D{0, 0, 1}
+                             : n % geometry::Normal3D{0, 1, 0};
+  geometry::Normal3D P = n % O;
+
+  color::SColor zero(0.0);
+  Record record{x, n, 0.0, zero, {zero, zero, zero}, {zero, zero, zero}};
+
+  std::vector<color::SColor> L(M * N);
+  std::vector<geometry::Coord> r(M * N);
+  double invDistSum = 0.0;
+
+  for (size_t j = 0; j < M; ++j) {
+    double c0 = 1.0 - double(j) / double(M);
+    double c1 = 1.0 - double(j + 1) / double(M);
+    // Integral of cos^3 / pi^2 over the stratum.
+    double omega = dPhi / (4.0 * pi2) * (c0 * c0 - c1 * c1);
+
+    for (size_t k = 0; k < N; ++k) {
+      double sin2 = (double(j) + random.uniform()) / double(M);
+      double sinTheta = std::sqrt(sin2);
+      double cosTheta = std::sqrt(1.0 - sin2);
+      double phi = dPhi * (double(k) + random.uniform());
+
+      geometry::Normal3D w = O * (sinTheta * std::cos(phi)) +
+                             P * (sinTheta * std::sin(phi)) + n * cosTheta;
+      auto [radiance, distance] = incoming(geometry::Ray{x, w});
+      L[j * N + k] = radiance;
+      r[j * N + k] = distance;
+      if (std::isfinite(distance) && distance > 0.0)
+        invDistSum += 1.0 / distance;
+
+      record.value += radiance * omega;
+
+      geometry::Vector3D g = (static_cast<geometry::Vector3D const&>(n) % w) *
+                             (3.0 / std::max(cosTheta, 1e-3) * omega);
+      record.rotation[0] += radiance * g.x;
+      record.rotation[1] += radiance * g.y;
+      record.rotation[2] += radiance * g.z;
+    }
+  }
+
+  auto addTranslation = [&](geometry::Vector3D const& dir, double factor,
+                            color::SColor const& diff) {
+    if (!std::isfinite(factor)) return;
+    record.translation[0] += diff * (dir.x * factor);
+    record.translation[1] += diff * (dir.y * factor);
+    record.translation[2] += diff * (dir.z * factor);
+  };
+
+  for (size_t k = 0; k < N; ++k) {
+    // Boundaries between theta strata, moving along the stratum center.
+    double phiC = dPhi * (double(k) + 0.5);
+    geometry::Vector3D u = O * std::cos(phiC) + P * std::sin(phiC);
+    for (size_t j = 1; j < M; ++j) {
+      double sinTheta = std::sqrt(double(j) / double(M));
+      double cos2 = 1.0 - double(j) / double(M);
+      double rMin = std::min(r[j * N + k], r[(j - 1) * N + k]);
+      addTranslation(u, dPhi * sinTheta * cos2 * cos2 / pi2 / rMin,
+                     L[j * N + k] + L[(j - 1) * N + k] * -1.0);
+    }
+
+    // Boundaries between phi strata.
+    double phiB = dPhi * double(k) + M_PI / 2.0;
+    geometry::Vector3D v = O * std::cos(phiB) + P * std::sin(phiB);
+    size_t km1 = (k + N - 1) % N;
+    for (size_t j = 0; j < M; ++j) {
+      double s0 = std::sqrt(double(j) / double(M));
+      double s1 = std::sqrt(double(j + 1) / double(M));
+      double cubeIntegral = (s1 - s1 * s1 * s1 / 3.0) - (s0 - s0 * s0 * s0 / 3.0);
+      double rMin = std::min(r[j * N + k], r[j * N + km1]);
+      addTranslation(v, cubeIntegral / pi2 / rMin,
+                     L[j * N + k] + L[j * N + km1] * -1.0);
+    }
+  }
+
+  record.radius = invDistSum > 0.0 ? double(M * N) / invDistSum
+                                   : m_settings.maxSpacing;
+  record.radius = std::max(m_settings.minSpacing,
+                           std::min(m_settings.maxSpacing, record.radius));
+  return record;
+}
+
+void IrradianceCache::insert(Record record) {
+  std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+  geometry::Coord influence = m_settings.accuracy * record.radius;
+  Node* node = m_root.get();
+
+  if (contains(node->center, node->halfSize, record.x)) {
+    for (size_t depth = 0;
+         depth < MaxOctreeDepth && node->halfSize / 2.0 >= influence; ++depth) {
+      size_t octant = (record.x.x >= node->center.x ? 1 : 0) |
+                      (record.x.y >= node->center.y ? 2 : 0) |
+                      (record.x.z >= node->center.z ? 4 : 0);
+      std::unique_ptr<Node>& child = node->children[octant];
+      if (!child) {
+        child = std::make_unique<Node>();
+        child->halfSize = node->halfSize / 2.0;
+        child->center = node->center +
+                        geometry::Vector3D{(octant & 1) ? 1.0 : -1.0,
+                                           (octant & 2) ? 1.0 : -1.0,
+                                           (octant & 4) ? 1.0 : -1.0} *
+                            child->halfSize;
+      }
+      node = child.get();
+    }
+  }
+
+  node->records.push_back(std::move(record));
+  ++m_size;
+}
+
+color::SColor IrradianceCache::get(geometry::Point3D const& x,
+                                   geometry::Normal3D const& n,
+                                   Incoming const& incoming) {
+  color::SColor value(0.0);
+  if (lookup(x, n, value)) return value;
+
+  Record record = computeRecord(x, n, incoming);
+  value = record.value;
+  insert(std::move(record));
+  return value;
+}
+
+size_t IrradianceCache::size() const {
+  std::shared_lock<std::shared_mutex> lock(m_mutex);
+  return m_size;
+}
+
+}  // namespace rendering
@@ -0,0 +1,286 @@
+#include <rendering/PathGuiding.h>
+
+#include <algorithm>
+#include <cmath>
+
+namespace rendering {
+
+static void atomicAdd(std::atomic<float>& target, float value) {
+  float current = target.load(std::memory_order_relaxed);
+  while (!target.compare_exchange_weak(current, current + value,
+                                       std::memory_order_relaxed))
+    ;
+}
+
+// Equal-area mapping between the unit sphere and the unit square.
+static geometry::Point2D dirToCanonical(geometry::Normal3D const& d) {
+  geometry::Coord cosTheta = std::max(-1.0, std::min(1.0, d.z));
+  geometry::Coord phi = std::atan2(d.y, d.x);
+  if (phi < 0.0) phi += 2.0 * M_PI;
+  return {(cosTheta + 1.0) / 2.0, std::min(phi / (2.0 * M_PI), 1.0)};
+}
+
+static geometry::Normal3D canonicalToDir(geometry::Point2D const& p) {
+  geometry::Coord cosTheta = 2.0 * p.x - 1.0;
+  geometry::Coord phi = 2.0 * M_PI * p.y;
+  geometry::Coord sinTheta = std::sqrt(std::max(0.0, 1.0 - cosTheta * cosTheta));
+  return {sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta};
+}
+
+static unsigned quadrant(geometry::Point2D& p) {
+  unsigned cx = p.x >= 0.5 ? 1 : 0;
+  unsigned cy = p.y >= 0.5 ? 1 : 0;
+  p.x = 2.0 * p.x - cx;
+  p.y = 2.0 * p.y - cy;
+  return cx + 2 * cy;
+}
+
+DTree::Node::Node() : sum{{0.0f}, {0.0f}, {0.0f}, {0.0f}}, child{0, 0, 0, 0} {}
+
+DTree::Node::Node(Node const& other) { *this = other; }
+
+DTree::Node& DTree::Node::operator=(Node const& other) {
+  for (size_t c = 0; c < 4; ++c) {
+    sum[c].store(other.sum[c].load(std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+    child[c] = other.child[c];
+  }
+  return *this;
+}
+
+DTree::DTree() : m_nodes(1) {}
+
+void DTree::record(geometry::Normal3D const& dir, double value) {
+  if (!(value > 0.0) || !std::isfinite(value)) return;
+
+  geometry::Point2D p = dirToCanonical(dir);
+  uint32_t node = 0;
+  for (;;) {
+    unsigned c = quadrant(p);
+    if (m_nodes[node].child[c] == 0) {
+      atomicAdd(m_nodes[node].sum[c], static_cast<float>(value));
+      return;
+    }
+    node = m_nodes[node].child[c];
+  }
+}
+
+void DTree::build() {
+  // Children are always stored after their parent.
+  for (size_t i = m_nodes.size(); i-- > 0;) {
+    Node& node = m_nodes[i];
+    for (size_t c = 0; c < 4; ++c) {
+      if (node.child[c] == 0) continue;
+      Node const& child = m_nodes[node.child[c]];
+      float sum = 0.0f;
+      for (size_t k = 0; k < 4; ++k)
+        sum += child.sum[k].load(std::memory_order_relaxed);
+      node.sum[c].store(sum, std::memory_order_relaxed);
+    }
+  }
+}
+
+void DTree::refine(DTree const& learned, double threshold, size_t maxDepth) {
+  m_nodes.assign(1, Node());
+
+  double energy[4];
+  for (size_t c = 0; c < 4; ++c)
+    energy[c] = learned.m_nodes[0].sum[c].load(std::memory_order_relaxed);
+
+  double total = learned.total();
+  if (total <= 0.0) return;
+
+  subdivide(0, learned, 0, energy, total, threshold, 1, maxDepth);
+}
+
+void DTree::subdivide(uint32_t node, DTree const& learned, int64_t learnedNode,
+                      double const energy[4], double total, double threshold,
+                      size_t depth, size_t maxDepth) {
+  for (size_t c = 0; c < 4; ++c) {
+    if (depth >= maxDepth || energy[c] / total <= threshold) continue;
+
+    double childEnergy[4];
+    int64_t learnedChild = -1;
+    if (learnedNode >= 0 && learned.m_nodes[learnedNode].child[c] != 0) {
+      learnedChild = learned.m_nodes[learnedNode].child[c];
+      for (size_t k = 0; k < 4; ++k)
+        childEnergy[k] =
+            learned.m_nodes[learnedChild].sum[k].load(std::memory_order_relaxed);
+    } else {
+      std::fill(childEnergy, childEnergy + 4, energy[c] / 4.0);
+    }
+
+    auto child = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.emplace_back();
+    m_nodes[node].child[c] = child;
+    subdivide(child, learned, learnedChild, childEnergy, total, threshold,
+              depth + 1, maxDepth);
+  }
+}
+
+double DTree::total() const {
+  double total = 0.0;
+  for (size_t c = 0; c < 4; ++c)
+    total += m_nodes[0].sum[c].load(std::memory_order_relaxed);
+  return total;
+}
+
+geometry::Normal3D DTree::sample(double u, double v) const {
+  geometry::Point2D origin{0.0, 0.0};
+  double size = 1.0;
+  uint32_t node = 0;
+
+  for (;;) {
+    Node const& n = m_nodes[node];
+    double s[4];
+    for (size_t c = 0; c < 4; ++c)
+      s[c] = n.sum[c].load(std::memory_order_relaxed);
+    double total = s[0] + s[1] + s[2] + s[3];
+    if (!(total > 0.0)) break;
+
+    // Pick the column first, then the quadrant within the column, reusing
+    // the random numbers for the next level.
+    unsigned cx = 0, cy = 0;
+    double left = s[0] + s[2];
+    if (u * total < left) {
+      u = u * total / left;
+    } else {
+      cx = 1;
+      u = (u * total - left) / (total - left);
+    }
+    double column = cx == 0 ? left : total - left;
+    double upper = s[cx];
+    if (v * column < upper) {
+      v = v * column / upper;
+    } else {
+      cy = 1;
+      v = (v * column - upper) / (column - upper);
+    }
+    u = std::min(std::max(u, 0.0), std::nextafter(1.0, 0.0));
+    v = std::min(std::max(v, 0.0), std::nextafter(1.0, 0.0));
+
+    size /= 2.0;
+    origin.x += cx * size;
+    origin.y += cy * size;
+
+    unsigned c = cx + 2 * cy;
+    if (n.child[c] == 0) break;
+    node = n.child[c];
+  }
+
+  return canonicalToDir({origin.x + size * u, origin.y + size * v});
+}
+
+double DTree::pdf(geometry::Normal3D const& dir) const {
+  geometry::Point2D p = dirToCanonical(dir);
+  double result = 1.0 / (4.0 * M_PI);
+  uint32_t node = 0;
+
+  for (;;) {
+    Node const& n = m_nodes[node];
+    double total = 0.0;
+    for (size_t c = 0; c < 4; ++c)
+      total += n.sum[c].load(std::memory_order_relaxed);
+    if (!(total > 0.0)) return result;
+
+    unsigned c = quadrant(p);
+    result *= 4.0 * n.sum[c].load(std::memory_order_relaxed) / total;
+    if (n.child[c] == 0) return result;
+    node = n.child[c];
+  }
+}
+
+/**
+ * @brief Construct a new SDTree:: SDTree object
+ *
+ * The bounds are made cubic so that splitting along the cycling axes keeps
+ * the cells roughly isotropic.
+ *
+ * @param min
+ * @param max
+ */
+SDTree::SDTree(geometry::Point3D min, geometry::Point3D max)
+    : m_min(min), m_max(max) {
+  geometry::Vector3D extent = max - min;
+  geometry::Coord size = std::max({extent.x, extent.y, extent.z});
+  m_max = m_min + geometry::Vector3D{size, size, size};
+
+  m_nodes.push_back(Node{{0, 0}, 0, std::make_unique<Leaf>()});
+}
+
+static geometry::Coord axisCoord(geometry::Point3D const& p, unsigned axis) {
+  return axis == 0 ? p.x : (axis == 1 ? p.y : p.z);
+}
+
+static void setAxisCoord(geometry::Point3D& p, unsigned axis,
+                         geometry::Coord value) {
+  (axis == 0 ? p.x : (axis == 1 ? p.y : p.z)) = value;
+}
+
+SDTree::Leaf& SDTree::leaf(geometry::Point3D const& x) const {
+  geometry::Point3D min = m_min, max = m_max;
+  uint32_t node = 0;
+  while (!m_nodes[node].leaf) {
+    Node const& n = m_nodes[node];
+    geometry::Coord mid =
+        (axisCoord(min, n.axis) + axisCoord(max, n.axis)) / 2.0;
+    if (axisCoord(x, n.axis) < mid) {
+      setAxisCoord(max, n.axis, mid);
+      node = n.child[0];
+    } else {
+      setAxisCoord(min, n.axis, mid);
+      node = n.child[1];
+    }
+  }
+  return *m_nodes[node].leaf;
+}
+
+DTree const& SDTree::distribution(geometry::Point3D const& x) const {
+  return leaf(x).sampling;
+}
+
+void SDTree::record(geometry::Point3D const& x, geometry::Normal3D const& dir,
+                    double value) {
+  Leaf& l = leaf(x);
+  l.samples.fetch_add(1, std::memory_order_relaxed);
+  l.building.record(dir, value);
+}
+
+void SDTree::refine(size_t pass, PathGuidingSettings const& settings) {
+  for (auto& node : m_nodes) {
+    if (!node.leaf) continue;
+    Leaf& l = *node.leaf;
+    l.building.build();
+    l.sampling = l.building;
+    l.building.refine(l.sampling, settings.directionalThreshold,
+                      settings.maxDirectionalDepth);
+  }
+
+  double threshold =
+      settings.spatialThreshold * std::sqrt(std::pow(2.0, double(pass)));
+  for (size_t i = 0, n = m_nodes.size(); i < n; ++i) {
+    if (!m_nodes[i].leaf) continue;
+    size_t samples = m_nodes[i].leaf->samples.exchange(0);
+    split(static_cast<uint32_t>(i), samples, threshold);
+  }
+}
+
+void SDTree::split(uint32_t node, size_t samples, double threshold) {
+  if (double(samples) <= threshold) return;
+
+  std::unique_ptr<Leaf> parent = std::move(m_nodes[node].leaf);
+  unsigned childAxis = (m_nodes[node].axis + 1) % 3;
+
+  for (size_t k = 0; k < 2; ++k) {
+    auto child = static_cast<uint32_t>(m_nodes.size());
+    m_nodes.push_back(Node{{0, 0}, childAxis, std::make_unique<Leaf>()});
+    m_nodes[child].leaf->sampling = parent->sampling;
+    m_nodes[child].leaf->building = parent->building;
+    m_nodes[node].child[k] = child;
+  }
+
+  split(m_nodes[node].child[0], samples / 2, threshold);
+  split(m_nodes[node].child[1], samples / 2, threshold);
+}
+
+}  // namespace rendering
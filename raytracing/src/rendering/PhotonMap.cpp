@@ -0,0 +1,202 @@
+#include <modelling/Random.h>
+#include <rendering/PhotonMap.h>
+#include <rendering/parallel.h>
+#include <rendering/render.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+namespace rendering {
+
+static const size_t PhotonsPerTask = 4096;
+
+// Sample index of the photon seeds, past any pass of the image.
+static const uint64_t PhotonSample = ~uint64_t(0);
+
+static void tracePhotons(RenderScene const& renderScene,
+                         std::vector<color::Intensity> const& emitterCdf,
+                         PhotonMapSettings const& settings, size_t begin,
+                         size_t end, std::vector<PhotonMap::Photon>& photons) {
+  // The materials sample from the stream of the thread, so it is seeded
+  // per photon: the path of a photon then depends only on its index.
+  modelling::RandomStream& random = modelling::threadRandom();
+
+  for (size_t n = begin; n < end; ++n) {
+    random.seed(modelling::sampleSeed(n, PhotonSample));
+    double u = random.uniform();
+    size_t e = std::min<size_t>(
+        std::upper_bound(emitterCdf.begin(), emitterCdf.end(), u) -
+            emitterCdf.begin(),
+        emitterCdf.size() - 1);
+    color::Intensity p = emitterCdf[e] - (e > 0 ? emitterCdf[e - 1] : 0.0);
+
+    double u1 = random.uniform(), u2 = random.uniform();
+    double u3 = random.uniform();
+    modelling::PhotonEmission emission =
+        renderScene.emitters[e]->emitPhoton(u1, u2, u3);
+    color::SColor power =
+        emission.power / (p * static_cast<color::Intensity>(settings.photons));
+    geometry::Ray ray = emission.ray;
+    bool caustic = false;
+
+    for (size_t depth = 0; depth < settings.maxDepth; ++depth) {
+      auto [primitive, t, part] = intersect(renderScene, ray);
+      if (!primitive) break;
+
+      geometry::Point3D x = ray.start + t * ray.direction;
+      if (caustic) {
+        color::Intensities const& i = power.intensities();
+        photons.push_back({{float(x.x), float(x.y), float(x.z)},
+                           {float(ray.direction.x), float(ray.direction.y),
+                            float(ray.direction.z)},
+                           {float(i[0]), float(i[1]), float(i[2])}});
+      }
+
+      geometry::Point2D uv = primitive->requiresUV()
+                                 ? primitive->getUV(x, part)
+                                 : geometry::Point2D{0.0, 0.0};
+      geometry::Normal3D normal = primitive->normal(x, uv, part);
+      modelling::Reflection reflection =
+          primitive->reflection(normal, -ray.direction, uv);
+      if (!reflection.delta || reflection.prob < 1e-8) break;
+
+      geometry::Coord cost = std::abs(reflection.dir * normal);
+      power *= reflection.color * cost * reflection.prob;
+      if (power.luminance() < 1e-12) break;
+
+      ray = geometry::Ray{x, reflection.dir};
+      caustic = true;
+    }
+  }
+}
+
+/**
+ * @brief Construct a new Photon Map:: Photon Map object
+ *
+ * Emitters are chosen proportionally to their power. Every photon is
+ * traced from a seed of its own index, so the map does not depend on the
+ * number of threads or on the order of the tasks.
+ *
+ * @param renderScene
+ * @param settings
+ * @param threads
+ */
+PhotonMap::PhotonMap(RenderScene const& renderScene,
+                     PhotonMapSettings const& settings, size_t threads)
+    : m_settings(settings) {
+  std::vector<color::Intensity> emitterCdf;
+  color::Intensity sum = 0.0;
+  for (auto const& emitter : renderScene.emitters) {
+    sum += emitter->power().luminance();
+    emitterCdf.push_back(sum);
+  }
+  if (sum <= 0.0 || settings.photons == 0) {
+    m_cellStart.assign(2, 0);
+    return;
+  }
+  for (auto& c : emitterCdf) c /= sum;
+
+  size_t tasks = (settings.photons + PhotonsPerTask - 1) / PhotonsPerTask;
+  std::vector<std::vector<Photon>> traced(tasks);
+  parallelFor(tasks, threads, [&](size_t task) {
+    size_t begin = task * PhotonsPerTask;
+    size_t end = std::min(begin + PhotonsPerTask, settings.photons);
+    tracePhotons(renderScene, emitterCdf, settings, begin, end, traced[task]);
+  });
+
+  std::vector<Photon> photons;
+  for (auto const& t : traced) photons.insert(photons.end(), t.begin(), t.end());
+  build(photons, threads);
+}
+
+int64_t PhotonMap::cellCoord(geometry::Coord c) const {
+  return static_cast<int64_t>(std::floor(c / (2.0 * m_settings.radius)));
+}
+
+size_t PhotonMap::cellIndex(int64_t x, int64_t y, int64_t z) const {
+  uint64_t h = (uint64_t(x) * 73856093u) ^ (uint64_t(y) * 19349663u) ^
+               (uint64_t(z) * 83492791u);
+  // The table size is m_cellStart.size() - 1 and a power of two.
+  return static_cast<size_t>(h & (m_cellStart.size() - 2));
+}
+
+// Counting sort of the photons by hash cell: the counts, the scatter and the
+// cell index computation run in parallel, only the prefix sum is serial.
+void PhotonMap::build(std::vector<Photon> const& photons, size_t threads) {
+  size_t tableSize = 1;
+  while (tableSize < photons.size()) tableSize *= 2;
+  m_cellStart.assign(tableSize + 1, 0);
+
+  size_t tasks = (photons.size() + PhotonsPerTask - 1) / PhotonsPerTask;
+  std::vector<uint32_t> cells(photons.size());
+  std::vector<std::atomic<uint32_t>> counts(tableSize);
+
+  parallelFor(tasks, threads, [&](size_t task) {
+    size_t end = std::min((task + 1) * PhotonsPerTask, photons.size());
+    for (size_t i = task * PhotonsPerTask; i < end; ++i) {
+      Photon const& p = photons[i];
+      cells[i] = static_cast<uint32_t>(cellIndex(
+          cellCoord(p.pos[0]), cellCoord(p.pos[1]), cellCoord(p.pos[2])));
+      counts[cells[i]].fetch_add(1, std::memory_order_relaxed);
+    }
+  });
+
+  uint32_t start = 0;
+  for (size_t i = 0; i < tableSize; ++i) {
+    m_cellStart[i] = start;
+    start += counts[i].exchange(start, std::memory_order_relaxed);
+  }
+  m_cellStart[tableSize] = start;
+
+  m_photons.resize(photons.size());
+  parallelFor(tasks, threads, [&](size_t task) {
+    size_t end = std::min((task + 1) * PhotonsPerTask, photons.size());
+    for (size_t i = task * PhotonsPerTask; i < end; ++i)
+      m_photons[counts[cells[i]].fetch_add(1, std::memory_order_relaxed)] =
+          photons[i];
+  });
+}
+
+color::SColor PhotonMap::estimate(modelling::Primitive const& primitive,
+                                  geometry::Point3D const& x,
+                                  geometry::Normal3D const& N,
+                                  geometry::Normal3D const& V,
+                                  geometry::TexCoord const& uv) const {
+  color::SColor result(0.0);
+  if (m_photons.empty()) return result;
+
+  geometry::Coord r = m_settings.radius;
+  geometry::Coord r2 = r * r;
+
+  // With cells of size 2r the lookup sphere overlaps at most 2x2x2 cells.
+  int64_t x0 = cellCoord(x.x - r), y0 = cellCoord(x.y - r),
+          z0 = cellCoord(x.z - r);
+  size_t visited[8];
+  size_t nVisited = 0;
+
+  for (int64_t cx = x0; cx <= x0 + 1; ++cx)
+    for (int64_t cy = y0; cy <= y0 + 1; ++cy)
+      for (int64_t cz = z0; cz <= z0 + 1; ++cz) {
+        size_t cell = cellIndex(cx, cy, cz);
+        if (std::find(visited, visited + nVisited, cell) != visited + nVisited)
+          continue;
+        visited[nVisited++] = cell;
+
+        for (uint32_t i = m_cellStart[cell]; i < m_cellStart[cell + 1]; ++i) {
+          Photon const& p = m_photons[i];
+          geometry::Vector3D d{p.pos[0] - x.x, p.pos[1] - x.y, p.pos[2] - x.z};
+          if (d * d > r2) continue;
+
+          geometry::Normal3D L{-p.dir[0], -p.dir[1], -p.dir[2]};
+          if (L * N <= 0.0) continue;
+
+          color::SColor power({p.power[0], p.power[1], p.power[2]});
+          result += primitive.BRDF(L, N, V, uv) * power;
+        }
+      }
+
+  return result / (M_PI * r2);
+}
+
+}  // namespace rendering
@@ -0,0 +1,83 @@
+#include <rendering/RenderStats.h>
+
+#include <ostream>
+
+namespace rendering {
+
+template <typename F>
+static void forEachField(RenderCounters& a, RenderCounters const& b, F f) {
+  f(a.cameraRays, b.cameraRays);
+  f(a.bounceRays, b.bounceRays);
+  f(a.shadowRays, b.shadowRays);
+  f(a.shadowRaysBlocked, b.shadowRaysBlocked);
+  f(a.emitterSamplesSkipped, b.emitterSamplesSkipped);
+  for (size_t i = 0; i < ShapeCount; ++i) {
+    f(a.primitiveTests[i], b.primitiveTests[i]);
+    f(a.shadowTests[i], b.shadowTests[i]);
+  }
+  for (size_t i = 0; i < a.pathLengths.size(); ++i)
+    f(a.pathLengths[i], b.pathLengths[i]);
+  f(a.pathVertices, b.pathVertices);
+  for (size_t i = 0; i < a.terminations.size(); ++i)
+    f(a.terminations[i], b.terminations[i]);
+}
+
+RenderCounters& RenderCounters::operator+=(RenderCounters const& other) {
+  forEachField(*this, other, [](uint64_t& a, uint64_t b) { a += b; });
+  return *this;
+}
+
+RenderCounters& RenderCounters::operator-=(RenderCounters const& other) {
+  forEachField(*this, other, [](uint64_t& a, uint64_t b) { a -= b; });
+  return *this;
+}
+
+static void writeArray(std::ostream& out, uint64_t const* values, size_t n) {
+  out << "[";
+  for (size_t i = 0; i < n; ++i) out << (i ? ", " : "") << values[i];
+  out << "]";
+}
+
+void RenderStats::writeJSON(std::ostream& out) const {
+  RenderCounters const& c = counters;
+  uint64_t tests = 0, shadowTests = 0;
+  for (size_t i = 0; i < ShapeCount; ++i) {
+    tests += c.primitiveTests[i];
+    shadowTests += c.shadowTests[i];
+  }
+  uint64_t rays = c.cameraRays + c.bounceRays;
+  char const* shapes[ShapeCount] = {"sphere", "triangle", "torus", "mesh", "other"};
+  char const* terminations[size_t(Termination::Count)] = {
+      "missed", "absorbed", "cached", "grazing", "low_throughput",
+      "max_depth"};
+
+  out << "{\n  \"counters_enabled\": " << (StatsEnabled ? "true" : "false")
+      << ",\n  \"time\": {\"photon_map\": " << photonMapTime
+      << ", \"guiding\": " << guidingTime << ", \"image\": " << imageTime
+      << ", \"total\": " << totalTime << "},\n  \"rays\": {\"camera\": "
+      << c.cameraRays << ", \"bounce\": " << c.bounceRays
+      << ", \"shadow\": " << c.shadowRays
+      << ", \"shadow_blocked\": " << c.shadowRaysBlocked
+      << "},\n  \"emitter_samples_skipped\": " << c.emitterSamplesSkipped
+      << ",\n  \"primitive_tests\": {";
+  for (size_t i = 0; i < ShapeCount; ++i)
+    out << (i ? ", " : "") << "\"" << shapes[i]
+        << "\": " << c.primitiveTests[i];
+  out << "},\n  \"shadow_tests\": {";
+  for (size_t i = 0; i < ShapeCount; ++i)
+    out << (i ? ", " : "") << "\"" << shapes[i] << "\": " << c.shadowTests[i];
+  out << "},\n  \"tests_per_ray\": "
+      << (rays ? double(tests) / double(rays) : 0.0)
+      << ",\n  \"tests_per_shadow_ray\": "
+      << (c.shadowRays ? double(shadowTests) / double(c.shadowRays) : 0.0)
+      << ",\n  \"path_vertices\": " << c.pathVertices
+      << ",\n  \"path_lengths\": ";
+  writeArray(out, c.pathLengths.data(), c.pathLengths.size());
+  out << ",\n  \"terminations\": {";
+  for (size_t i = 0; i < c.terminations.size(); ++i)
+    out << (i ? ", " : "") << "\"" << terminations[i]
+        << "\": " << c.terminations[i];
+  out << "}\n}\n";
+}
+
+}  // namespace rendering
@@ -1,40 +1,66 @@
+#include <modelling/Random.h>
+#include <platform/Cpu.h>
+#include <platform/Trace.h>
+#include <rendering/parallel.h>
 #include <rendering/render.h>
 
-namespace rendering {
+#include <chrono>
+#include <cstring>
+#include <future>
+#include <mutex>
 
-struct Intersection {
-  std::shared_ptr<modelling::Primitive> primitive;
-  geometry::Coord x;
-};
+namespace rendering {
 
 Intersection intersect(RenderScene const& renderScene, geometry::Ray ray) {
   std::shared_ptr<modelling::Primitive> visiblePrimitive;
   geometry::Coord smallestDistance =
       std::numeric_limits<geometry::Coord>::max();
-
-  for (auto const& primitive : renderScene.primitives) {
-    geometry::Coord distance = primitive->intersect(ray);
+  size_t visibleIndex = 0;
+  uint32_t visiblePart = 0;
+
+  auto const& primitives = renderScene.primitives;
+  for (size_t k = 0; k < primitives.size(); ++k) {
+    auto const& primitive = primitives[k];
+    stats::countTest(size_t(primitive->shape()));
+    stats::countPrimitiveTest(k);
+    auto [distance, part] = primitive->hit(ray);
     if (distance > 0.0 && distance < smallestDistance) {
       smallestDistance = distance;
       visiblePrimitive = primitive;
+      visibleIndex = k;
+      visiblePart = part;
     }
   }
-  return {
-      visiblePrimitive,
-      smallestDistance};  // ray.sta  rt + smallestDistance * ray.direction};
+  if (visiblePrimitive) stats::countPrimitiveHit(visibleIndex);
+  return {visiblePrimitive, smallestDistance, visiblePart};
 }
 
 color::SColor intersectShadow(RenderScene const& renderScene,
                               geometry::Ray rayToLight,
-                              geometry::Coord lightDist) {
+                              geometry::Coord lightDist,
+                              bool transparentShadows = true) {
   color::SColor attn(1.0);
+  stats::count(&RenderCounters::shadowRays);
 
-  for (auto const& primitive : renderScene.primitives) {
+  auto const& primitives = renderScene.primitives;
+  for (size_t k = 0; k < primitives.size(); ++k) {
+    auto const& primitive = primitives[k];
+    stats::countShadowTest(size_t(primitive->shape()));
+    stats::countPrimitiveTest(k);
     geometry::Coord t = primitive->intersect(rayToLight);
 
-    if (t > 1e-8 && t < lightDist) attn *= primitive->transparency();
+    if (t > 1e-8 && t < lightDist) {
+      if (!transparentShadows) {
+        stats::count(&RenderCounters::shadowRaysBlocked);
+        return color::SColor(0.0);
+      }
+      attn *= primitive->transparency();
+    }
 
-    if (attn.luminance() < 1e-8) return attn;
+    if (attn.luminance() < 1e-8) {
+      stats::count(&RenderCounters::shadowRaysBlocked);
+      return attn;
+    }
   }
   return attn;
 }
@@ -44,17 +70,22 @@ color::SColor directLightSource(RenderScene const& renderScene,
                                 geometry::Point3D const& x,
                                 geometry::Normal3D const& N,
                                 geometry::Normal3D const& V,
-                                geometry::Point2D const& uv) {
+                                geometry::TexCoord const& uv,
+                                bool transparentShadows = true) {
   color::SColor c(0.0);
 
-  for (auto const emitter : renderScene.emitters) {
+  for (auto const& emitter : renderScene.emitters) {
     auto [Le, lightPos, rayToLight] = emitter->emission(x, N);
-    if (Le.luminance() < 1e-8) continue;
+    if (Le.luminance() < 1e-8) {
+      stats::count(&RenderCounters::emitterSamplesSkipped);
+      continue;
+    }
 
     geometry::Vector3D L = lightPos - x;
     geometry::Coord lightDist = L.length();
 
-    color::SColor atten = intersectShadow(renderScene, rayToLight, lightDist);
+    color::SColor atten = intersectShadow(renderScene, rayToLight, lightDist,
+                                          transparentShadows);
 
     c += atten * primitive->BRDF(L, N, V, uv) * Le;
   }
@@ -66,13 +97,14 @@ color::SColor traceGlobal_recursive(RenderScene const& renderScene,
                                     size_t maxDepth) {
   if (d > maxDepth) return color::SColor(0);
 
-  auto [primitive, t] = intersect(renderScene, ray);
+  auto [primitive, t, part] = intersect(renderScene, ray);
 
   if (!primitive) return color::SColor(0.0);
   geometry::Point3D x = ray.start + t * ray.direction;
-  geometry::Point2D uv = primitive->requiresUV() ? primitive->getUV(x)
-                                                 : geometry::Point2D{0.0, 0.0};
-  geometry::Normal3D normal = primitive->normal(x, uv);
+  geometry::Point2D uv = primitive->requiresUV()
+                             ? primitive->getUV(x, part)
+                             : geometry::Point2D{0.0, 0.0};
+  geometry::Normal3D normal = primitive->normal(x, uv, part);
   color::SColor c =
       directLightSource(renderScene, primitive, x, normal, -ray.direction, uv);
 
@@ -95,79 +127,701 @@ color::SColor traceGlobal_recursive(RenderScene const& renderScene,
   return c;
 }
 
+struct TraceContext {
+  SDTree* guideTree = nullptr;
+  bool recordGuiding = false;
+  double bsdfFraction = 1.0;
+  PhotonMap const* caustics = nullptr;
+  IrradianceCache* irradianceCache = nullptr;
+};
+
+// A diffuse path vertex whose incident radiance along the sampled direction
+// is learned by the guiding tree.
+struct GuidingVertex {
+  geometry::Point3D x;
+  geometry::Normal3D dir;
+  double pdf;
+  double throughput;
+  double radiance;
+};
+
+// Moves the differentials of `ray` to its hit point at distance t on a
+// surface with normal N. Returns false for grazing hits.
+static bool transferDifferential(geometry::RayDifferential& rd,
+                                 geometry::Ray const& ray, geometry::Coord t,
+                                 geometry::Normal3D const& N) {
+  geometry::Coord dn = ray.direction * N;
+  if (std::abs(dn) < 1e-6) return false;
+
+  auto transfer = [&](geometry::Vector3D& dP, geometry::Vector3D const& dD) {
+    dP = dP + dD * t;
+    dP = dP - ray.direction * ((dP * N) / dn);
+  };
+  transfer(rd.dPdx, rd.dDdx);
+  transfer(rd.dPdy, rd.dDdy);
+  return true;
+}
+
+// Differentials of the direction after an ideal reflection or refraction of
+// D into R at a surface with normal N. The change of the normal across the
+// footprint is neglected.
+static void scatterDifferential(geometry::RayDifferential& rd,
+                                geometry::Normal3D const& D,
+                                geometry::Normal3D const& R,
+                                geometry::Normal3D const& N) {
+  geometry::Coord dn = D * N;
+  geometry::Coord rn = R * N;
+
+  if (dn * rn <= 0.0) {
+    rd.dDdx = rd.dDdx - N * (2.0 * (rd.dDdx * N));
+    rd.dDdy = rd.dDdy - N * (2.0 * (rd.dDdy * N));
+    return;
+  }
+
+  // Snell's law scales the tangential part of the direction by eta.
+  geometry::Coord tangential = (N * -dn + D).length();
+  geometry::Coord eta =
+      tangential > 1e-6 ? (N * -rn + R).length() / tangential : 1.0;
+  geometry::Coord dmu = eta - eta * eta * dn / rn;
+
+  rd.dDdx = rd.dDdx * eta - N * (dmu * (rd.dDdx * N));
+  rd.dDdy = rd.dDdy * eta - N * (dmu * (rd.dDdy * N));
+}
+
+// Change of the texture coordinates uv at x on part of primitive along dP.
+// Differences across the texture seam are wrapped.
+static geometry::Point2D uvDifferential(modelling::Primitive const& primitive,
+                                        uint32_t part,
+                                        geometry::Point3D const& x,
+                                        geometry::Point2D const& uv,
+                                        geometry::Vector3D const& dP) {
+  geometry::Point2D uv2 = primitive.getUV(x + dP, part);
+  geometry::Coord du = uv2.x - uv.x;
+  geometry::Coord dv = uv2.y - uv.y;
+  return {du - std::round(du), dv - std::round(dv)};
+}
+
+// With `first`, the intersection of `ray` is already known and is not
+// computed again.
 color::SColor traceGlobal(RenderScene const& renderScene, geometry::Ray ray,
-                          size_t maxDepth) {
+                          size_t maxDepth,
+                          TraceContext const& context = TraceContext{},
+                          geometry::RayDifferential const* differential =
+                              nullptr,
+                          Intersection const* first = nullptr) {
   color::SColor c(0);
   color::SColor w(1);
 
-  for (size_t i = 0; i < maxDepth; ++i) {
-    auto [primitive, t] = intersect(renderScene, ray);
+  bool record = context.guideTree != nullptr && context.recordGuiding;
+  std::vector<GuidingVertex> vertices;
+  if (record) vertices.reserve(maxDepth);
+
+  // Differentials are followed until the first non-specular bounce; later
+  // texture lookups use the finest mip level.
+  bool hasDifferential = differential != nullptr;
+  geometry::RayDifferential rd{};
+  if (hasDifferential) rd = *differential;
+
+  // Vertices of the path and why it ended, for the statistics.
+  size_t length = maxDepth;
+  Termination termination = Termination::MaxDepth;
+  auto end = [&](size_t vertices, Termination reason) {
+    length = vertices;
+    termination = reason;
+  };
 
-    if (!primitive) break;
+  // The cache stands in for the diffuse lobe at the first diffuse vertex
+  // only; later vertices are path traced.
+  bool useCache = context.irradianceCache != nullptr;
+
+  for (size_t i = 0; i < maxDepth; ++i) {
+    if (i > 0) stats::count(&RenderCounters::bounceRays);
+    auto [primitive, t, part] = i == 0 && first != nullptr
+                                    ? *first
+                                    : intersect(renderScene, ray);
+
+    if (!primitive) {
+      end(i, Termination::Missed);
+      break;
+    }
     geometry::Point3D x = ray.start + t * ray.direction;
-    geometry::Point2D uv = primitive->requiresUV()
-                               ? primitive->getUV(x)
-                               : geometry::Point2D{0.0, 0.0};
-    geometry::Normal3D normal = primitive->normal(x, uv);
-    c += w * directLightSource(renderScene, primitive, x, normal,
-                               -ray.direction, uv);
+    geometry::TexCoord uv = primitive->requiresUV()
+                                ? primitive->getUV(x, part)
+                                : geometry::Point2D{0.0, 0.0};
+    hasDifferential =
+        hasDifferential &&
+        transferDifferential(rd, ray, t, primitive->normal(x, part));
+    if (hasDifferential && primitive->requiresUV()) {
+      uv.dx = uvDifferential(*primitive, part, x, uv, rd.dPdx);
+      uv.dy = uvDifferential(*primitive, part, x, uv, rd.dPdy);
+    }
+    geometry::Normal3D normal = primitive->normal(x, uv, part);
+    color::SColor direct =
+        directLightSource(renderScene, primitive, x, normal, -ray.direction,
+                          uv, context.caustics == nullptr);
+    if (context.caustics != nullptr)
+      direct += context.caustics->estimate(*primitive, x, normal,
+                                           -ray.direction, uv);
+    direct *= w;
+    c += direct;
+
+    bool cached = false;
+    if (useCache) {
+      color::Intensity weight = primitive->diffuseWeight();
+      if (weight > 0.0) {
+        TraceContext incomingContext = context;
+        incomingContext.irradianceCache = nullptr;
+        incomingContext.recordGuiding = false;
+        size_t depth = maxDepth - i - 1;
+
+        color::SColor irradiance = context.irradianceCache->get(
+            x, normal, [&](geometry::Ray const& r) {
+              auto hit = intersect(renderScene, r);
+              if (!hit.primitive)
+                return std::make_pair(
+                    color::SColor(0.0),
+                    std::numeric_limits<geometry::Coord>::infinity());
+              return std::make_pair(traceGlobal(renderScene, r, depth,
+                                                incomingContext, nullptr, &hit),
+                                    hit.x);
+            });
+        c += w * primitive->diffuseColor(uv) * irradiance * (weight * weight);
+        cached = true;
+        useCache = false;
+      }
+    }
 
-    modelling::Reflection reflection =
-        primitive->reflection(normal, -ray.direction, uv);
-    if (reflection.prob < 1e-8) break;
+    if (record) {
+      color::Intensity luminance = direct.luminance();
+      for (auto& vertex : vertices)
+        vertex.radiance += luminance / vertex.throughput;
+    }
 
+    modelling::Reflection reflection =
+        context.guideTree != nullptr
+            ? primitive->reflection(normal, -ray.direction, uv,
+                                    context.guideTree->distribution(x),
+                                    context.bsdfFraction)
+            : primitive->reflection(normal, -ray.direction, uv);
+    if (reflection.prob < 1e-8) {
+      end(i + 1, Termination::Absorbed);
+      break;
+    }
+    // The diffuse part of the BRDF has been accounted for by the cache; the
+    // path goes on with the rest of it, the glossy part, in the direction
+    // drawn from the diffuse lobe. Other lobes are followed as they are.
+    if (cached && reflection.pdf > 0.0) {
+      reflection.color += primitive->diffuseColor(uv) * -1.0;
+      if (reflection.color.luminance() < 1e-8) {
+        end(i + 1, Termination::Cached);
+        break;
+      }
+    }
 
     geometry::Coord cost = reflection.dir * normal;
     if (cost < 0) cost = -cost;
-    if (cost < 1e-8) break;
+    if (cost < 1e-8) {
+      end(i + 1, Termination::Grazing);
+      break;
+    }
 
     w *= reflection.color * cost * reflection.prob;
-    if (w.luminance() < 1e-8) break;
+    if (w.luminance() < 1e-8) {
+      end(i + 1, Termination::LowThroughput);
+      break;
+    }
+
+    if (hasDifferential && reflection.delta)
+      scatterDifferential(rd, ray.direction, reflection.dir, normal);
+    else
+      hasDifferential = false;
     ray = geometry::Ray{x, reflection.dir};
+
+    if (record && reflection.pdf > 0.0 && !cached)
+      vertices.push_back(
+          {x, reflection.dir, reflection.pdf, w.luminance(), 0.0});
   }
 
+  for (auto const& vertex : vertices)
+    context.guideTree->record(vertex.x, vertex.dir, vertex.radiance / vertex.pdf);
+
+  stats::countPath(length, termination);
   return c;
 }
 
+static geometry::Ray cameraRay(RenderScene const& renderScene,
+                               color::ImageSize imageSize, geometry::Coord ii,
+                               geometry::Coord jj) {
+  geometry::Coord y =
+      -(2 * ii / static_cast<geometry::Coord>(imageSize.height - 1) - 1);
+  geometry::Coord x =
+      2 * jj / static_cast<geometry::Coord>(imageSize.width - 1) - 1;
+  return renderScene.camera.getRay(x, y);
+}
+
+// Differentials of cameraRay() for a step of `spacing` pixels.
+static geometry::RayDifferential cameraRayDifferential(
+    RenderScene const& renderScene, color::ImageSize imageSize,
+    geometry::Coord ii, geometry::Coord jj, geometry::Coord spacing) {
+  geometry::Coord y =
+      -(2 * ii / static_cast<geometry::Coord>(imageSize.height - 1) - 1);
+  geometry::Coord x =
+      2 * jj / static_cast<geometry::Coord>(imageSize.width - 1) - 1;
+  geometry::Coord dy =
+      -2 * spacing / static_cast<geometry::Coord>(imageSize.height - 1);
+  geometry::Coord dx =
+      2 * spacing / static_cast<geometry::Coord>(imageSize.width - 1);
+  return renderScene.camera.getRayDifferential(x, y, dx, dy);
+}
+
+// Bounding box of the points seen by a coarse grid of camera rays.
+static std::pair<geometry::Point3D, geometry::Point3D> visibleBounds(
+    RenderScene const& renderScene, color::ImageSize imageSize) {
+  const size_t n = 64;
+  geometry::Point3D min{1e30, 1e30, 1e30}, max{-1e30, -1e30, -1e30};
+
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < n; ++j) {
+      geometry::Coord ii = (0.5 + static_cast<geometry::Coord>(i)) / n *
+                           static_cast<geometry::Coord>(imageSize.height);
+      geometry::Coord jj = (0.5 + static_cast<geometry::Coord>(j)) / n *
+                           static_cast<geometry::Coord>(imageSize.width);
+      geometry::Ray ray = cameraRay(renderScene, imageSize, ii, jj);
+      auto [primitive, t, part] = intersect(renderScene, ray);
+      if (!primitive) continue;
+      geometry::Point3D x = ray.start + t * ray.direction;
+      min = {std::min(min.x, x.x), std::min(min.y, x.y), std::min(min.z, x.z)};
+      max = {std::max(max.x, x.x), std::max(max.y, x.y), std::max(max.z, x.z)};
+    }
+  }
+
+  if (min.x > max.x) return {{-1, -1, -1}, {1, 1, 1}};
+  geometry::Vector3D margin = (max - min) * 0.01 + geometry::Vector3D{1e-3, 1e-3, 1e-3};
+  return {min - margin, max + margin};
+}
+
+static std::unique_ptr<SDTree> trainGuiding(RenderScene const& renderScene,
+                                            color::ImageSize imageSize,
+                                            RenderSettings const& settings,
+                                            PhotonMap const* caustics) {
+  auto [min, max] = visibleBounds(renderScene, imageSize);
+  auto tree = std::make_unique<SDTree>(min, max);
+
+  for (size_t pass = 0; pass < settings.guiding.trainingPasses; ++pass) {
+    TraceContext context{tree.get(), true,
+                         pass == 0 ? 1.0 : settings.guiding.bsdfFraction,
+                         caustics};
+    size_t samples = size_t(1) << pass;
+    platform::trace::Span span("guiding pass", int64_t(pass));
+
+    parallelFor(imageSize.height, settings.threads, [&](size_t i) {
+      platform::trace::Span span("guiding row", int64_t(i));
+      // Seeds past those of the image samples.
+      modelling::RandomStream& random = modelling::threadRandom();
+      random.seed(modelling::sampleSeed(
+          imageSize.width * imageSize.height + i, pass));
+
+      for (size_t j = 0; j < imageSize.width; ++j) {
+        for (size_t s = 0; s < samples; ++s) {
+          geometry::Coord ii =
+              static_cast<geometry::Coord>(i) + random.uniform();
+          geometry::Coord jj =
+              static_cast<geometry::Coord>(j) + random.uniform();
+          stats::count(&RenderCounters::cameraRays);
+          traceGlobal(renderScene, cameraRay(renderScene, imageSize, ii, jj),
+                      settings.maxDepth, context);
+        }
+      }
+    });
+
+    tree->refine(pass, settings.guiding);
+  }
+
+  return tree;
+}
+
 color::ImageData render(RenderScene const& renderScene,
                         color::ImageSize imageSize, size_t gridSize,
                         size_t maxDepth) {
-  color::ImageData imageData;
-  imageData.reserve(imageSize.height * imageSize.width);
+  RenderSettings settings;
+  settings.gridSize = gridSize;
+  settings.maxDepth = maxDepth;
+  return render(renderScene, imageSize, settings);
+}
+
+color::ImageData render(RenderScene const& renderScene,
+                        color::ImageSize imageSize,
+                        RenderSettings const& settings) {
+  return renderFramebuffer(renderScene, imageSize, settings).toImage().data;
+}
 
-  using RaySamples = std::vector<geometry::Ray>;
+/**
+ * @brief Fills *stats, if given, with the counters and stage times of one
+ * render. The counters are those the calling thread and the parallelFor()
+ * workers it joined added between construction and finish(), so renders on
+ * other threads are not included.
+ */
+class StatsRecorder {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  explicit StatsRecorder(RenderStats* stats)
+      : m_stats(stats), m_start(Clock::now()), m_last(m_start) {
+    if (!m_stats) return;
+    *m_stats = RenderStats{};
+    m_before = stats::counters();
+  }
 
-  std::vector<RaySamples> allRaySamples(imageSize.height * imageSize.width);
+  // Adds the time since the previous stage to *field.
+  void stage(double RenderStats::*field) {
+    if (!m_stats) return;
+    Clock::time_point now = Clock::now();
+    m_stats->*field += std::chrono::duration<double>(now - m_last).count();
+    m_last = now;
+  }
 
-  for (size_t i = 0; i < imageSize.height; ++i) {
-    for (size_t j = 0; j < imageSize.width; ++j) {
-      color::SColor c(0);
-      for (size_t u = 0; u < gridSize; ++u) {
-        for (size_t v = 0; v < gridSize; ++v) {
-          geometry::Coord ii = static_cast<geometry::Coord>(i) +
-                               (0.5 + static_cast<geometry::Coord>(u)) /
-                                   static_cast<geometry::Coord>(gridSize);
-          geometry::Coord jj = static_cast<geometry::Coord>(j) +
-                               (0.5 + static_cast<geometry::Coord>(v)) /
-                                   static_cast<geometry::Coord>(gridSize);
-
-          geometry::Coord y = -(
-              2 * ii / static_cast<geometry::Coord>(imageSize.height - 1) - 1);
-          geometry::Coord x =
-              2 * jj / static_cast<geometry::Coord>(imageSize.width - 1) - 1;
-
-          c += traceGlobal(renderScene, renderScene.camera.getRay(x, y),
-                           maxDepth);
-        }
+  void finish() {
+    if (!m_stats) return;
+    m_stats->counters = stats::counters();
+    m_stats->counters -= m_before;
+    m_stats->totalTime =
+        std::chrono::duration<double>(Clock::now() - m_start).count();
+  }
+
+ private:
+  RenderStats* m_stats;
+  RenderCounters m_before;
+  Clock::time_point m_start;
+  Clock::time_point m_last;
+};
+
+// Structures built before the image pass, shared by all pixels.
+struct RenderState {
+  std::unique_ptr<PhotonMap> caustics;
+  std::unique_ptr<SDTree> guideTree;
+  std::unique_ptr<IrradianceCache> irradianceCache;
+  TraceContext context;
+};
+
+static std::unique_ptr<RenderState> prepare(RenderScene const& renderScene,
+                                            color::ImageSize imageSize,
+                                            RenderSettings const& settings,
+                                            StatsRecorder& recorder) {
+  platform::trace::Span span("scene setup");
+  auto state = std::make_unique<RenderState>();
+
+  if (settings.caustics.enabled) {
+    platform::trace::Span span("photon map");
+    state->caustics = std::make_unique<PhotonMap>(
+        renderScene, settings.caustics, settings.threads);
+  }
+  recorder.stage(&RenderStats::photonMapTime);
+
+  if (settings.guiding.enabled) {
+    platform::trace::Span span("guiding");
+    state->guideTree = trainGuiding(renderScene, imageSize, settings,
+                                    state->caustics.get());
+  }
+  recorder.stage(&RenderStats::guidingTime);
+  if (settings.irradianceCache.enabled) {
+    auto [min, max] = visibleBounds(renderScene, imageSize);
+    state->irradianceCache = std::make_unique<IrradianceCache>(
+        min, max, settings.irradianceCache);
+  }
+
+  state->context = {state->guideTree.get(), false,
+                    settings.guiding.bsdfFraction, state->caustics.get(),
+                    state->irradianceCache.get()};
+  return state;
+}
+
+// Sample `sample` of the gridSize x gridSize strata of pixel (i, j). The
+// random stream of the thread is seeded from the pixel and the sample, so
+// the result does not depend on the thread or the order of rendering.
+static color::SColor renderSample(RenderScene const& renderScene,
+                                  color::ImageSize imageSize,
+                                  RenderSettings const& settings,
+                                  TraceContext const& context, size_t i,
+                                  size_t j, size_t sample) {
+  modelling::threadRandom().seed(
+      modelling::sampleSeed(i * imageSize.width + j, sample));
+
+  size_t gridSize = settings.gridSize;
+  size_t u = sample / gridSize, v = sample % gridSize;
+  geometry::Coord ii = static_cast<geometry::Coord>(i) +
+                       (0.5 + static_cast<geometry::Coord>(u)) /
+                           static_cast<geometry::Coord>(gridSize);
+  geometry::Coord jj = static_cast<geometry::Coord>(j) +
+                       (0.5 + static_cast<geometry::Coord>(v)) /
+                           static_cast<geometry::Coord>(gridSize);
+
+  // The samples of a pixel are 1/gridSize pixels apart, which is
+  // the footprint the texture filter has to cover.
+  geometry::RayDifferential rd = cameraRayDifferential(
+      renderScene, imageSize, ii, jj,
+      1.0 / static_cast<geometry::Coord>(gridSize));
+  stats::count(&RenderCounters::cameraRays);
+  return traceGlobal(renderScene, cameraRay(renderScene, imageSize, ii, jj),
+                     settings.maxDepth, context, &rd);
+}
+
+static color::RGB renderPixel(RenderScene const& renderScene,
+                              color::ImageSize imageSize,
+                              RenderSettings const& settings,
+                              TraceContext const& context, size_t i,
+                              size_t j) {
+  size_t samples = settings.gridSize * settings.gridSize;
+  color::SColor c(0);
+  for (size_t sample = 0; sample < samples; ++sample)
+    c += renderSample(renderScene, imageSize, settings, context, i, j, sample);
+
+  c /= static_cast<color::Intensity>(samples);
+  return color::RGB::linear(c);
+}
+
+// Identifies the render a checkpoint file belongs to: everything that
+// changes the samples except the content of the scene, which is identified
+// by settings.checkpoint.sceneId.
+static uint64_t fingerprint(RenderScene const& renderScene,
+                            color::ImageSize imageSize,
+                            RenderSettings const& settings) {
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&hash](uint64_t value) {
+    hash ^= value;
+    hash *= 1099511628211ull;
+  };
+  auto addReal = [&add](double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    add(bits);
+  };
+
+  add(settings.checkpoint.sceneId);
+  for (size_t value :
+       {imageSize.width, imageSize.height, settings.gridSize,
+        settings.maxDepth, size_t(settings.framebuffer)})
+    add(value);
+
+  PathGuidingSettings const& guiding = settings.guiding;
+  add(guiding.enabled);
+  if (guiding.enabled) {
+    add(guiding.trainingPasses);
+    add(guiding.maxDirectionalDepth);
+    for (double value : {guiding.bsdfFraction, guiding.spatialThreshold,
+                         guiding.directionalThreshold})
+      addReal(value);
+  }
+  PhotonMapSettings const& caustics = settings.caustics;
+  add(caustics.enabled);
+  if (caustics.enabled) {
+    add(caustics.photons);
+    add(caustics.maxDepth);
+    addReal(caustics.radius);
+  }
+  IrradianceCacheSettings const& cache = settings.irradianceCache;
+  add(cache.enabled);
+  if (cache.enabled) {
+    add(cache.thetaStrata);
+    add(cache.phiStrata);
+    for (double value : {cache.accuracy, cache.minSpacing, cache.maxSpacing})
+      addReal(value);
+  }
+
+  // The rays through three corners of the image plane fix the camera.
+  for (auto [x, y] : {std::pair(0.0, 0.0), std::pair(1.0, 0.0),
+                      std::pair(0.0, 1.0)}) {
+    geometry::Ray ray = renderScene.camera.getRay(x, y);
+    for (double value : {ray.start.x, ray.start.y, ray.start.z,
+                         ray.direction.x, ray.direction.y, ray.direction.z})
+      addReal(value);
+  }
+
+  add(renderScene.primitives.size());
+  for (auto const& primitive : renderScene.primitives)
+    add(uint64_t(primitive->shape()));
+  add(renderScene.emitters.size());
+
+  // Kernels round differently per instruction set level.
+  add(uint64_t(platform::isaLevel()));
+  return hash;
+}
+
+// Renders one sample per pixel and pass into the accumulation file, skipping
+// the samples a previous run has stored. An interrupted render therefore
+// holds a complete image of fewer samples.
+static color::Framebuffer renderCheckpointed(RenderScene const& renderScene,
+                                             color::ImageSize imageSize,
+                                             RenderSettings const& settings,
+                                             StatsRecorder& recorder) {
+  AccumulationBuffer buffer(settings.checkpoint.path, imageSize,
+                            fingerprint(renderScene, imageSize, settings));
+  auto state = prepare(renderScene, imageSize, settings, recorder);
+
+  size_t samples = settings.gridSize * settings.gridSize;
+  for (size_t sample = 0; sample < samples; ++sample) {
+    platform::trace::Span span("sample pass", int64_t(sample));
+    parallelFor(imageSize.height, settings.threads, [&](size_t i) {
+      platform::trace::Span span("render row", int64_t(i));
+      for (size_t j = 0; j < imageSize.width; ++j) {
+        AccumulationBuffer::Pixel pixel = buffer.get(j, i);
+        if (pixel.samples > sample) continue;
+
+        color::RGB rgb = color::RGB::linear(renderSample(
+            renderScene, imageSize, settings, state->context, i, j, sample));
+        pixel.sum[0] += static_cast<float>(rgb.r);
+        pixel.sum[1] += static_cast<float>(rgb.g);
+        pixel.sum[2] += static_cast<float>(rgb.b);
+        pixel.samples = static_cast<uint32_t>(sample + 1);
+        buffer.set(j, i, pixel);
       }
+      buffer.flushEvery(settings.checkpoint.interval);
+    });
+  }
+
+  buffer.flush();
+  recorder.stage(&RenderStats::imageTime);
+  return buffer.framebuffer(settings.framebuffer);
+}
 
-      c /= static_cast<color::Intensity>(gridSize * gridSize);
+color::Framebuffer renderFramebuffer(RenderScene const& renderScene,
+                                     color::ImageSize imageSize,
+                                     RenderSettings const& settings,
+                                     RenderStats* stats) {
+  StatsRecorder recorder(stats);
+  if (!settings.checkpoint.path.empty()) {
+    color::Framebuffer framebuffer =
+        renderCheckpointed(renderScene, imageSize, settings, recorder);
+    recorder.finish();
+    return framebuffer;
+  }
 
-      imageData.emplace_back(color::RGB(c));
+  auto state = prepare(renderScene, imageSize, settings, recorder);
+  color::Framebuffer framebuffer(imageSize, settings.framebuffer);
+
+  platform::trace::Span span("render image");
+  parallelFor(imageSize.height, settings.threads, [&](size_t i) {
+    platform::trace::Span span("render row", int64_t(i));
+    for (size_t j = 0; j < imageSize.width; ++j)
+      framebuffer.set(j, i,
+                      renderPixel(renderScene, imageSize, settings,
+                                  state->context, i, j));
+  });
+  recorder.stage(&RenderStats::imageTime);
+
+  recorder.finish();
+  return framebuffer;
+}
+
+CostMap renderCostMap(RenderScene const& renderScene,
+                      color::ImageSize imageSize,
+                      RenderSettings const& settings) {
+  using Clock = std::chrono::steady_clock;
+  StatsRecorder recorder(nullptr);
+  auto state = prepare(renderScene, imageSize, settings, recorder);
+
+  size_t n = renderScene.primitives.size();
+  size_t pixels = imageSize.width * imageSize.height;
+  CostMap map{imageSize,
+              std::vector<float>(pixels),
+              std::vector<float>(pixels),
+              std::vector<float>(pixels),
+              {}};
+  for (size_t k = 0; k < n; ++k)
+    map.primitives.push_back(
+        {k, renderScene.primitives[k]->shape(), 0, 0, 0, 0.0});
+
+  auto tests = [](RenderCounters const& c) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < ShapeCount; ++i)
+      sum += c.primitiveTests[i] + c.shadowTests[i];
+    return sum;
+  };
+  double samples = double(settings.gridSize * settings.gridSize);
+
+  std::mutex mutex;
+  parallelFor(imageSize.height, settings.threads, [&](size_t i) {
+    platform::trace::Span span("cost map row", int64_t(i));
+    stats::PrimitiveCounters primitives{std::vector<uint64_t>(n),
+                                        std::vector<uint64_t>(n)};
+    std::vector<uint64_t> firstPixels(n);
+    std::vector<double> firstSeconds(n);
+    stats::threadCounters.primitives = &primitives;
+    RenderCounters& counters = stats::counters();
+
+    // The same per-pixel work as renderFramebuffer(), timed.
+    for (size_t j = 0; j < imageSize.width; ++j) {
+      primitives.firstHit = stats::PrimitiveCounters::NoPrimitive;
+      uint64_t testsBefore = tests(counters);
+      uint64_t verticesBefore = counters.pathVertices;
+      Clock::time_point start = Clock::now();
+      renderPixel(renderScene, imageSize, settings, state->context, i, j);
+      double seconds =
+          std::chrono::duration<double>(Clock::now() - start).count();
+
+      size_t at = i * imageSize.width + j;
+      map.nanoseconds[at] = static_cast<float>(seconds * 1e9);
+      map.tests[at] = static_cast<float>(tests(counters) - testsBefore);
+      map.depth[at] = static_cast<float>(
+          double(counters.pathVertices - verticesBefore) / samples);
+      if (primitives.firstHit != stats::PrimitiveCounters::NoPrimitive) {
+        ++firstPixels[primitives.firstHit];
+        firstSeconds[primitives.firstHit] += seconds;
+      }
+    }
+    stats::threadCounters.primitives = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t k = 0; k < n; ++k) {
+      map.primitives[k].tests += primitives.tests[k];
+      map.primitives[k].hits += primitives.hits[k];
+      map.primitives[k].pixels += firstPixels[k];
+      map.primitives[k].seconds += firstSeconds[k];
     }
+  });
+
+  return map;
+}
+
+void renderStreaming(RenderScene const& renderScene,
+                     color::ImageSize imageSize,
+                     RenderSettings const& settings, color::RowWriter& writer,
+                     size_t bandHeight, RenderStats* stats) {
+  StatsRecorder recorder(stats);
+  auto state = prepare(renderScene, imageSize, settings, recorder);
+
+  // The previous band is written while the next one renders.
+  std::unique_ptr<color::Framebuffer> written;
+  std::future<void> writing;
+
+  for (size_t y0 = 0; y0 < imageSize.height; y0 += bandHeight) {
+    size_t rows = std::min(bandHeight, imageSize.height - y0);
+    auto band = std::make_unique<color::Framebuffer>(
+        color::ImageSize{imageSize.width, rows}, settings.framebuffer);
+
+    platform::trace::Span span("render band", int64_t(y0 / bandHeight));
+    parallelFor(rows, settings.threads, [&](size_t i) {
+      platform::trace::Span span("render row", int64_t(y0 + i));
+      for (size_t j = 0; j < imageSize.width; ++j)
+        band->set(j, i,
+                  renderPixel(renderScene, imageSize, settings,
+                              state->context, y0 + i, j));
+    });
+
+    if (writing.valid()) writing.get();
+    written = std::move(band);
+    writing = std::async(std::launch::async, [&writer, &written, y0, bandHeight]() {
+      platform::trace::Span span("write band", int64_t(y0 / bandHeight));
+      writer.write(*written);
+    });
   }
 
-  return imageData;
+  if (writing.valid()) writing.get();
+  {
+    platform::trace::Span span("finish writing");
+    writer.finish();
+  }
+  recorder.stage(&RenderStats::imageTime);
+  recorder.finish();
 }
 
-}  // namespace rendering
\ No newline at end of file
+}  // namespace rendering